@@ -14,6 +14,7 @@ extern "C"
 	#include "externs.h"
 	#include "renderdrivers.h"
 	#include "framebufferfilter.h"
+	#include "harness.h"
 	#include "version.h"
 
 	SDL_Window* gSDLWindow = nullptr;
@@ -91,31 +92,49 @@ static void Boot(int argc, char** argv)
 	// Start our "machine"
 	Pomme::Init();
 
+	// See if we should run headless
+	const char* renderDriverHint = SDL_GetHint("MIGHTYMIKE_RENDER_DRIVER");
+	bool headless = renderDriverHint && 0 == SDL_strcasecmp(renderDriverHint, "null");
+
+	if (headless)
+	{
+		// We still want SDL's event loop, just no display server (or sound card)
+		SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "dummy");
+		SDL_SetHint(SDL_HINT_AUDIO_DRIVER, "dummy");
+	}
+
 	// Initialize SDL video subsystem
 	if (!SDL_Init(SDL_INIT_VIDEO))
 	{
 		throw std::runtime_error("Couldn't initialize SDL video subsystem.");
 	}
 
+	if (headless)
+	{
+		NullRender_Init();
+	}
+	else
+	{
 #if GLRENDER
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_COMPATIBILITY);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_COMPATIBILITY);
 #endif // GLRENDER
 
-	// Create window
-	int windowFlags = SDL_WINDOW_RESIZABLE | SDL_WINDOW_HIGH_PIXEL_DENSITY;
+		// Create window
+		int windowFlags = SDL_WINDOW_RESIZABLE | SDL_WINDOW_HIGH_PIXEL_DENSITY;
 #if GLRENDER
-	windowFlags |= SDL_WINDOW_OPENGL;
+		windowFlags |= SDL_WINDOW_OPENGL;
 #endif
-	gSDLWindow = SDL_CreateWindow(GAME_FULL_NAME " " GAME_VERSION, VISIBLE_WIDTH, VISIBLE_HEIGHT, windowFlags);
-	if (!gSDLWindow)
-		throw std::runtime_error("Couldn't create SDL window.");
+		gSDLWindow = SDL_CreateWindow(GAME_FULL_NAME " " GAME_VERSION, VISIBLE_WIDTH, VISIBLE_HEIGHT, windowFlags);
+		if (!gSDLWindow)
+			throw std::runtime_error("Couldn't create SDL window.");
 
 #if GLRENDER
-	GLRender_Init();
+		GLRender_Init();
 #else
-	if (!SDLRender_Init())
-		throw std::runtime_error("Couldn't create SDL renderer.");
+		if (!SDLRender_Init())
+			throw std::runtime_error("Couldn't create SDL renderer.");
 #endif // GLRENDER
+	}
 
 	// Find path to game data folder
 	fs::path dataPath = FindGameData(executablePath);
@@ -184,5 +203,5 @@ int main(int argc, char** argv)
 		SDL_ShowSimpleMessageBox(0, GAME_FULL_NAME, uncaught.c_str(), nullptr);
 	}
 
-	return success ? 0 : 1;
+	return success ? GetHarnessExitCode() : 1;
 }
@@ -119,10 +119,10 @@ int MakeText(const char* label, int x, int y, int flags, long stringID)
 		if (frameID != 0)	// TODO: why do we have to decrement frameID to draw non-animated frames, but not for MakeNewShape?
 			frameID--;
 
-		const FrameHeader* fh = GetFrameHeader(GroupNum_BigFont, ObjType_BigFont, frameID, nil, nil);
+		const FrameDesc* fd = GetFrameDesc(GroupNum_BigFont, ObjType_BigFont, frameID);
 
 		int myWidth = 13;
-		int cancelXOff = -fh->x;
+		int cancelXOff = -fd->x;
 		int cancelYOff = 0;
 
 		if (cc < sizeof(kLetterWidths) / sizeof(kLetterWidths[0]))
@@ -132,8 +132,8 @@ int MakeText(const char* label, int x, int y, int flags, long stringID)
 
 		if (cc >= 'a' && cc <= 'z')
 		{
-			cancelXOff = -fh->x;
-			cancelYOff = -fh->y - 9;
+			cancelXOff = -fd->x;
+			cancelYOff = -fd->y - 9;
 		}
 		else if (cc >= 'A' && cc <= 'Z')
 		{
@@ -32,40 +32,167 @@ PFNGLMAPBUFFERARBPROC glMapBufferARB;
 PFNGLBUFFERDATAARBPROC glBufferDataARB;
 PFNGLUNMAPBUFFERARBPROC glUnmapBufferARB;
 
-// Marginal FPS increase at the cost of 1 frame of latency
-#define DEFERRED_TEX_UPDATE 0
-
-// RGB 5-6-5 appears to be the fastest format for streaming textures
-// on graphics cards that ship with ancient PPC hardware
-#define kFramePixelType GL_UNSIGNED_SHORT_5_6_5
+// GLSL entry points for the palette shader (GL 2.0).
+// Kept out of the global namespace so they don't clash with the system's GL library.
+static struct
+{
+	PFNGLCREATESHADERPROC		CreateShader;
+	PFNGLSHADERSOURCEPROC		ShaderSource;
+	PFNGLCOMPILESHADERPROC		CompileShader;
+	PFNGLGETSHADERIVPROC		GetShaderiv;
+	PFNGLGETSHADERINFOLOGPROC	GetShaderInfoLog;
+	PFNGLDELETESHADERPROC		DeleteShader;
+	PFNGLCREATEPROGRAMPROC		CreateProgram;
+	PFNGLATTACHSHADERPROC		AttachShader;
+	PFNGLLINKPROGRAMPROC		LinkProgram;
+	PFNGLGETPROGRAMIVPROC		GetProgramiv;
+	PFNGLGETPROGRAMINFOLOGPROC	GetProgramInfoLog;
+	PFNGLDELETEPROGRAMPROC		DeleteProgram;
+	PFNGLUSEPROGRAMPROC			UseProgram;
+	PFNGLGETUNIFORMLOCATIONPROC	GetUniformLocation;
+	PFNGLUNIFORM1IPROC			Uniform1i;
+	PFNGLUNIFORM1FPROC			Uniform1f;
+	PFNGLUNIFORM2FPROC			Uniform2f;
+	PFNGLACTIVETEXTUREPROC		ActiveTexture;
+} gGLSL;
+
+// GL_ARB_buffer_storage + GL_ARB_sync entry points for persistently-mapped PBOs
+static struct
+{
+	PFNGLBUFFERSTORAGEPROC		BufferStorage;
+	PFNGLMAPBUFFERRANGEPROC		MapBufferRange;
+	PFNGLFENCESYNCPROC			FenceSync;
+	PFNGLCLIENTWAITSYNCPROC		ClientWaitSync;
+	PFNGLDELETESYNCPROC			DeleteSync;
+} gGLBufferStorage;
+
+// Upload buffer ring. The GPU may still be pulling texels out of the PBO
+// we filled last frame, so we cycle through several instead of stalling on one.
+// Set this hint (or environment variable) to override the ring depth.
+#define kPBORingSizeHint "MIGHTYMIKE_GL_PBO_RING"
+#define kMaxPBORingSize 4
+#define kDefaultPBORingSize 3
+
+// Set this hint (or environment variable) to 0 to force the fixed-function path
+#define kPaletteShaderHint "MIGHTYMIKE_GL_PALETTE_SHADER"
 
 #define kFrameTextureWidth 1024
 #define kFrameTextureHeight 512
 
-#if (kFramePixelType == GL_UNSIGNED_SHORT_5_6_5)
-	#define kFrameInternalFormat	GL_RGB
-	#define kFramePixelFormat		GL_RGB
-	#define kFramePixelType			GL_UNSIGNED_SHORT_5_6_5
-	#define kFrameBytesPerPixel		2
-#elif (kFramePixelType == GL_UNSIGNED_SHORT_5_5_5_1)
-	#define kFrameInternalFormat	GL_RGBA
-	#define kFramePixelFormat		GL_RGBA
-	#define kFramePixelType			GL_UNSIGNED_SHORT_5_5_5_1
-	#define kFrameBytesPerPixel		2
-#else
-	#define kFrameInternalFormat	GL_RGBA
-	#define kFramePixelFormat		GL_RGBA
-	#define kFramePixelType			GL_UNSIGNED_BYTE
-	#define kFrameBytesPerPixel		4
-#endif
+// Pixel formats for the converted frame texture, matching finalColors16 and finalColors32.
+// RGB 5-6-5 appears to be the fastest format for streaming textures on graphics cards that
+// ship with ancient PPC hardware, but 8-8-8-8 wins on some newer drivers, so we time both
+// at startup unless the color depth pref says otherwise.
+typedef struct
+{
+	GLint		internalFormat;
+	GLenum		format;
+	GLenum		type;
+} FramePixelFormat;
+
+static const FramePixelFormat kFramePixelFormat16 = { GL_RGB, GL_RGB, GL_UNSIGNED_SHORT_5_6_5 };
+static const FramePixelFormat kFramePixelFormat32 = { GL_RGBA, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8 };
+
+#define kUploadBenchmarkFrames 8
 
 static SDL_GLContext gGLContext = NULL;
 static GLuint gFrameTexture = 0;
-static GLuint gFramePBO = 0;
 static GLint gMaxTextureSize = 0;
+static int gAutoBytesPerPixel = 2;		// whichever color depth uploaded faster at startup
+
+typedef struct
+{
+	GLuint		pbo;
+	void*		persistentMapping;	// NULL if we're orphaning instead
+	GLsync		fence;				// signaled once the GPU is done reading this PBO
+} PBORingSlot;
+
+static PBORingSlot gPBORing[kMaxPBORingSize];
+static int gPBORingSize = kDefaultPBORingSize;
+static int gPBORingHead = 0;
+static bool gPersistentPBOs = false;
+
+// Palette shader path: the GPU does the palette lookup, dither smear and scaling.
+// We only upload 8-bit indices (plus smear flags when dithering is on) and the palette.
+static bool gUsePaletteShader = false;
+static GLuint gPaletteProgram = 0;
+static GLuint gIndexTexture = 0;
+static GLuint gPaletteTexture = 0;
+static bool gIndexTextureHasSmear = false;
+static uint8_t* gSmearStaging = NULL;
+static uint32_t gUploadedPalette[256];
+static bool gPaletteTextureStale = true;
+
+static struct
+{
+	GLint indexTexture;
+	GLint paletteTexture;
+	GLint textureSize;
+	GLint visibleSize;
+	GLint prescale;
+	GLint smear;
+} gPaletteUniforms;
+
+static const char* kPaletteVertexShader =
+	"#version 110\n"
+	"void main()\n"
+	"{\n"
+	"	gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+	"	gl_Position = ftransform();\n"
+	"}\n";
+
+static const char* kPaletteFragmentShader =
+	"#version 110\n"
+	"uniform sampler2D indexTexture;\n"		// luminance = palette index; alpha = smear flag if 'smear' is set
+	"uniform sampler2D paletteTexture;\n"		// 256x1
+	"uniform vec2 textureSize;\n"				// index texture dimensions
+	"uniform vec2 visibleSize;\n"				// VISIBLE_WIDTH, VISIBLE_HEIGHT
+	"uniform float prescale;\n"				// 0: nearest; 1: bilinear; N: bilinear over Nx pixel-replicated image (HQ stretch)
+	"uniform float smear;\n"
+	"\n"
+	"vec3 LookUp(float index)\n"
+	"{\n"
+	"	return texture2D(paletteTexture, vec2((index * 255.0 + 0.5) / 256.0, 0.5)).rgb;\n"
+	"}\n"
+	"\n"
+	"vec3 FetchTexel(vec2 texel)\n"
+	"{\n"
+	"	texel = clamp(texel, vec2(0.0), visibleSize - 1.0);\n"
+	"	vec4 s = texture2D(indexTexture, (texel + 0.5) / textureSize);\n"
+	"	vec3 color = LookUp(s.r);\n"
+	"	if (smear * s.a > 0.5)\n"				// average with right-hand neighbor, rounding down like the CPU filter
+	"	{\n"
+	"		float right = texture2D(indexTexture, (texel + vec2(1.5, 0.5)) / textureSize).r;\n"
+	"		color = floor((color + LookUp(right)) * 127.5 + 0.01) / 255.0;\n"
+	"	}\n"
+	"	return color;\n"
+	"}\n"
+	"\n"
+	"void main()\n"
+	"{\n"
+	"	vec2 position = gl_TexCoord[0].st * textureSize;\n"
+	"	vec3 color;\n"
+	"	if (prescale < 0.5)\n"
+	"	{\n"
+	"		color = FetchTexel(floor(position));\n"
+	"	}\n"
+	"	else\n"
+	"	{\n"
+	"		vec2 p = position * prescale - 0.5;\n"
+	"		vec2 f = fract(p);\n"
+	"		vec2 t0 = floor(floor(p) / prescale);\n"
+	"		vec2 t1 = floor((floor(p) + 1.0) / prescale);\n"
+	"		vec3 c00 = FetchTexel(t0);\n"
+	"		vec3 c10 = FetchTexel(vec2(t1.x, t0.y));\n"
+	"		vec3 c01 = FetchTexel(vec2(t0.x, t1.y));\n"
+	"		vec3 c11 = FetchTexel(t1);\n"
+	"		color = mix(mix(c00, c10, f.x), mix(c01, c11, f.x), f.y);\n"
+	"	}\n"
+	"	gl_FragColor = vec4(color, 1.0);\n"
+	"}\n";
 
 const char* gRendererName = "NULL";
-Boolean gCanDoHQStretch = true;
+int gMaxPrescale = MAX_PRESCALE;
 
 #if _DEBUG
 #define CHECK_GL_ERROR()												\
@@ -120,24 +247,65 @@ do { \
     GAME_ASSERT_MESSAGE((proc), "Missing OpenGL procedure " #proc); \
 } while(0)
 
-static void InitTextureAndPBO(int pixelZoom)
+static bool InitPersistentMapping(void)
+{
+	if (!SDL_GL_ExtensionSupported("GL_ARB_buffer_storage")
+		|| !SDL_GL_ExtensionSupported("GL_ARB_sync"))
+	{
+		return false;
+	}
+
+	gGLBufferStorage.BufferStorage	= (PFNGLBUFFERSTORAGEPROC) SDL_GL_GetProcAddress("glBufferStorage");
+	gGLBufferStorage.MapBufferRange	= (PFNGLMAPBUFFERRANGEPROC) SDL_GL_GetProcAddress("glMapBufferRange");
+	gGLBufferStorage.FenceSync		= (PFNGLFENCESYNCPROC) SDL_GL_GetProcAddress("glFenceSync");
+	gGLBufferStorage.ClientWaitSync	= (PFNGLCLIENTWAITSYNCPROC) SDL_GL_GetProcAddress("glClientWaitSync");
+	gGLBufferStorage.DeleteSync		= (PFNGLDELETESYNCPROC) SDL_GL_GetProcAddress("glDeleteSync");
+
+	return gGLBufferStorage.BufferStorage
+		&& gGLBufferStorage.MapBufferRange
+		&& gGLBufferStorage.FenceSync
+		&& gGLBufferStorage.ClientWaitSync
+		&& gGLBufferStorage.DeleteSync;
+}
+
+static const FramePixelFormat* GetFramePixelFormat(void)
 {
+	return gFramebufferBytesPerPixel == 2 ? &kFramePixelFormat16 : &kFramePixelFormat32;
+}
+
+static void InitTextureAndPBO(int pixelZoom, int bytesPerPixel)
+{
+	gFramebufferBytesPerPixel = bytesPerPixel;
+	const FramePixelFormat* pf = GetFramePixelFormat();
+
+	gRendererName = bytesPerPixel == 2 ? "fastgl16" : "fastgl32";
+
 	glGenTextures(1, &gFrameTexture);
 	CHECK_GL_ERROR();
 
-	glGenBuffersARB(1, &gFramePBO);
-	CHECK_GL_ERROR();
+	GLsizeiptr capacity = kFrameTextureWidth * kFrameTextureHeight * bytesPerPixel * (pixelZoom*pixelZoom);
 
-#if 0
-	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, gFramePBO);
-	// perhaps we don't need to do this everytime?
-	glBufferDataARB(
-		GL_PIXEL_UNPACK_BUFFER_ARB,
-		kFrameTextureWidth * kFrameTextureHeight * kFrameBytesPerPixel * (pixelZoom*pixelZoom),
-		NULL,
-		GL_STREAM_DRAW);
-	CHECK_GL_ERROR();
-#endif
+	for (int i = 0; i < gPBORingSize; i++)
+	{
+		PBORingSlot* slot = &gPBORing[i];
+
+		glGenBuffersARB(1, &slot->pbo);
+		CHECK_GL_ERROR();
+
+		if (gPersistentPBOs)
+		{
+			// Allocate once and keep it mapped for the lifetime of the texture
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, slot->pbo);
+			gGLBufferStorage.BufferStorage(GL_PIXEL_UNPACK_BUFFER_ARB, capacity, NULL, flags);
+			slot->persistentMapping = gGLBufferStorage.MapBufferRange(GL_PIXEL_UNPACK_BUFFER_ARB, 0, capacity, flags);
+			CHECK_GL_ERROR();
+			GAME_ASSERT(slot->persistentMapping);
+		}
+	}
+
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+	gPBORingHead = 0;
 
 	glBindTexture(GL_TEXTURE_2D, gFrameTexture);
 	CHECK_GL_ERROR();
@@ -151,17 +319,258 @@ static void InitTextureAndPBO(int pixelZoom)
 	glTexImage2D(
 			GL_TEXTURE_2D,
 			0,
-			kFrameInternalFormat,
+			pf->internalFormat,
 			kFrameTextureWidth * pixelZoom,
 			kFrameTextureHeight * pixelZoom,
 			0,
-			kFramePixelFormat,
-			kFramePixelType,
+			pf->format,
+			pf->type,
 			NULL // need initial call with NULL so glTexSubImage2D works later on
 	);
 	CHECK_GL_ERROR();
+
+	// The new texture is blank, so the next frame must be uploaded in full
+	InvalidateFramebufferDamage();
+}
+
+#pragma mark - Palette shader
+
+static GLuint CompilePaletteShader(GLenum type, const char* source)
+{
+	GLuint shader = gGLSL.CreateShader(type);
+	gGLSL.ShaderSource(shader, 1, &source, NULL);
+	gGLSL.CompileShader(shader);
+
+	GLint compiled = 0;
+	gGLSL.GetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+	if (!compiled)
+	{
+		char log[1024];
+		gGLSL.GetShaderInfoLog(shader, sizeof(log), NULL, log);
+		SDL_Log("Palette shader didn't compile: %s", log);
+		gGLSL.DeleteShader(shader);
+		return 0;
+	}
+
+	return shader;
+}
+
+static bool InitPaletteShader(void)
+{
+	if (!SDL_GetHintBoolean(kPaletteShaderHint, true))
+	{
+		SDL_Log("Palette shader disabled by %s", kPaletteShaderHint);
+		return false;
+	}
+
+	// Don't assert: if any of these are missing, just use the fixed-function path
+#define GET_GLSL_PROC(t, proc) \
+	do { \
+		gGLSL.proc = (t) SDL_GL_GetProcAddress("gl" #proc); \
+		if (!gGLSL.proc) { SDL_Log("Palette shader unavailable: missing gl" #proc); return false; } \
+	} while(0)
+
+	GET_GLSL_PROC(PFNGLCREATESHADERPROC, CreateShader);
+	GET_GLSL_PROC(PFNGLSHADERSOURCEPROC, ShaderSource);
+	GET_GLSL_PROC(PFNGLCOMPILESHADERPROC, CompileShader);
+	GET_GLSL_PROC(PFNGLGETSHADERIVPROC, GetShaderiv);
+	GET_GLSL_PROC(PFNGLGETSHADERINFOLOGPROC, GetShaderInfoLog);
+	GET_GLSL_PROC(PFNGLDELETESHADERPROC, DeleteShader);
+	GET_GLSL_PROC(PFNGLCREATEPROGRAMPROC, CreateProgram);
+	GET_GLSL_PROC(PFNGLATTACHSHADERPROC, AttachShader);
+	GET_GLSL_PROC(PFNGLLINKPROGRAMPROC, LinkProgram);
+	GET_GLSL_PROC(PFNGLGETPROGRAMIVPROC, GetProgramiv);
+	GET_GLSL_PROC(PFNGLGETPROGRAMINFOLOGPROC, GetProgramInfoLog);
+	GET_GLSL_PROC(PFNGLDELETEPROGRAMPROC, DeleteProgram);
+	GET_GLSL_PROC(PFNGLUSEPROGRAMPROC, UseProgram);
+	GET_GLSL_PROC(PFNGLGETUNIFORMLOCATIONPROC, GetUniformLocation);
+	GET_GLSL_PROC(PFNGLUNIFORM1IPROC, Uniform1i);
+	GET_GLSL_PROC(PFNGLUNIFORM1FPROC, Uniform1f);
+	GET_GLSL_PROC(PFNGLUNIFORM2FPROC, Uniform2f);
+	GET_GLSL_PROC(PFNGLACTIVETEXTUREPROC, ActiveTexture);
+#undef GET_GLSL_PROC
+
+	GLuint vs = CompilePaletteShader(GL_VERTEX_SHADER, kPaletteVertexShader);
+	GLuint fs = CompilePaletteShader(GL_FRAGMENT_SHADER, kPaletteFragmentShader);
+	if (!vs || !fs)
+	{
+		if (vs) gGLSL.DeleteShader(vs);
+		if (fs) gGLSL.DeleteShader(fs);
+		return false;
+	}
+
+	GLuint program = gGLSL.CreateProgram();
+	gGLSL.AttachShader(program, vs);
+	gGLSL.AttachShader(program, fs);
+	gGLSL.LinkProgram(program);
+	gGLSL.DeleteShader(vs);		// flagged for deletion; freed along with the program
+	gGLSL.DeleteShader(fs);
+
+	GLint linked = 0;
+	gGLSL.GetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked)
+	{
+		char log[1024];
+		gGLSL.GetProgramInfoLog(program, sizeof(log), NULL, log);
+		SDL_Log("Palette shader didn't link: %s", log);
+		gGLSL.DeleteProgram(program);
+		return false;
+	}
+
+	gPaletteProgram = program;
+	gPaletteUniforms.indexTexture	= gGLSL.GetUniformLocation(program, "indexTexture");
+	gPaletteUniforms.paletteTexture	= gGLSL.GetUniformLocation(program, "paletteTexture");
+	gPaletteUniforms.textureSize	= gGLSL.GetUniformLocation(program, "textureSize");
+	gPaletteUniforms.visibleSize	= gGLSL.GetUniformLocation(program, "visibleSize");
+	gPaletteUniforms.prescale		= gGLSL.GetUniformLocation(program, "prescale");
+	gPaletteUniforms.smear			= gGLSL.GetUniformLocation(program, "smear");
+
+	// Drain any errors from probing so CHECK_GL_ERROR doesn't trip on them later
+	while (glGetError() != GL_NO_ERROR)
+		;
+
+	return true;
+}
+
+static void InitIndexTextures(bool withSmear)
+{
+	glGenTextures(1, &gIndexTexture);
+	glBindTexture(GL_TEXTURE_2D, gIndexTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);		// never interpolate palette indices
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(
+			GL_TEXTURE_2D,
+			0,
+			withSmear ? GL_LUMINANCE8_ALPHA8 : GL_LUMINANCE8,
+			kFrameTextureWidth,
+			kFrameTextureHeight,
+			0,
+			withSmear ? GL_LUMINANCE_ALPHA : GL_LUMINANCE,
+			GL_UNSIGNED_BYTE,
+			NULL);
+	CHECK_GL_ERROR();
+
+	glGenTextures(1, &gPaletteTexture);
+	glBindTexture(GL_TEXTURE_2D, gPaletteTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 1, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, NULL);
+	CHECK_GL_ERROR();
+
+	gIndexTextureHasSmear = withSmear;
+	gPaletteTextureStale = true;
+
+	// The new texture is blank, so the next frame must be uploaded in full
+	InvalidateFramebufferDamage();
+}
+
+static void DeleteIndexTextures(void)
+{
+	if (gIndexTexture != 0)
+	{
+		glDeleteTextures(1, &gIndexTexture);
+		gIndexTexture = 0;
+	}
+
+	if (gPaletteTexture != 0)
+	{
+		glDeleteTextures(1, &gPaletteTexture);
+		gPaletteTexture = 0;
+	}
+
+	if (gSmearStaging)
+	{
+		DisposePtr((Ptr) gSmearStaging);
+		gSmearStaging = NULL;
+	}
+}
+
+static void UploadIndexTextures(void)
+{
+	const int vw = VISIBLE_WIDTH;
+
+	bool wantSmear = gPresentPrefs.filterDithering;
+	if (wantSmear != gIndexTextureHasSmear)
+	{
+		DeleteIndexTextures();
+		InitIndexTextures(wantSmear);
+	}
+
+	// Palette: only 1 KB, but skip it if it hasn't changed
+	if (gPaletteTextureStale || 0 != SDL_memcmp(gUploadedPalette, gPresentSourcePalette->finalColors32, sizeof(gUploadedPalette)))
+	{
+		SDL_memcpy(gUploadedPalette, gPresentSourcePalette->finalColors32, sizeof(gUploadedPalette));
+		glBindTexture(GL_TEXTURE_2D, gPaletteTexture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, 1, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, gUploadedPalette);
+		CHECK_GL_ERROR();
+		gPaletteTextureStale = false;
+	}
+
+	// Indices: straight from the indexed framebuffer (or interleaved with smear flags)
+	if (UpdateFramebufferDamage(true) == 0)
+	{
+		return;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, gIndexTexture);
+
+	if (wantSmear && !gSmearStaging)
+	{
+		gSmearStaging = (uint8_t*) NewPtr(vw * VISIBLE_HEIGHT * 2);
+		GAME_ASSERT(gSmearStaging);
+	}
+
+	for (int i = 0; i < gFramebufferDamage.numBands; i++)
+	{
+		int firstRow = gFramebufferDamage.bands[i].firstRow;
+		int numRows = gFramebufferDamage.bands[i].numRows;
+
+		if (wantSmear)
+		{
+			IndexedFramebufferToSmearedIndices(gSmearStaging, 0, firstRow, numRows);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow, vw, numRows, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE,
+							gSmearStaging + firstRow * vw * 2);
+		}
+		else
+		{
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow, vw, numRows, GL_LUMINANCE, GL_UNSIGNED_BYTE,
+							gPresentSourceFramebuffer + firstRow * vw);
+		}
+		CHECK_GL_ERROR();
+	}
+}
+
+static void BindPaletteShader(void)
+{
+	float prescale = 0;
+	switch (gEffectiveScalingType)
+	{
+		case kScaling_Stretch:		prescale = 1; break;
+		case kScaling_HQStretch:	prescale = gPrescale; break;
+		default:					prescale = 0; break;
+	}
+
+	gGLSL.UseProgram(gPaletteProgram);
+	gGLSL.Uniform1i(gPaletteUniforms.indexTexture, 0);
+	gGLSL.Uniform1i(gPaletteUniforms.paletteTexture, 1);
+	gGLSL.Uniform2f(gPaletteUniforms.textureSize, kFrameTextureWidth, kFrameTextureHeight);
+	gGLSL.Uniform2f(gPaletteUniforms.visibleSize, VISIBLE_WIDTH, VISIBLE_HEIGHT);
+	gGLSL.Uniform1f(gPaletteUniforms.prescale, prescale);
+	gGLSL.Uniform1f(gPaletteUniforms.smear, gIndexTextureHasSmear ? 1 : 0);
+
+	gGLSL.ActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, gPaletteTexture);
+	gGLSL.ActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, gIndexTexture);
+	CHECK_GL_ERROR();
 }
 
+#pragma mark - Fixed-function path
+
 static void DeleteTextureAndPBO(void)
 {
 	if (gFrameTexture != 0)
@@ -170,25 +579,144 @@ static void DeleteTextureAndPBO(void)
 		gFrameTexture = 0;
 	}
 
-	if (gFramePBO != 0)
+	for (int i = 0; i < kMaxPBORingSize; i++)
+	{
+		PBORingSlot* slot = &gPBORing[i];
+
+		if (slot->fence)
+		{
+			gGLBufferStorage.DeleteSync(slot->fence);
+		}
+
+		if (slot->persistentMapping)
+		{
+			glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, slot->pbo);
+			glUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB);
+		}
+
+		if (slot->pbo != 0)
+		{
+			glDeleteBuffersARB(1, &slot->pbo);
+		}
+
+		SDL_zerop(slot);
+	}
+
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+}
+
+// Returns a pointer that ConvertFramebufferMT can write into,
+// once the GPU is done with whatever this slot held last time around the ring.
+static void* MapPBO(PBORingSlot* slot, int numBytes)
+{
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, slot->pbo);
+	CHECK_GL_ERROR();
+
+	if (slot->persistentMapping)
+	{
+		if (slot->fence)
+		{
+			GLenum status;
+			do
+			{
+				status = gGLBufferStorage.ClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100 * 1000 * 1000);
+			} while (status == GL_TIMEOUT_EXPIRED);
+			GAME_ASSERT(status != GL_WAIT_FAILED);
+
+			gGLBufferStorage.DeleteSync(slot->fence);
+			slot->fence = NULL;
+		}
+
+		return slot->persistentMapping;
+	}
+	else
+	{
+		// Orphan the old storage so the driver doesn't make us wait for the GPU
+		glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, numBytes, NULL, GL_STREAM_DRAW);
+		CHECK_GL_ERROR();
+
+		void* mappedBuffer = glMapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY);
+		CHECK_GL_ERROR();
+		GAME_ASSERT(mappedBuffer);
+		return mappedBuffer;
+	}
+}
+
+static void UnmapPBO(PBORingSlot* slot)
+{
+	if (!slot->persistentMapping)	// coherent persistent mappings stay mapped
 	{
-		glDeleteBuffersARB(1, &gFramePBO);
-		gFramePBO = 0;
+		glUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB);
+		CHECK_GL_ERROR();
 	}
 }
 
+#pragma mark - Upload benchmark
+
+// Times a few full-frame uploads (640x480) from client memory in the given format.
+// glFinish makes sure we measure the driver's actual conversion and transfer.
+static uint64_t TimeTextureUploads(const FramePixelFormat* pf, const void* pixels)
+{
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, pf->internalFormat, kFrameTextureWidth, kFrameTextureHeight, 0, pf->format, pf->type, NULL);
+
+	uint64_t start = 0;
+
+	for (int i = 0; i <= kUploadBenchmarkFrames; i++)
+	{
+		if (i == 1)		// first round is a warm-up
+		{
+			glFinish();
+			start = SDL_GetPerformanceCounter();
+		}
+
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 640, 480, pf->format, pf->type, pixels);
+	}
+
+	glFinish();
+	uint64_t ticks = SDL_GetPerformanceCounter() - start;
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glDeleteTextures(1, &texture);
+
+	// Some old drivers reject a format outright; never pick that one
+	if (glGetError() != GL_NO_ERROR)
+	{
+		return UINT64_MAX;
+	}
+
+	return ticks;
+}
+
+static int PickFastestBytesPerPixel(void)
+{
+	while (glGetError() != GL_NO_ERROR)		// don't blame the benchmark for earlier errors
+		;
+
+	void* pixels = NewPtrClear(640 * 480 * 4);
+	GAME_ASSERT(pixels);
+
+	uint64_t ticks16 = TimeTextureUploads(&kFramePixelFormat16, pixels);
+	uint64_t ticks32 = TimeTextureUploads(&kFramePixelFormat32, pixels);
+
+	DisposePtr((Ptr) pixels);
+
+	double msPerTick = 1000.0 / SDL_GetPerformanceFrequency();
+	SDL_Log("Upload benchmark: 565 %.2f ms, 8888 %.2f ms",
+			ticks16 == UINT64_MAX ? -1.0 : ticks16 * msPerTick / kUploadBenchmarkFrames,
+			ticks32 == UINT64_MAX ? -1.0 : ticks32 * msPerTick / kUploadBenchmarkFrames);
+
+	return ticks32 < ticks16 ? 4 : 2;		// ties go to 565, the historical default
+}
+
+#pragma mark - Driver
+
 void GLRender_Init(void)
 {
 	SDL_Log("Using special PPC renderer!");
 
-#if FRAMEBUFFER_COLOR_DEPTH == 32
-	gRendererName = "fastgl32";
-#elif FRAMEBUFFER_COLOR_DEPTH == 16
-	gRendererName = "fastgl16";
-#else
-	gRendererName = "gl??";
-#endif
-
 	gGLContext = SDL_GL_CreateContext(gSDLWindow);
 	GAME_ASSERT(gGLContext);
 
@@ -206,9 +734,9 @@ void GLRender_Init(void)
 	}
 
 #if OSXPPC
-	gCanDoHQStretch = false;
+	gMaxPrescale = 1;
 #else
-	gCanDoHQStretch = gMaxTextureSize >= 2*kFrameTextureWidth;
+	gMaxPrescale = SDL_clamp(gMaxTextureSize / kFrameTextureWidth, 1, MAX_PRESCALE);
 #endif
 
 	GL_GET_PROC_ADDRESS(PFNGLGENBUFFERSARBPROC, glGenBuffersARB);
@@ -218,6 +746,14 @@ void GLRender_Init(void)
 	GL_GET_PROC_ADDRESS(PFNGLMAPBUFFERARBPROC, glMapBufferARB);
 	GL_GET_PROC_ADDRESS(PFNGLBUFFERDATAARBPROC, glBufferDataARB);
 
+	gPersistentPBOs = InitPersistentMapping();
+
+	const char* ringSizeHint = SDL_GetHint(kPBORingSizeHint);
+	if (ringSizeHint)
+	{
+		gPBORingSize = SDL_clamp(SDL_atoi(ringSizeHint), 1, kMaxPBORingSize);
+	}
+
 #if !(NOVSYNC)
 	SDL_GL_SetSwapInterval(1);
 #else
@@ -243,14 +779,42 @@ void GLRender_Init(void)
 	glClear(GL_COLOR_BUFFER_BIT);
 	CHECK_GL_ERROR();
 
-	InitTextureAndPBO(1);
+	gUsePaletteShader = InitPaletteShader();
+
+	if (gUsePaletteShader)
+	{
+		gRendererName = "glsl8";
+#if !OSXPPC
+		gMaxPrescale = MAX_PRESCALE;	// done in the shader, no need for a larger texture
+#endif
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		InitIndexTextures(false);
+	}
+	else
+	{
+		gAutoBytesPerPixel = PickFastestBytesPerPixel();
+		InitTextureAndPBO(1, GetPreferredBytesPerPixel(gAutoBytesPerPixel));
+		SDL_Log("PBO ring: %d x %s", gPBORingSize, gPersistentPBOs ? "persistent" : "orphaned");
+	}
+
+	SDL_Log("GL renderer path: %s", gRendererName);
 }
 
 void GLRender_Shutdown(void)
 {
 	ShutdownRenderThreads();
 
+	// The present thread may have been using the context
+	SDL_GL_MakeCurrent(gSDLWindow, gGLContext);
+
 	DeleteTextureAndPBO();
+	DeleteIndexTextures();
+
+	if (gPaletteProgram)
+	{
+		gGLSL.DeleteProgram(gPaletteProgram);
+		gPaletteProgram = 0;
+	}
 
 	if (gGLContext)
 	{
@@ -259,6 +823,39 @@ void GLRender_Shutdown(void)
 	}
 }
 
+// Detaches the context from the calling thread so that another thread can present
+void GLRender_ReleaseContext(void)
+{
+	if (SDL_GL_GetCurrentContext() == gGLContext)
+	{
+		SDL_GL_MakeCurrent(gSDLWindow, NULL);
+	}
+}
+
+// Uploads the row bands that ConvertFramebufferMT wrote into the given PBO
+static void UploadDirtyBands(PBORingSlot* slot, int pixelZoom, int zvw)
+{
+	const FramePixelFormat* pf = GetFramePixelFormat();
+
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, slot->pbo);
+
+	for (int i = 0; i < gFramebufferDamage.numBands; i++)
+	{
+		int firstRow = gFramebufferDamage.bands[i].firstRow * pixelZoom;
+		int numRows = gFramebufferDamage.bands[i].numRows * pixelZoom;
+		uintptr_t pboOffset = (uintptr_t) firstRow * zvw * gFramebufferBytesPerPixel;
+
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow, zvw, numRows, pf->format, pf->type, (const void*) pboOffset);
+		CHECK_GL_ERROR();
+	}
+
+	if (slot->persistentMapping)
+	{
+		// Don't let MapPBO hand out this buffer again before the GPU has consumed it
+		slot->fence = gGLBufferStorage.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
 static SDL_Rect GetViewportSize(void)
 {
 	const int vw = VISIBLE_WIDTH;
@@ -292,7 +889,7 @@ static SDL_Rect GetViewportSize(void)
 void GLRender_PresentFramebuffer(void)
 {
 	static SDL_Rect previousViewportRect = {0};
-	static int previousEffectiveScalingType = kScaling_Unspecified;
+	static int previousPixelZoom = 1;
 	static int needClear = 60;
 
 	const int vw = VISIBLE_WIDTH;
@@ -312,38 +909,52 @@ void GLRender_PresentFramebuffer(void)
 		needClear = 60;
 	}
 
-	bool isHQ = gEffectiveScalingType == kScaling_HQStretch;
-	bool wasHQ = previousEffectiveScalingType == kScaling_HQStretch;
-	if (wasHQ ^ isHQ)
+	int pixelZoom = gUsePaletteShader ? 1 : gPrescale;		// the shader does HQ on its own
+	int bytesPerPixel = GetPreferredBytesPerPixel(gAutoBytesPerPixel);
+	if (!gUsePaletteShader
+		&& (pixelZoom != previousPixelZoom || bytesPerPixel != gFramebufferBytesPerPixel))
 	{
 		DeleteTextureAndPBO();
-		InitTextureAndPBO(isHQ? 2: 1);
+		InitTextureAndPBO(pixelZoom, bytesPerPixel);
 	}
-	previousEffectiveScalingType = gEffectiveScalingType;
+	previousPixelZoom = pixelZoom;
+
+	int zvw = pixelZoom * vw;
+	int zvh = pixelZoom * vh;
+
+	// Deferring the texture upload until after the swap is a marginal FPS
+	// increase on some drivers, at the cost of 1 frame of latency
+	bool deferUpload = gPresentPrefs.deferredTexUpload;
+	PBORingSlot* filledSlot = NULL;
 
-	int zvw = (isHQ ? 2 : 1) * vw;
-	int zvh = (isHQ ? 2 : 1) * vh;
+	uint64_t t0 = SDL_GetPerformanceCounter();
+	uint64_t t1 = t0;
+	uint64_t t2 = t0;
+	uint64_t uploadTicks = 0;
 
 	//-------------------------------------------------------------------------
 	// Update PBO
 
-	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, gFramePBO);
-	CHECK_GL_ERROR();
-
-	// get new PBO
-	int numBytes = zvw * zvh * kFrameBytesPerPixel;
-	glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, numBytes, NULL, GL_STREAM_DRAW);
-	CHECK_GL_ERROR();
+	if (gUsePaletteShader)
+	{
+		// No CPU conversion: upload indices and palette straight from client memory
+		UploadIndexTextures();
+		uploadTicks += SDL_GetPerformanceCounter() - t0;
+	}
+	else if (UpdateFramebufferDamage(false) > 0)	// skip the PBO round trip if no rows have changed
+	{
+		filledSlot = &gPBORing[gPBORingHead];
+		gPBORingHead = (gPBORingHead + 1) % gPBORingSize;
 
-	void* mappedBuffer = glMapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY);
-	CHECK_GL_ERROR();
-	GAME_ASSERT(mappedBuffer);
+		void* mappedBuffer = MapPBO(filledSlot, zvw * zvh * gFramebufferBytesPerPixel);
+		t1 = SDL_GetPerformanceCounter();
 
-	// now write data into the buffer, possibly in another thread
-	ConvertFramebufferMT(mappedBuffer);
+		// now write the dirty rows into the buffer, possibly in another thread
+		ConvertFramebufferMT(mappedBuffer);
+		t2 = SDL_GetPerformanceCounter();
 
-	glUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB);
-	CHECK_GL_ERROR();
+		UnmapPBO(filledSlot);
+	}
 
 	//-------------------------------------------------------------------------
 	// Draw the quad
@@ -361,16 +972,24 @@ void GLRender_PresentFramebuffer(void)
 		glClear(GL_COLOR_BUFFER_BIT);
 	}
 
-	glBindTexture(GL_TEXTURE_2D, gFrameTexture);
+	if (gUsePaletteShader)
+	{
+		BindPaletteShader();
+	}
+	else
+	{
+		glBindTexture(GL_TEXTURE_2D, gFrameTexture);
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
-					gEffectiveScalingType == kScaling_PixelPerfect ? GL_NEAREST : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
+						gEffectiveScalingType == kScaling_PixelPerfect ? GL_NEAREST : GL_LINEAR);
 
-#if !DEFERRED_TEX_UPDATE
-	// Update the texture
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, zvw, zvh, kFramePixelFormat, kFramePixelType, NULL);
-	CHECK_GL_ERROR();
-#endif
+		if (filledSlot && !deferUpload)
+		{
+			uint64_t uploadStart = SDL_GetPerformanceCounter();
+			UploadDirtyBands(filledSlot, pixelZoom, zvw);
+			uploadTicks += SDL_GetPerformanceCounter() - uploadStart;
+		}
+	}
 
 	const float umax = vw * (1.0f / kFrameTextureWidth);
 	const float vmax = vh * (1.0f / kFrameTextureHeight);
@@ -385,15 +1004,31 @@ void GLRender_PresentFramebuffer(void)
 	glEnd();
 	CHECK_GL_ERROR();
 
+	if (gUsePaletteShader)
+	{
+		gGLSL.UseProgram(0);
+	}
+
+	uint64_t t3 = SDL_GetPerformanceCounter();
+
 	SDL_GL_SwapWindow(gSDLWindow);
 
-#if DEFERRED_TEX_UPDATE
+	uint64_t t4 = SDL_GetPerformanceCounter();
+
 	//-------------------------------------------------------------------------
-	// Update texture
+	// Update texture for next frame
 
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, zvw, zvh, kFramePixelFormat, kFramePixelType, NULL);
-	CHECK_GL_ERROR();
-#endif
+	if (filledSlot && deferUpload)
+	{
+		UploadDirtyBands(filledSlot, pixelZoom, zvw);
+		uploadTicks += SDL_GetPerformanceCounter() - t4;
+	}
+
+	gRenderTimings.numFrames++;
+	gRenderTimings.map		+= t1 - t0;
+	gRenderTimings.convert	+= t2 - t1;
+	gRenderTimings.upload	+= uploadTicks;
+	gRenderTimings.swap		+= t4 - t3;
 }
 
 #endif // GLRENDER
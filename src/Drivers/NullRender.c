@@ -0,0 +1,139 @@
+// NULL RENDERING DRIVER
+// (C) 2025 Iliyas Jorio
+// This file is part of Mighty Mike. https://github.com/jorio/mightymike
+//
+// Headless driver for benchmarking and CI. No window, no swap chain:
+// frames go through the regular indexed -> RGB conversion into a buffer
+// that nobody looks at, and the game runs as fast as the CPU allows.
+//
+// Select it with MIGHTYMIKE_RENDER_DRIVER=null. Optional knobs:
+//   MIGHTYMIKE_NULL_DUMP_DIR=<dir>       write every presented frame to <dir>/frame000000.tga...
+//   MIGHTYMIKE_NULL_DUMP_INTERVAL=<n>    ...or only every nth frame
+//   MIGHTYMIKE_NULL_MAX_FRAMES=<n>       quit after presenting n frames
+
+#include <SDL3/SDL.h>
+#include "myglobals.h"
+#include "externs.h"
+#include "misc.h"
+#include "window.h"
+#include "renderdrivers.h"
+#include "framebufferfilter.h"
+
+#define kDumpDirHint		"MIGHTYMIKE_NULL_DUMP_DIR"
+#define kDumpIntervalHint	"MIGHTYMIKE_NULL_DUMP_INTERVAL"
+#define kMaxFramesHint		"MIGHTYMIKE_NULL_MAX_FRAMES"
+
+Boolean					gHeadless			= false;
+
+static void*			gFinalFramebuffer	= NULL;
+static const char*		gDumpDir			= NULL;
+static uint32_t			gDumpInterval		= 1;
+static uint32_t			gMaxFrames			= 0;		// 0: run forever
+
+static uint32_t			gTotalFrames		= 0;
+static uint64_t			gTotalConvertTicks	= 0;
+static uint64_t			gStartTicks			= 0;
+
+Boolean NullRender_Init(void)
+{
+	gHeadless = true;
+
+	gDumpDir = SDL_GetHint(kDumpDirHint);
+
+	const char* intervalHint = SDL_GetHint(kDumpIntervalHint);
+	if (intervalHint)
+		gDumpInterval = SDL_max(1, SDL_atoi(intervalHint));
+
+	const char* maxFramesHint = SDL_GetHint(kMaxFramesHint);
+	if (maxFramesHint)
+		gMaxFrames = SDL_max(0, SDL_atoi(maxFramesHint));
+
+	gRendererName = "null";
+
+	gStartTicks = SDL_GetPerformanceCounter();
+
+	SDL_Log("Null render driver: dump dir \"%s\", interval %u, max frames %u",
+			gDumpDir ? gDumpDir : "", gDumpInterval, gMaxFrames);
+
+	return true;
+}
+
+void NullRender_Shutdown(void)
+{
+	ShutdownRenderThreads();
+
+	CHECKED_DISPOSEPTR(gFinalFramebuffer);
+
+	// Print a summary for whoever is benchmarking us
+	double freq = (double) SDL_GetPerformanceFrequency();
+	double seconds = (SDL_GetPerformanceCounter() - gStartTicks) / freq;
+	SDL_Log("Null render driver: %u frames in %.2f s (%.1f fps), convert %.3f ms/frame",
+			gTotalFrames,
+			seconds,
+			gTotalFrames / SDL_max(seconds, 1e-6),
+			1000.0 * gTotalConvertTicks / freq / SDL_max(1, gTotalFrames));
+}
+
+void NullRender_InitTexture(void)
+{
+	CHECKED_DISPOSEPTR(gFinalFramebuffer);
+
+	// Nothing to upload, so there's nothing to benchmark: default to 32-bit
+	gFramebufferBytesPerPixel = GetPreferredBytesPerPixel(4);
+
+	static char rendererName[32];
+	SDL_snprintf(rendererName, sizeof(rendererName), "null-%d", gFramebufferBytesPerPixel * 8);
+	gRendererName = rendererName;
+
+	gFinalFramebuffer = NewPtrClear((VISIBLE_WIDTH * gPrescale) * (VISIBLE_HEIGHT * gPrescale) * gFramebufferBytesPerPixel);
+	GAME_ASSERT(gFinalFramebuffer);
+
+	InvalidateFramebufferDamage();
+}
+
+// The last converted frame, for hashing (see Harness.c)
+const void* NullRender_GetFinalFramebuffer(size_t* outSize)
+{
+	*outSize = (size_t) (VISIBLE_WIDTH * gPrescale) * (VISIBLE_HEIGHT * gPrescale) * gFramebufferBytesPerPixel;
+	return gFinalFramebuffer;
+}
+
+void NullRender_PresentFramebuffer(void)
+{
+	if (!gFinalFramebuffer || gFramebufferBytesPerPixel != GetPreferredBytesPerPixel(4))
+	{
+		NullRender_InitTexture();
+	}
+
+	//-------------------------------------------------------------------------
+	// Convert indexed to RGB, exactly as a real driver would
+
+	uint64_t t0 = SDL_GetPerformanceCounter();
+
+	UpdateFramebufferDamage(false);
+	ConvertFramebufferMT(gFinalFramebuffer);
+
+	uint64_t t1 = SDL_GetPerformanceCounter();
+
+	gRenderTimings.numFrames++;
+	gRenderTimings.convert += t1 - t0;
+	gTotalConvertTicks += t1 - t0;
+
+	//-------------------------------------------------------------------------
+	// Dump frame
+
+	if (gDumpDir && gTotalFrames % gDumpInterval == 0)
+	{
+		char path[1024];
+		SDL_snprintf(path, sizeof(path), "%s/frame%06u.tga", gDumpDir, gTotalFrames);
+		DumpIndexedTGA(path, VISIBLE_WIDTH, VISIBLE_HEIGHT, (const char*) gPresentSourceFramebuffer);
+	}
+
+	gTotalFrames++;
+
+	if (gMaxFrames != 0 && gTotalFrames >= gMaxFrames)
+	{
+		SDL_Log("Null render driver: reached %u frames, quitting", gMaxFrames);
+		CleanQuit();
+	}
+}
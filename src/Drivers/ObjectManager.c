@@ -265,6 +265,9 @@ register	ObjNode		*thisNodePtr;
 	if (FirstNodePtr == nil)				// see if there are any objects
 		return;
 
+	if (gPlayfieldView.live && !gPlayfieldView.presentedFrame)	// PF window not presented yet: get it out of the PF buffer before erasing
+		ResolvePlayfieldView();
+
 	thisNodePtr = FirstNodePtr;
 
 				/* MAIN NODE TASK LOOP */
@@ -290,6 +293,8 @@ register	ObjNode		*thisNodePtr;
 
 	thisNodePtr = FirstNodePtr;
 
+	BeginSpriteBatch();						// PF sprites get drawn in parallel at the end
+
 					/* MAIN NODE TASK LOOP */
 
 	do
@@ -298,6 +303,8 @@ register	ObjNode		*thisNodePtr;
 			DrawASprite(thisNodePtr);			// draw it
 		thisNodePtr = (ObjNode *)thisNodePtr->NextNode;
 	}while (thisNodePtr != nil);
+
+	EndSpriteBatch();
 }
 
 
@@ -644,6 +651,8 @@ void DumpUpdateRegions_DontPresentFramebuffer(void)
 	if (numRegions == 0)
 		return;
 
+	ResolvePlayfieldView();
+
 
 					/* UPDATE ALL OF THE REGIONS */
 
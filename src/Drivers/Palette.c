@@ -13,6 +13,7 @@
 #include "myglobals.h"
 #include "misc.h"
 #include "window.h"
+#include "renderdrivers.h"
 
 #include <math.h>
 
@@ -20,19 +21,55 @@
 /*    CONSTANTS             */
 /****************************/
 
-static const int kFadeDurationMacTicks = 15;
+static const int kFadeDurationMS = 15 * 1000 / 60;			// 15 Mac ticks
+#define kNumFadeSteps 32									// brightness levels between black and full
 
 /**********************/
 /*     VARIABLES      */
 /**********************/
 
 GamePalette				gGamePalette;
-static	GamePalette		gBackUpPalette;
 
 Boolean					gScreenBlankedFlag = false;
 uint16_t				gAppleRGBToLinear[1 << 16];
 uint8_t					gLinearToSRGB[1 << 16];
 
+		/* FADE STATE */
+		//
+		// gGamePalette.baseColors always holds the target colors;
+		// only finalColors16/32 get dimmed while a fade is in progress.
+		//
+
+enum
+{
+	kFade_None,
+	kFade_In,
+	kFade_Out,
+};
+
+static	int				gFadeDirection = kFade_None;
+static	int				gFadeStartLevel = kNumFadeSteps;
+static	int				gFadeLevel = kNumFadeSteps;		// 0 (black) to kNumFadeSteps (full brightness)
+static	uint64_t		gFadeStartTime = 0;
+
+		/* PRECOMPUTED FADE PALETTES */
+		//
+		// One row per brightness level, built lazily from the base colors
+		// so that each fade frame is a memcpy instead of 255 color conversions.
+		//
+
+static	uint32_t		gFadeColors32[kNumFadeSteps+1][256];
+static	uint16_t		gFadeColors16[kNumFadeSteps+1][256];
+static	Boolean			gFadeStepReady[kNumFadeSteps+1];
+static	RGBColor		gFadeBaseColors[256];			// base colors that the fade tables were built from
+static	Byte			gFadeColorCorrection = 0xFF;	// colorCorrection pref that the fade tables were built with
+
+static void ConvertPaletteColor(const RGBColor* color, uint32_t* outColor32, uint16_t* outColor16);
+static void BuildColorCorrectionTables(void);
+#if _DEBUG
+static void CheckColorCorrectionTables(void);
+#endif
+
 /********************** INIT PALETTE STUFF ****************/
 
 void InitPaletteStuff(void)
@@ -43,82 +80,249 @@ void InitPaletteStuff(void)
 		gGamePalette.baseColors[i]		= (RGBColor) {0,0,0};
 		gGamePalette.finalColors32[i]	= 0x000000FF;
 		gGamePalette.finalColors16[i]	= 0x0000;
-		gBackUpPalette.baseColors[i]	= (RGBColor) {0,0,0};
-		gBackUpPalette.finalColors32[i]	= 0x000000FF;
-		gBackUpPalette.finalColors16[i]	= 0x0000;
 	}
 
+	BuildColorCorrectionTables();
+}
+
+/****************** BUILD COLOR CORRECTION TABLES ******************/
+//
+// Rather than one pow() per entry (131,072 calls on the boot path), sample the curves
+// sparingly (about 1,300 calls). The results stay within one unit of the exact tables
+// (see CheckColorCorrectionTables).
+//
+
+#define kAppleGammaSegments 1024
+
+static void BuildColorCorrectionTables(void)
+{
+			/* APPLE RGB (GAMMA 1.8) -> LINEAR */
+			//
+			// x^1.8 is smooth enough that linear interpolation between 1025 exact samples
+			// is off by at most 1 in 65535.
+			//
+
+	double samples[kAppleGammaSegments + 1];
+
+	for (int s = 0; s <= kAppleGammaSegments; s++)
+	{
+		samples[s] = pow((double)s / kAppleGammaSegments, 1.8) * 65535.0;
+	}
+
+	for (int i = 0; i < (1 << 16); i++)
+	{
+		double x = (double)i * kAppleGammaSegments / 0xffff;
+		int s = SDL_min((int)x, kAppleGammaSegments - 1);
+		double v = samples[s] + (samples[s+1] - samples[s]) * (x - s);
+		gAppleRGBToLinear[i] = (uint16_t)floor(v + 0.5);
+	}
+
+			/* LINEAR -> SRGB */
+			//
+			// The output only has 256 levels, so find where each level starts (one pow() each)
+			// and fill in the runs. This reproduces the pow() table exactly.
+			//
+			// Note: below 0.0031308, the original table divided by 12.92 instead of multiplying,
+			// so that stretch maps to 0. It's kept that way so that dark colors don't shift.
+			//
+
+	int i = 0;
+
+	const int toeEnd = (int)ceil(0.0031308 * 0xffff);
+	while (i < toeEnd)
+	{
+		gLinearToSRGB[i++] = 0;
+	}
+
+	for (int level = 0; level < 255; level++)
+	{
+		double srgbIntensity = (level + 0.5) / 255.0;						// rounds up to level+1 past this point
+		double linearScale = pow((srgbIntensity + 0.055) / 1.055, 2.4);
+		int nextLevelStart = (int)ceil(linearScale * 0xffff);
+
+		while (i < nextLevelStart)
+		{
+			gLinearToSRGB[i++] = (uint8_t)level;
+		}
+	}
+
+	while (i < (1 << 16))
+	{
+		gLinearToSRGB[i++] = 255;
+	}
+
+#if _DEBUG
+	CheckColorCorrectionTables();
+#endif
+}
+
+#if _DEBUG
+static void CheckColorCorrectionTables(void)
+{
+	int maxAppleError = 0;
+	int maxSRGBError = 0;
+
 	for (int i = 0; i < (1 << 16); i++)
 	{
 		double linearScale = ((double)i) / (double)0xffff;
 		double appleRGBToLinear = pow(linearScale, 1.8);
-		gAppleRGBToLinear[i] = (uint16_t)(floor(appleRGBToLinear * 65535.0 + 0.5));
+		int exactLinear = (int)(floor(appleRGBToLinear * 65535.0 + 0.5));
 
 		double srgbIntensity = 0.0;
 		if (linearScale < 0.0031308)
 			srgbIntensity = linearScale / 12.92;
 		else
 			srgbIntensity = 1.055 * pow(linearScale, 1.0 / 2.4) - 0.055;
+		int exactSRGB = (int)floor(srgbIntensity * 255.0 + 0.5);
 
-		gLinearToSRGB[i] = (uint8_t)floor(srgbIntensity * 255.0 + 0.5);
+		maxAppleError = SDL_max(maxAppleError, SDL_abs(exactLinear - gAppleRGBToLinear[i]));
+		maxSRGBError = SDL_max(maxSRGBError, SDL_abs(exactSRGB - gLinearToSRGB[i]));
 	}
+
+	GAME_ASSERT_MESSAGE(maxAppleError <= 1, "Apple RGB -> linear table is off");
+	GAME_ASSERT_MESSAGE(maxSRGBError == 0, "linear -> sRGB table is off");
 }
+#endif
 
-/********************* MAKE BACKUP PALETTE *******************/
+#pragma mark -
 
-static void MakeBackUpPalette(void)
+/******************* APPLY FADE LEVEL *********************/
+//
+// Sets gGamePalette's final colors to the base colors dimmed to the given level.
+//
+
+static void ApplyFadeLevel(int level)
 {
-	SDL_memcpy(&gBackUpPalette, &gGamePalette, sizeof(GamePalette));
+	GAME_ASSERT(level >= 0 && level <= kNumFadeSteps);
+
+			/* SEE IF FADE TABLES ARE STALE */
+			//
+			// The game may change palette entries mid-fade, or the player may toggle color correction.
+			//
+
+	if (gFadeColorCorrection != gGamePrefs.colorCorrection
+		|| 0 != SDL_memcmp(gFadeBaseColors, gGamePalette.baseColors, sizeof(gFadeBaseColors)))
+	{
+		SDL_memcpy(gFadeBaseColors, gGamePalette.baseColors, sizeof(gFadeBaseColors));
+		gFadeColorCorrection = gGamePrefs.colorCorrection;
+		SDL_zeroa(gFadeStepReady);
+	}
+
+			/* BUILD THIS LEVEL'S TABLE IF NEEDED */
+
+	if (!gFadeStepReady[level])
+	{
+		for (int i = 0; i < 255; i++)
+		{
+			RGBColor rgbColor = gFadeBaseColors[i];
+			rgbColor.red	= (unsigned short)((int32_t)rgbColor.red	* level / kNumFadeSteps);
+			rgbColor.green	= (unsigned short)((int32_t)rgbColor.green	* level / kNumFadeSteps);
+			rgbColor.blue	= (unsigned short)((int32_t)rgbColor.blue	* level / kNumFadeSteps);
+			ConvertPaletteColor(&rgbColor, &gFadeColors32[level][i], &gFadeColors16[level][i]);
+		}
+
+		ConvertPaletteColor(&gFadeBaseColors[255], &gFadeColors32[level][255], &gFadeColors16[level][255]);	// 255 never fades
+
+		gFadeStepReady[level] = true;
+	}
+
+	SDL_memcpy(gGamePalette.finalColors32, gFadeColors32[level], sizeof(gGamePalette.finalColors32));
+	SDL_memcpy(gGamePalette.finalColors16, gFadeColors16[level], sizeof(gGamePalette.finalColors16));
+
+	gFadeLevel = level;
 }
 
-/********************* RESTORE BACKUP PALETTE *******************/
+/******************* START FADE IN/OUT *********************/
+//
+// Non-blocking fades. The fade advances every time PresentIndexedFramebuffer is called,
+// so the caller's loop keeps servicing input and sound in the meantime.
+// A fade that reverses direction midway picks up from the current brightness;
+// otherwise, fades start from black (in) or full brightness (out).
+//
 
-static void RestoreBackUpPalette(void)
+void StartFadeInGameCLUT(void)
 {
-	SDL_memcpy(&gGamePalette, &gBackUpPalette, sizeof(GamePalette));
+	gScreenBlankedFlag = false;									// unlock PresentIndexedFramebuffer
+
+	gFadeStartLevel = (gFadeDirection == kFade_Out) ? gFadeLevel : 0;
+	gFadeDirection = kFade_In;
+	gFadeStartTime = SDL_GetTicks();
+
+	ApplyFadeLevel(gFadeStartLevel);
 }
 
+void StartFadeOutGameCLUT(void)
+{
+	if (gScreenBlankedFlag)										// see if already out
+		return;
 
-/************************ FADE IN GAME CLUT ********************/
+	gFadeStartLevel = (gFadeDirection == kFade_In) ? gFadeLevel : kNumFadeSteps;
+	gFadeDirection = kFade_Out;
+	gFadeStartTime = SDL_GetTicks();
+}
 
-void FadeInGameCLUT(void)
+Boolean IsGameCLUTFading(void)
 {
-						/* BACK UP TARGET COLORS */
+	return gFadeDirection != kFade_None;
+}
 
-	MakeBackUpPalette();
-	
-						/* UNLOCK PresentIndexedFramebuffer */
+/******************* UPDATE GAME CLUT FADE *********************/
+//
+// Called by PresentIndexedFramebuffer before it snapshots the palette.
+//
+
+void UpdateGameCLUTFade(void)
+{
+	if (gFadeDirection == kFade_None)
+		return;
 
-	gScreenBlankedFlag = false;
+	int elapsedSteps = (int)((SDL_GetTicks() - gFadeStartTime) * kNumFadeSteps / kFadeDurationMS);
 
-						/* FADE IN THE CLUT */
+	if (gHeadless)												// no one's watching, and a headless run must not depend on the wall clock
+		elapsedSteps = kNumFadeSteps;
 
-	const UInt32 start = TickCount();
+	if (gFadeDirection == kFade_In)
+	{
+		int level = SDL_min(kNumFadeSteps, gFadeStartLevel + elapsedSteps);
+		ApplyFadeLevel(level);
 
-	while (1)
+		if (level == kNumFadeSteps)
+			gFadeDirection = kFade_None;
+	}
+	else
 	{
-		int brightness = 100 * (int)(TickCount() - start) / kFadeDurationMacTicks;
+		int level = SDL_max(0, gFadeStartLevel - elapsedSteps);
 
-		if (brightness > 100)
-			break;
-		
-		for (int i = 0; i < 255; i++)
+		if (level > 0)
+		{
+			ApplyFadeLevel(level);
+		}
+		else
 		{
-			RGBColor rgbColor = gBackUpPalette.baseColors[i]; // get color from palette
-			rgbColor.red	= (short)((int32_t)rgbColor.red		* brightness /100);
-			rgbColor.green	= (short)((int32_t)rgbColor.green	* brightness /100);
-			rgbColor.blue	= (short)((int32_t)rgbColor.blue	* brightness /100);
-			SetPaletteColor(&gGamePalette, i, &rgbColor);		// set it
+					/* LOCK PresentIndexedFramebuffer UNTIL NEXT FADEIN */
+
+			gScreenBlankedFlag = true;
+			gFadeDirection = kFade_None;
+			ApplyFadeLevel(kNumFadeSteps);						// nothing gets presented while blanked, so go back to the true colors
 		}
+	}
+}
+
+#pragma mark -
 
-		PresentIndexedFramebuffer();
+/************************ FADE IN GAME CLUT ********************/
+
+void FadeInGameCLUT(void)
+{
+	StartFadeInGameCLUT();
+
+	while (IsGameCLUTFading())
+	{
+		PresentIndexedFramebuffer();							// advances the fade
 		ReadKeyboard();		// flush keypresses
 		RegulateSpeed2(1);
 	}
 
-						/* SET TO ORIGINAL PALETTE TO BE SURE */
-
-	RestoreBackUpPalette();
 	PresentIndexedFramebuffer();
 }
 
@@ -140,53 +344,26 @@ void EraseCLUT(void)
 	}
 
 	gScreenBlankedFlag = true;
+	gFadeDirection = kFade_None;								// cancel any fade in progress
 }
 
 
 
 /************************ FADE OUT GAME CLUT ********************/
-//
-// BASES IT ON THE BACKUP PALETTE!!!!!!!!
-//
 
 void FadeOutGameCLUT(void)
 {
 	if (gScreenBlankedFlag)									// see if already out
 		return;
 
+	StartFadeOutGameCLUT();
 
-	MakeBackUpPalette();									// (needs backup pal to do fade)
-
-						/* FADE OUT THE CLUT */
-
-	const UInt32 start = TickCount();
-
-	while (1)
+	while (IsGameCLUTFading())
 	{
-		int brightness = 100 - (int)(100 * (TickCount() - start) / kFadeDurationMacTicks);
-
-		if (brightness < 0)
-			break;
-		
-		for (int i = 0; i < 255; i++)
-		{
-			RGBColor rgbColor = gBackUpPalette.baseColors[i]; // get color from palette
-			rgbColor.red	= (short)((int32_t)rgbColor.red		* brightness /100);
-			rgbColor.green	= (short)((int32_t)rgbColor.green	* brightness /100);
-			rgbColor.blue	= (short)((int32_t)rgbColor.blue	* brightness /100);
-			SetPaletteColor(&gGamePalette, i, &rgbColor);		// set it
-		}
-
-		PresentIndexedFramebuffer();
+		PresentIndexedFramebuffer();							// advances the fade; blanks the screen when done
 		ReadKeyboard();		// flush keypresses
 		RegulateSpeed2(1);
 	}
-
-			/* LOCK PresentIndexedFramebuffer UNTIL NEXT FADEIN */
-
-	gScreenBlankedFlag = true;
-
-	RestoreBackUpPalette();
 }
 
 static void ResetSinglePaletteColorCorrection(struct GamePalette_s *palette)
@@ -200,10 +377,18 @@ static void ResetSinglePaletteColorCorrection(struct GamePalette_s *palette)
 void SetPaletteColorCorrection(void)
 {
 	ResetSinglePaletteColorCorrection(&gGamePalette);
-	ResetSinglePaletteColorCorrection(&gBackUpPalette);
+
+	if (IsGameCLUTFading())
+		ApplyFadeLevel(gFadeLevel);							// keep the current brightness (rebuilds the fade tables)
 }
 
 void SetPaletteColor(struct GamePalette_s *palette, int index, const RGBColor *color)
+{
+	palette->baseColors[index] = *color;
+	ConvertPaletteColor(color, &palette->finalColors32[index], &palette->finalColors16[index]);
+}
+
+static void ConvertPaletteColor(const RGBColor* color, uint32_t* outColor32, uint16_t* outColor16)
 {
 	uint32_t color32;
 	uint16_t color16;
@@ -247,7 +432,6 @@ void SetPaletteColor(struct GamePalette_s *palette, int index, const RGBColor *c
 		color16 = RGBColorToU16_565(color);
 	}
 
-	palette->baseColors[index] = *color;
-	palette->finalColors32[index] = color32;
-	palette->finalColors16[index] = color16;
+	*outColor32 = color32;
+	*outColor16 = color16;
 }
@@ -26,9 +26,65 @@ static void DoFatalSDLError(int error, const char* file, int line)
 
 static SDL_Renderer*	gSDLRenderer		= NULL;
 static SDL_Texture*		gSDLTexture			= NULL;
-static color_t*			gFinalFramebuffer	= NULL;
+static void*			gFinalFramebuffer	= NULL;
 const char*				gRendererName		= "NULL";
-Boolean					gCanDoHQStretch		= true;
+int						gMaxPrescale		= MAX_PRESCALE;
+static int				gAutoBytesPerPixel	= 4;		// whichever color depth uploaded faster at startup
+
+#define kUploadBenchmarkFrames 8
+
+// Times a few full-frame texture updates in the given format.
+// Draw and flush each time, because some backends defer the actual upload until the texture is used.
+static uint64_t TimeTextureUploads(SDL_PixelFormat format, int bytesPerPixel, const void* pixels, int width, int height)
+{
+	SDL_Texture* texture = SDL_CreateTexture(gSDLRenderer, format, SDL_TEXTUREACCESS_STREAMING, width, height);
+	if (!texture)
+	{
+		return UINT64_MAX;
+	}
+
+	uint64_t start = 0;
+
+	for (int i = 0; i <= kUploadBenchmarkFrames; i++)
+	{
+		if (i == 1)		// first round is a warm-up
+		{
+			start = SDL_GetPerformanceCounter();
+		}
+
+		SDL_UpdateTexture(texture, NULL, pixels, width * bytesPerPixel);
+		SDL_RenderTexture(gSDLRenderer, texture, NULL, NULL);
+		SDL_FlushRenderer(gSDLRenderer);
+	}
+
+	uint64_t ticks = SDL_GetPerformanceCounter() - start;
+
+	SDL_DestroyTexture(texture);
+	return ticks;
+}
+
+static int PickFastestBytesPerPixel(void)
+{
+	const int width = 640;
+	const int height = 480;
+
+	void* pixels = NewPtrClear(width * height * 4);
+	GAME_ASSERT(pixels);
+
+	uint64_t ticks16 = TimeTextureUploads(SDL_PIXELFORMAT_RGB565, 2, pixels, width, height);
+	uint64_t ticks32 = TimeTextureUploads(SDL_PIXELFORMAT_RGBA8888, 4, pixels, width, height);
+
+	DisposePtr((Ptr) pixels);
+
+	SDL_RenderClear(gSDLRenderer);
+
+	double msPerTick = 1000.0 / SDL_GetPerformanceFrequency();
+	SDL_Log("Upload benchmark: 565 %.2f ms, 8888 %.2f ms",
+			ticks16 == UINT64_MAX ? -1.0 : ticks16 * msPerTick / kUploadBenchmarkFrames,
+			ticks32 == UINT64_MAX ? -1.0 : ticks32 * msPerTick / kUploadBenchmarkFrames);
+
+	return ticks16 < ticks32 ? 2 : 4;
+}
 
 Boolean SDLRender_Init(void)
 {
@@ -41,15 +97,16 @@ Boolean SDLRender_Init(void)
 	SDL_SetRenderVSync(gSDLRenderer, 1);
 #endif
 	
-	const char* sdlRendererName = SDL_GetRendererName(gSDLRenderer);
-	if (sdlRendererName)
+	gAutoBytesPerPixel = PickFastestBytesPerPixel();
+
+	SDL_SetRenderLogicalPresentation(gSDLRenderer, VISIBLE_WIDTH, VISIBLE_HEIGHT, SDL_LOGICAL_PRESENTATION_LETTERBOX);
+
+	// Don't prescale past what the renderer can hold in a texture (assume the widest playfield)
+	int maxTextureSize = (int) SDL_GetNumberProperty(SDL_GetRendererProperties(gSDLRenderer), SDL_PROP_RENDERER_MAX_TEXTURE_SIZE_NUMBER, 0);
+	if (maxTextureSize > 0)
 	{
-		static char rendererName[32];
-		SDL_snprintf(rendererName, sizeof(rendererName), "sdl-%s-%d", sdlRendererName, (int) sizeof(color_t) * 8);
-		gRendererName = rendererName;
+		gMaxPrescale = SDL_clamp(maxTextureSize / 1024, 1, MAX_PRESCALE);
 	}
-	
-	SDL_SetRenderLogicalPresentation(gSDLRenderer, VISIBLE_WIDTH, VISIBLE_HEIGHT, SDL_LOGICAL_PRESENTATION_LETTERBOX);
 
 	return true;
 }
@@ -88,20 +145,26 @@ void SDLRender_InitTexture(void)
 	SDLRender_NukeTextureAndBuffers();
 
 	bool crisp = (gEffectiveScalingType == kScaling_PixelPerfect);
-	int textureSizeMultiplier = (gEffectiveScalingType == kScaling_HQStretch) ? 2 : 1;
+	int textureSizeMultiplier = gPrescale;
+
+	gFramebufferBytesPerPixel = GetPreferredBytesPerPixel(gAutoBytesPerPixel);
+
+	const char* sdlRendererName = SDL_GetRendererName(gSDLRenderer);
+	if (sdlRendererName)
+	{
+		static char rendererName[32];
+		SDL_snprintf(rendererName, sizeof(rendererName), "sdl-%s-%d", sdlRendererName, gFramebufferBytesPerPixel * 8);
+		gRendererName = rendererName;
+	}
 
 	// Allocate buffer
-	gFinalFramebuffer = (color_t*) NewPtrClear((VISIBLE_WIDTH * 2) * (VISIBLE_HEIGHT * 2) * (int) sizeof(color_t));
+	gFinalFramebuffer = NewPtrClear((VISIBLE_WIDTH * gPrescale) * (VISIBLE_HEIGHT * gPrescale) * gFramebufferBytesPerPixel);
 	GAME_ASSERT(gFinalFramebuffer);
 
 	// Recreate texture
 	gSDLTexture = SDL_CreateTexture(
 			gSDLRenderer,
-#if FRAMEBUFFER_COLOR_DEPTH == 16
-			SDL_PIXELFORMAT_RGB565,
-#else
-			SDL_PIXELFORMAT_RGBA8888,
-#endif
+			gFramebufferBytesPerPixel == 2 ? SDL_PIXELFORMAT_RGB565 : SDL_PIXELFORMAT_RGBA8888,
 			SDL_TEXTUREACCESS_STREAMING,
 			VISIBLE_WIDTH * textureSizeMultiplier,
 			VISIBLE_HEIGHT * textureSizeMultiplier);
@@ -112,27 +175,55 @@ void SDLRender_InitTexture(void)
 
 	// Set logical size
 	SDL_SetRenderLogicalPresentation(gSDLRenderer, VISIBLE_WIDTH, VISIBLE_HEIGHT, crisp ? SDL_LOGICAL_PRESENTATION_INTEGER_SCALE : SDL_LOGICAL_PRESENTATION_LETTERBOX);
+
+	// The new texture and buffer are blank, so the next frame must be converted in full
+	InvalidateFramebufferDamage();
 }
 
 void SDLRender_PresentFramebuffer(void)
 {
 	bool success = true;
 
+	// Color depth pref changed?
+	if (gFramebufferBytesPerPixel != GetPreferredBytesPerPixel(gAutoBytesPerPixel))
+	{
+		SDLRender_InitTexture();
+	}
+
 	//-------------------------------------------------------------------------
 	// Convert indexed to RGBA, with optional post-processing
+	// (only the rows that changed since the last frame)
+
+	uint64_t t0 = SDL_GetPerformanceCounter();
 
+	UpdateFramebufferDamage(false);
 	ConvertFramebufferMT(gFinalFramebuffer);
 
+	uint64_t t1 = SDL_GetPerformanceCounter();
+
 	//-------------------------------------------------------------------------
 	// Update SDL texture
 
-	int pitch = VISIBLE_WIDTH * (int) sizeof(color_t);
+	int pixelZoom = gPrescale;
+	int pitch = pixelZoom * VISIBLE_WIDTH * gFramebufferBytesPerPixel;
 
-	if (gEffectiveScalingType == kScaling_HQStretch)
-		pitch *= 2;
+	for (int i = 0; i < gFramebufferDamage.numBands; i++)
+	{
+		SDL_Rect rect =
+		{
+			.x = 0,
+			.y = gFramebufferDamage.bands[i].firstRow * pixelZoom,
+			.w = VISIBLE_WIDTH * pixelZoom,
+			.h = gFramebufferDamage.bands[i].numRows * pixelZoom,
+		};
+
+		const uint8_t* pixels = (const uint8_t*) gFinalFramebuffer + rect.y * pitch;
+
+		success = SDL_UpdateTexture(gSDLTexture, &rect, pixels, pitch);
+		CHECK_SDL_ERROR(success);
+	}
 
-	success = SDL_UpdateTexture(gSDLTexture, NULL, gFinalFramebuffer, pitch);
-	CHECK_SDL_ERROR(success);
+	uint64_t t2 = SDL_GetPerformanceCounter();
 
 	//-------------------------------------------------------------------------
 	// Present it
@@ -141,6 +232,13 @@ void SDLRender_PresentFramebuffer(void)
 	success = SDL_RenderTexture(gSDLRenderer, gSDLTexture, NULL, NULL);
 	CHECK_SDL_ERROR(success);
 	SDL_RenderPresent(gSDLRenderer);
+
+	uint64_t t3 = SDL_GetPerformanceCounter();
+
+	gRenderTimings.numFrames++;
+	gRenderTimings.convert	+= t1 - t0;
+	gRenderTimings.upload	+= t2 - t1;
+	gRenderTimings.swap		+= t3 - t2;
 }
 
 #endif
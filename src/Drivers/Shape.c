@@ -15,6 +15,7 @@
 #include "misc.h"
 #include "shape.h"
 #include "externs.h"
+#include "jobs.h"
 
 /****************************/
 /*    PROTOTYPES            */
@@ -22,11 +23,77 @@
 
 static void DrawPFSprite(ObjNode *theNodePtr);
 static void ErasePFSprite(ObjNode *theNodePtr);
+static const FrameHeader* GetFrameHeader(long groupNum, long shapeNum, long frameNum, const uint8_t** outPixelPtr, const uint8_t** outMaskPtr);
+static void BuildFrameTable(long groupNum);
+static void DisposeFrameTable(long groupNum);
 
 /****************************/
 /*    CONSTANTS             */
 /****************************/
 
+enum
+{
+	kSpan_Transparent,		// mask set, no pixel: background shows through, nothing to draw
+	kSpan_Opaque,			// mask clear: pixels overwrite the background
+	kSpan_Masked,			// anything else: blend with the mask
+};
+
+// Rough cost of setting up a span, in 16-pixel vectors (measured on x86-64)
+#define kSpanOverhead		8
+
+// Blending a few transparent pixels with the vector kernels costs less than starting a new span,
+// so only transparent runs at least this long are skipped (except at either end of a row)
+#define kMinSkippedRun		(16 * kSpanOverhead)
+
+typedef struct SpriteSpan
+{
+	int16_t		x;
+	int16_t		length;
+	int16_t		kind;
+} SpriteSpan;
+
+//
+// Runs of opaque or masked pixels in each row of a frame, built at load time
+// so that the blitters can skip transparent runs and copy opaque ones outright.
+// rowStart[numRows+1] indexes into the span array, which follows it in memory.
+//
+
+typedef struct FrameSpans
+{
+	int32_t		numRows;
+	int32_t		useSpans;		// false if blitting the whole rectangle is cheaper
+	int32_t		rowStart[];
+} FrameSpans;
+
+static inline const SpriteSpan* GetSpanArray(const FrameSpans* fs)
+{
+	return (const SpriteSpan*) &fs->rowStart[fs->numRows + 1];
+}
+
+// Sprite batches: PF sprite blits are queued up by DrawObjects, sorted into bands of PF buffer rows,
+// and the bands are drawn in parallel. Each band draws its blits in queue order, so sprites overlap
+// exactly as they would if they were drawn one by one.
+
+#define kRowsPerSpriteBand		16
+#define kMaxSpriteBands			64
+#define kMaxQueuedPFBlits		(MAX_OBJECTS * 4)		// up to 2 horizontal x 2 vertical segments per sprite
+#define kMaxSpriteBandEntries	4096
+#define kMinPFBlitsForParallel	8						// below this, waking up the workers costs more than it saves
+
+#define kParallelSpritesHint	"MIGHTYMIKE_PARALLEL_SPRITES"
+
+typedef struct PFBlit
+{
+	const FrameDesc*	fd;
+	int16_t				firstRow;
+	int16_t				numRows;
+	int16_t				colStart;
+	int16_t				colEnd;
+	int16_t				x;
+	int16_t				y;
+	bool				priorityFlag;
+} PFBlit;
+
 /**********************/
 /*     VARIABLES      */
 /**********************/
@@ -37,6 +104,20 @@ Ptr		gSHAPE_HEADER_Ptrs[MAX_SHAPE_GROUPS][MAX_SHAPES_IN_FILE];			// holds ptr to
 
 static	short		gNumShapesInFile[MAX_SHAPE_GROUPS];
 
+static	FrameDesc*	gFrameTable[MAX_SHAPE_GROUPS];								// every frame of every shape in the group
+static	int32_t		gFirstFrameOfShape[MAX_SHAPE_GROUPS][MAX_SHAPES_IN_FILE];	// index of each shape's frame #0 in gFrameTable
+static	int16_t		gNumFramesOfShape[MAX_SHAPE_GROUPS][MAX_SHAPES_IN_FILE];
+static	Ptr			gFrameSpanData[MAX_SHAPE_GROUPS];							// FrameSpans of every frame in the group
+
+static	int			gParallelSprites = -1;					// -1: hint not read yet
+static	bool		gSpriteBatchActive = false;
+static	PFBlit		gPFBlitQueue[kMaxQueuedPFBlits];
+static	int			gNumQueuedPFBlits = 0;
+static	int			gNumQueuedBandEntries = 0;
+static	int16_t		gBandEntries[kMaxSpriteBandEntries];		// indices into gPFBlitQueue, grouped by band
+static	int			gBandFirstEntry[kMaxSpriteBands + 1];
+static	int16_t		gBandJobs[kMaxSpriteBands];					// bands that have anything to draw
+
 ObjNode	*gMostRecentShape = nil;
 
 
@@ -123,6 +204,7 @@ void LoadShapeTable(const char* fileName, long groupNum)
 	{
 		DisposeHandle(gShapeTableHandle[groupNum]);
 		SDL_memset(gSHAPE_HEADER_Ptrs[groupNum], 0, sizeof(gSHAPE_HEADER_Ptrs[groupNum]));
+		DisposeFrameTable(groupNum);
 	}
 
 	gShapeTableHandle[groupNum] = LoadPackedFile(fileName);
@@ -221,11 +303,302 @@ void LoadShapeTable(const char* fileName, long groupNum)
 
 //		SDL_Log("Num Anims: %d    Num Frames: %d", numAnims, numFrames);
 	}
+
+	BuildFrameTable(groupNum);
+}
+
+/************************ CLASSIFY SPRITE PIXEL ********************/
+
+static inline int ClassifySpritePixel(uint8_t pixel, uint8_t mask)
+{
+	if (mask == 0x00)
+		return kSpan_Opaque;
+	else if (mask == 0xFF && pixel == 0)
+		return kSpan_Transparent;
+	else
+		return kSpan_Masked;
+}
+
+/************************ ANALYZE FRAME MASK ********************/
+//
+// Breaks up each row of a frame into spans. Returns the number of spans.
+// If outSpans is nil, just counts them.
+//
+
+static int AnalyzeFrameMask(const FrameHeader* fh, const uint8_t* pixels, const uint8_t* mask, FrameSpans* outSpans)
+{
+	int numRows = SDL_max(0, fh->height);
+	int numSpans = 0;
+	SpriteSpan* spans = nil;
+
+	if (outSpans)
+	{
+		outSpans->numRows = numRows;
+		spans = (SpriteSpan*) GetSpanArray(outSpans);
+	}
+
+	for (int row = 0; row < numRows; row++)
+	{
+		if (outSpans)
+			outSpans->rowStart[row] = numSpans;
+
+		int x = 0;
+		while (x < fh->width)
+		{
+			while (x < fh->width && kSpan_Transparent == ClassifySpritePixel(pixels[x], mask[x]))
+				x++;												// skip transparent run
+
+			if (x >= fh->width)
+				break;
+
+			int start = x;
+			int kind = kSpan_Opaque;
+
+			while (x < fh->width)									// extend span
+			{
+				int pixelKind = ClassifySpritePixel(pixels[x], mask[x]);
+
+				if (pixelKind == kSpan_Transparent)					// short gaps are cheaper to blend than to skip
+				{
+					int gapEnd = x;
+					while (gapEnd < fh->width && kSpan_Transparent == ClassifySpritePixel(pixels[gapEnd], mask[gapEnd]))
+						gapEnd++;
+
+					if (gapEnd >= fh->width || gapEnd - x >= kMinSkippedRun)
+						break;
+
+					x = gapEnd;
+					kind = kSpan_Masked;
+				}
+				else
+				{
+					if (pixelKind == kSpan_Masked)
+						kind = kSpan_Masked;
+					x++;
+				}
+			}
+
+			if (spans)
+				spans[numSpans] = (SpriteSpan) { .x = start, .length = x - start, .kind = kind };
+			numSpans++;
+		}
+
+		pixels += fh->width;
+		mask += fh->width;
+	}
+
+	if (outSpans)
+	{
+		outSpans->rowStart[numRows] = numSpans;
+
+		// Spans pay off when they skip enough transparent pixels to make up for their overhead.
+		// Otherwise, the vector kernels can chew through the whole rectangle faster.
+		int spanCost = 0;
+		for (int i = 0; i < numSpans; i++)
+			spanCost += kSpanOverhead + (spans[i].length + 15) / 16;
+
+		int rectCost = numRows * (1 + (fh->width + 15) / 16);
+		outSpans->useSpans = spanCost < rectCost;
+	}
+
+	return numSpans;
+}
+
+/************************ BUILD FRAME TABLE ********************/
+//
+// Flattens every frame of every shape in a group into one table, so that drawing a frame
+// doesn't have to chase offsets through the shape file. Also analyzes each frame's mask.
+// Frame bounds are validated here once, rather than on every draw.
+//
+// The first pass measures how much room we need, the second pass fills it in.
+//
+
+static size_t GetFrameSpansSize(int numRows, int numSpans)
+{
+	size_t size = sizeof(FrameSpans) + (numRows + 1) * sizeof(int32_t) + numSpans * sizeof(SpriteSpan);
+	return (size + 3) & ~(size_t) 3;							// keep next FrameSpans aligned
+}
+
+static void BuildFrameTable(long groupNum)
+{
+	size_t totalSize = 0;
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		int frameIndex = 0;
+		size_t offset = 0;
+
+		for (int shapeNum = 0; shapeNum < gNumShapesInFile[groupNum]; shapeNum++)
+		{
+			const uint8_t* shapePtr = (const uint8_t*) gSHAPE_HEADER_Ptrs[groupNum][shapeNum];
+			const FrameList* fl = (const FrameList*) (shapePtr + *(int32_t*) (shapePtr+2));
+
+			gFirstFrameOfShape[groupNum][shapeNum] = frameIndex;
+			gNumFramesOfShape[groupNum][shapeNum] = fl->numFrames;
+
+			for (int frameNum = 0; frameNum < fl->numFrames; frameNum++)
+			{
+				const uint8_t* pixels;
+				const uint8_t* mask;
+				const FrameHeader* fh = GetFrameHeader(groupNum, shapeNum, frameNum, &pixels, &mask);
+
+				int numRows = SDL_max(0, fh->height);
+				if (fh->width > 0 && numRows > 0)						// make sure the whole frame is in the file
+				{
+					const uint8_t* lastPixel = pixels + fh->width * numRows - 1;
+					const uint8_t* lastMask = mask + fh->width * numRows - 1;
+					GAME_ASSERT(HandleBoundsCheck(gShapeTableHandle[groupNum], (Ptr) lastPixel));
+					GAME_ASSERT(HandleBoundsCheck(gShapeTableHandle[groupNum], (Ptr) lastMask));
+				}
+
+				if (pass == 0)
+				{
+					totalSize += GetFrameSpansSize(numRows, AnalyzeFrameMask(fh, pixels, mask, nil));
+				}
+				else
+				{
+					FrameSpans* fs = (FrameSpans*) (gFrameSpanData[groupNum] + offset);
+					int numSpans = AnalyzeFrameMask(fh, pixels, mask, fs);
+					offset += GetFrameSpansSize(numRows, numSpans);
+
+					gFrameTable[groupNum][frameIndex] = (FrameDesc)
+					{
+						.width		= fh->width,
+						.height		= fh->height,
+						.x			= fh->x,
+						.y			= fh->y,
+						.pixels		= pixels,
+						.mask		= mask,
+						.spans		= fs,
+					};
+				}
+
+				frameIndex++;
+			}
+		}
+
+		if (pass == 0)
+		{
+			gFrameSpanData[groupNum] = NewPtr(totalSize);
+			gFrameTable[groupNum] = (FrameDesc*) NewPtr(sizeof(FrameDesc) * SDL_max(1, frameIndex));
+			GAME_ASSERT(gFrameSpanData[groupNum]);
+			GAME_ASSERT(gFrameTable[groupNum]);
+		}
+		else
+		{
+			GAME_ASSERT(offset == totalSize);
+		}
+	}
+}
+
+/************************ DISPOSE FRAME TABLE ********************/
+
+static void DisposeFrameTable(long groupNum)
+{
+	CHECKED_DISPOSEPTR(gFrameSpanData[groupNum]);
+	CHECKED_DISPOSEPTR(gFrameTable[groupNum]);
+}
+
+/************************ REBUILD FRAME TABLE ********************/
+//
+// Call this after patching a group's pixel data in memory,
+// so that the mask analysis stays in sync with it.
+//
+
+void RebuildFrameTable(long groupNum)
+{
+	GAME_ASSERT(gShapeTableHandle[groupNum]);
+
+	DisposeFrameTable(groupNum);
+	BuildFrameTable(groupNum);
+}
+
+/************************ GET FRAME DESC ********************/
+
+const FrameDesc* GetFrameDesc(long groupNum, long shapeNum, long frameNum)
+{
+	GAME_ASSERT_MESSAGE(groupNum < MAX_SHAPE_GROUPS && gFrameTable[groupNum], "Illegal Group #");
+	GAME_ASSERT_MESSAGE(shapeNum < gNumShapesInFile[groupNum], "Illegal Shape #");
+	GAME_ASSERT_MESSAGE(frameNum < gNumFramesOfShape[groupNum][shapeNum], "Illegal Frame #");
+
+	return &gFrameTable[groupNum][gFirstFrameOfShape[groupNum][shapeNum] + frameNum];
+}
+
+/************************ BLIT FRAME SPANS ********************/
+//
+// Draws rows [firstRow, firstRow+numRows) and columns [colStart, colEnd) of a frame.
+// dst (and tileMask, if any) point to where the top-left corner of that area goes.
+// With a tile mask, pixels under set mask bits keep the background.
+//
+
+static void BlitFrameSpans(
+		const FrameDesc* fd,
+		int firstRow,
+		int numRows,
+		int colStart,
+		int colEnd,
+		uint8_t* dst,
+		const uint8_t* tileMask,
+		int dstRowBytes)
+{
+	const FrameSpans* fs = fd->spans;
+	const SpriteSpan* spans = GetSpanArray(fs);
+	const uint8_t* pixels = fd->pixels;
+	const uint8_t* mask = fd->mask;
+	int srcRowBytes = fd->width;
+
+	GAME_ASSERT(firstRow >= 0 && firstRow + numRows <= fs->numRows);
+
+	pixels += firstRow * srcRowBytes;
+	mask += firstRow * srcRowBytes;
+
+	if (!fs->useSpans)
+	{
+		if (tileMask)
+			gSpriteKernels.blitMaskedPriority(dst, tileMask, dstRowBytes, pixels + colStart, mask + colStart, srcRowBytes, colEnd - colStart, numRows);
+		else
+			gSpriteKernels.blitMasked(dst, dstRowBytes, pixels + colStart, mask + colStart, srcRowBytes, colEnd - colStart, numRows);
+		return;
+	}
+
+	for (int row = firstRow; row < firstRow + numRows; row++)
+	{
+		for (int i = fs->rowStart[row]; i < fs->rowStart[row+1]; i++)
+		{
+			int x0 = SDL_max(spans[i].x, colStart);						// clip span to columns
+			int x1 = SDL_min(spans[i].x + spans[i].length, colEnd);
+
+			if (x0 >= x1)
+			{
+				if (spans[i].x >= colEnd)								// spans are sorted, so we're done with this row
+					break;
+				continue;
+			}
+
+			uint8_t* d = dst + (x0 - colStart);
+
+			if (tileMask)
+				gSpriteKernels.blitMaskedPriority(d, tileMask + (x0 - colStart), 0, pixels + x0, mask + x0, 0, x1 - x0, 1);
+			else if (spans[i].kind == kSpan_Opaque)
+				SDL_memcpy(d, pixels + x0, x1 - x0);
+			else
+				gSpriteKernels.blitMasked(d, 0, pixels + x0, mask + x0, 0, x1 - x0, 1);
+		}
+
+		dst += dstRowBytes;
+		if (tileMask)
+			tileMask += dstRowBytes;
+		pixels += srcRowBytes;
+		mask += srcRowBytes;
+	}
 }
 
 /************************ GET FRAME HEADER ********************/
+//
+// Finds a frame in the shape file. Only used at load time; see GetFrameDesc.
+//
 
-const FrameHeader* GetFrameHeader(
+static const FrameHeader* GetFrameHeader(
 		long groupNum,
 		long shapeNum,
 		long frameNum,
@@ -287,21 +660,12 @@ static void DrawFrameToBuffer(
 		int destBufferHeight
 		)
 {
-					/* CALC ADDRESS OF FRAME TO DRAW */
-
-	const uint8_t*	pixelData	= nil;
-	const uint8_t*	maskData	= nil;
+					/* GET FRAME TO DRAW */
 
-	const FrameHeader* fh = GetFrameHeader(
-			groupNum,
-			shapeNum,
-			frameNum,
-			&pixelData,
-			mask? &maskData: nil
-	);
+	const FrameDesc* fd = GetFrameDesc(groupNum, shapeNum, frameNum);
 
-	x += fh->x;										// use position offsets
-	y += fh->y;
+	x += fd->x;										// use position offsets
+	y += fd->y;
 
 	x += gScreenXOffset;							// global centering offset
 	y += gScreenYOffset;
@@ -310,39 +674,28 @@ static void DrawFrameToBuffer(
 		y < 0 || y >= destBufferHeight)
 		return;
 
+	if (destBuffer == gIndexedFramebuffer)			// the PF window may still be in the PF buffer
+		ResolvePlayfieldViewRect(x, y, x + fd->width, y + fd->height);
+
 	uint8_t* destPtr = destBuffer + y*destBufferWidth + x;
 
 						/* DO THE DRAW */
 
 	if (!mask)
 	{
-		for (int row = fh->height; row; row--)
+		const uint8_t* pixelData = fd->pixels;
+
+		for (int row = fd->height; row > 0; row--)
 		{
-			SDL_memcpy(destPtr, pixelData, fh->width);
+			SDL_memcpy(destPtr, pixelData, fd->width);
 
 			destPtr += destBufferWidth;				// next row
-			pixelData += fh->width;
+			pixelData += fd->width;
 		}
 	}
 	else
 	{
-		const uint8_t* srcPtr	= pixelData;
-		const uint8_t* maskPtr	= maskData;
-
-		for (int row = fh->height; row; row--)
-		{
-			uint8_t* destPtr2 = destPtr;			// get line start ptr
-
-			for (int col = fh->width; col; col--)
-			{
-				*destPtr2 = (*destPtr2 & *maskPtr) | (*srcPtr);
-				destPtr2++;
-				maskPtr++;
-				srcPtr++;
-			}
-
-			destPtr += destBufferWidth;			// next row
-		}
+		BlitFrameSpans(fd, 0, fd->spans->numRows, 0, fd->width, destPtr, nil, destBufferWidth);
 	}
 }
 
@@ -436,6 +789,8 @@ long	i,i2;
 
 			// Clear pointers to shapes so the game will segfault if inadvertantly reusing zombie shapes
 			SDL_memset(gSHAPE_HEADER_Ptrs[i], 0, sizeof(gSHAPE_HEADER_Ptrs[i]));
+
+			DisposeFrameTable(i);
 		}
 	}
 }
@@ -447,23 +802,10 @@ long	i,i2;
 
 bool CheckFootPriority(long x, long y, long width)
 {
-long	col,row;
-long	x2;
-
-
 	if (y < 0 || y >= gPlayfieldHeight || x < 0 || x >= gPlayfieldWidth)		// check for bounds error
 		return(false);
 
-	row = y >> TILE_SIZE_SH;
-	col = x >> TILE_SIZE_SH;
-	x2 = (x+width) >> TILE_SIZE_SH;
-
-	for (; col <= x2; col ++)
-	{
-		if (gPlayfield[row][col] & TILE_PRIORITY_MASK)
-			return(true);
-	}
-	return(false);
+	return CheckPriorityTiles(y >> TILE_SIZE_SH, x >> TILE_SIZE_SH, (x+width) >> TILE_SIZE_SH);
 }
 
 
@@ -480,10 +822,7 @@ int32_t	frameNum;
 int32_t	x,y,offset;
 Rect	oldBox;
 int32_t	shapeNum,groupNum;
-uint8_t*		destPtr;
 uint8_t*		destStartPtr;
-const uint8_t*	maskPtr;
-const uint8_t*	srcPtr;
 
 	if (theNodePtr->PFCoordsFlag)					// see if do special PF Draw code
 	{
@@ -497,21 +836,15 @@ const uint8_t*	srcPtr;
 	x = (theNodePtr->X.Int);						// get short x coord
 	y = (theNodePtr->Y.Int);						// get short y coord
 
-					/* CALC ADDRESS OF FRAME TO DRAW */
+					/* GET FRAME TO DRAW */
 
-	const FrameHeader* fh = GetFrameHeader(
-			groupNum,
-			shapeNum,
-			frameNum,
-			&srcPtr,
-			&maskPtr
-	);
+	const FrameDesc* fd = GetFrameDesc(groupNum, shapeNum, frameNum);
 
-	width = fh->width;								// get width
-	height = fh->height;							// get height
+	width = fd->width;								// get width
+	height = fd->height;							// get height
 
-	x += fh->x;										// use position offsets
-	y += fh->y;
+	x += fd->x;										// use position offsets
+	y += fd->y;
 
 	x += gScreenXOffset;							// global centering offset
 	y += gScreenYOffset;
@@ -532,9 +865,9 @@ const uint8_t*	srcPtr;
 		offset = gRegionClipTop[theNodePtr->ClipNum]-y;
 		y = gRegionClipTop[theNodePtr->ClipNum];
 		height -= offset;
-		srcPtr += offset*width;
-		maskPtr += offset*width;
 	}
+	else
+		offset = 0;
 
 	if (theNodePtr->UpdateBoxFlag)						// see if using update regions
 	{
@@ -547,23 +880,11 @@ const uint8_t*	srcPtr;
 	destStartPtr = gOffScreenLookUpTable[y] + x;		// calc draw addr
 
 						/* DO THE DRAW */
-	if (height <= 0)										// special check for illegal heights
-		height = 1;
 
-	do
+	if (height > 0)											// special check for illegal heights
 	{
-		destPtr = destStartPtr;								// get line start ptr
-
-		for (int i = width; i; i--)
-		{
-			*destPtr = (*destPtr & *maskPtr) | (*srcPtr);
-			destPtr++;
-			srcPtr++;
-			maskPtr++;
-		}
-
-		destStartPtr += OFFSCREEN_WIDTH;					// next row
-	} while(--height);
+		BlitFrameSpans(fd, offset, height, 0, width, destStartPtr, nil, OFFSCREEN_WIDTH);
+	}
 
 
 					/* MAKE AN UPDATE REGION */
@@ -626,6 +947,272 @@ void EraseASprite(ObjNode *theNodePtr)
 	}
 }
 
+/************************ BLIT PLAYFIELD PRIORITY RECT ********************/
+//
+// Draws part of a frame behind priority tiles, one tile row at a time.
+// Only tiles whose mask is partly set need the tile mask blit; sprites draw straight
+// over tiles with a clear mask, and not at all over tiles with a solid mask.
+// The rectangle must not wrap around the PF buffer.
+//
+
+
+static void BlitPFPriorityRect(
+		const FrameDesc* fd,
+		int firstRow,
+		int numRows,
+		int colStart,
+		int colEnd,
+		int x,
+		int y)
+{
+	while (numRows > 0)
+	{
+		int bandRows = SDL_min(numRows, TILE_SIZE - (y & (TILE_SIZE-1)));		// rows until next tile row
+		const uint8_t* maskStates = gPFTileMaskStates + (y >> TILE_SIZE_SH) * PF_TILE_WIDTH;
+
+		int col = colStart;
+		int bufferX = x;
+
+		while (col < colEnd)
+		{
+					/* FIND RUN OF TILES WITH THE SAME KIND OF MASK */
+
+			int state = maskStates[bufferX >> TILE_SIZE_SH];
+			int runEnd = col;
+			int runX = bufferX;
+
+			do
+			{
+				int nextTileX = (runX | (TILE_SIZE-1)) + 1;
+				runEnd += nextTileX - runX;
+				runX = nextTileX;
+			} while (runEnd < colEnd && maskStates[runX >> TILE_SIZE_SH] == state);
+
+			runEnd = SDL_min(runEnd, colEnd);
+
+					/* DRAW RUN */
+
+			if (state != kTileMask_Solid)										// solid tile mask: sprite is hidden
+			{
+				BlitFrameSpans(
+						fd, firstRow, bandRows, col, runEnd,
+						gPFLookUpTable[y] + bufferX,
+						state == kTileMask_Pixels ? gPFMaskLookUpTable[y] + bufferX : nil,
+						PF_BUFFER_WIDTH);
+			}
+
+			bufferX += runEnd - col;
+			col = runEnd;
+		}
+
+		firstRow += bandRows;
+		numRows -= bandRows;
+		y += bandRows;
+	}
+}
+
+/************************ DRAW PLAYFIELD RECT ********************/
+//
+// Draws part of a frame into the Playfield circular buffer. The rectangle must not wrap around the buffer.
+//
+
+static void DrawPFRect(
+		const FrameDesc* fd,
+		int firstRow,
+		int numRows,
+		int colStart,
+		int colEnd,
+		int x,
+		int y,
+		bool priorityFlag)
+{
+	if (priorityFlag)
+		BlitPFPriorityRect(fd, firstRow, numRows, colStart, colEnd, x, y);
+	else
+		BlitFrameSpans(fd, firstRow, numRows, colStart, colEnd, gPFLookUpTable[y] + x, nil, PF_BUFFER_WIDTH);
+}
+
+/************************ DRAW SPRITE BAND ********************/
+//
+// Job: draws the part of every queued blit that falls within one band of PF buffer rows.
+//
+
+static void DrawSpriteBandJob(void* userData, int workerNum, int jobIndex)
+{
+	(void) userData;
+	(void) workerNum;
+
+	int band = gBandJobs[jobIndex];
+	int bandTop = band * kRowsPerSpriteBand;
+	int bandBottom = bandTop + kRowsPerSpriteBand;
+
+	for (int i = gBandFirstEntry[band]; i < gBandFirstEntry[band + 1]; i++)
+	{
+		const PFBlit* blit = &gPFBlitQueue[gBandEntries[i]];
+
+		int top = SDL_max(blit->y, bandTop);								// clip to band
+		int bottom = SDL_min(blit->y + blit->numRows, bandBottom);
+
+		DrawPFRect(blit->fd, blit->firstRow + (top - blit->y), bottom - top,
+				blit->colStart, blit->colEnd, blit->x, top, blit->priorityFlag);
+	}
+}
+
+/************************ FLUSH PLAYFIELD BLITS ********************/
+//
+// Draws every blit in the queue and empties it.
+//
+
+static void FlushPFBlits(void)
+{
+	int numBlits = gNumQueuedPFBlits;
+
+	gNumQueuedPFBlits = 0;
+	gNumQueuedBandEntries = 0;
+
+	if (numBlits < kMinPFBlitsForParallel)						// not worth it, draw them here
+	{
+		for (int i = 0; i < numBlits; i++)
+		{
+			const PFBlit* blit = &gPFBlitQueue[i];
+			DrawPFRect(blit->fd, blit->firstRow, blit->numRows, blit->colStart, blit->colEnd, blit->x, blit->y, blit->priorityFlag);
+		}
+		return;
+	}
+
+					/* SORT BLITS INTO BANDS */
+
+	int numBands = (PF_BUFFER_HEIGHT + kRowsPerSpriteBand - 1) / kRowsPerSpriteBand;
+	GAME_ASSERT(numBands <= kMaxSpriteBands);
+
+	SDL_memset(gBandFirstEntry, 0, sizeof(gBandFirstEntry[0]) * (numBands + 1));
+
+	for (int i = 0; i < numBlits; i++)							// count entries per band
+	{
+		const PFBlit* blit = &gPFBlitQueue[i];
+		int lastBand = (blit->y + blit->numRows - 1) / kRowsPerSpriteBand;
+		for (int band = blit->y / kRowsPerSpriteBand; band <= lastBand; band++)
+			gBandFirstEntry[band + 1]++;
+	}
+
+	int numJobs = 0;
+	for (int band = 0; band < numBands; band++)
+	{
+		if (gBandFirstEntry[band + 1] != 0)
+			gBandJobs[numJobs++] = band;
+		gBandFirstEntry[band + 1] += gBandFirstEntry[band];
+	}
+
+	int cursor[kMaxSpriteBands];
+	SDL_memcpy(cursor, gBandFirstEntry, sizeof(cursor[0]) * numBands);
+
+	for (int i = 0; i < numBlits; i++)							// fill bands in queue order to keep the Z order
+	{
+		const PFBlit* blit = &gPFBlitQueue[i];
+		int lastBand = (blit->y + blit->numRows - 1) / kRowsPerSpriteBand;
+		for (int band = blit->y / kRowsPerSpriteBand; band <= lastBand; band++)
+			gBandEntries[cursor[band]++] = (int16_t) i;
+	}
+
+	RunParallelJobs(DrawSpriteBandJob, NULL, numJobs);
+}
+
+/************************ QUEUE PLAYFIELD BLIT ********************/
+
+static void QueuePFBlit(
+		const FrameDesc* fd,
+		int firstRow,
+		int numRows,
+		int colStart,
+		int colEnd,
+		int x,
+		int y,
+		bool priorityFlag)
+{
+	int numBandEntries = (y + numRows - 1) / kRowsPerSpriteBand - y / kRowsPerSpriteBand + 1;
+
+	if (gNumQueuedPFBlits == kMaxQueuedPFBlits ||				// out of room: draw what we have so far
+		gNumQueuedBandEntries + numBandEntries > kMaxSpriteBandEntries)
+	{
+		FlushPFBlits();
+	}
+
+	gPFBlitQueue[gNumQueuedPFBlits++] = (PFBlit)
+	{
+		.fd				= fd,
+		.firstRow		= firstRow,
+		.numRows		= numRows,
+		.colStart		= colStart,
+		.colEnd			= colEnd,
+		.x				= x,
+		.y				= y,
+		.priorityFlag	= priorityFlag,
+	};
+
+	gNumQueuedBandEntries += numBandEntries;
+}
+
+/************************ BEGIN/END SPRITE BATCH ********************/
+//
+// Between these calls, DrawASprite queues up PF sprites instead of drawing them right away.
+// EndSpriteBatch draws them all, split across the job workers.
+// Sprites in screen coordinates are still drawn immediately (they don't go into the PF buffer).
+//
+
+void BeginSpriteBatch(void)
+{
+	GAME_ASSERT(!gSpriteBatchActive);
+
+	if (gParallelSprites < 0)
+	{
+		gParallelSprites = SDL_GetHintBoolean(kParallelSpritesHint, true);
+		SDL_Log("Parallel sprites: %s", gParallelSprites ? "on" : "off");
+	}
+
+	gSpriteBatchActive = gParallelSprites && GetNumJobWorkers() > 1;
+}
+
+void EndSpriteBatch(void)
+{
+	if (!gSpriteBatchActive)
+		return;
+
+	FlushPFBlits();
+	gSpriteBatchActive = false;
+}
+
+/************************ BLIT PLAYFIELD SEGMENT ********************/
+//
+// Draws columns [colStart, colEnd) of a frame into the Playfield circular buffer at x,y.
+// The segment may wrap vertically, in which case it's drawn in 2 parts.
+//
+
+static void BlitPFSegment(
+		const FrameDesc* fd,
+		int firstRow,
+		int numRows,
+		int colStart,
+		int colEnd,
+		int x,
+		int y,
+		bool priorityFlag)
+{
+	int partRows = SDL_min(numRows, PF_BUFFER_HEIGHT - y);		// rows before buffer wraps
+
+	for (int part = 0; part < 2 && numRows > 0; part++)
+	{
+		if (gSpriteBatchActive)
+			QueuePFBlit(fd, firstRow, partRows, colStart, colEnd, x, y, priorityFlag);
+		else
+			DrawPFRect(fd, firstRow, partRows, colStart, colEnd, x, y, priorityFlag);
+
+		firstRow += partRows;
+		numRows -= partRows;
+		partRows = numRows;											// the rest goes at the top of the buffer
+		y = 0;
+	}
+}
+
 /************************ DRAW PLAYFIELD SPRITE ********************/
 //
 // Draws shape obj into Playfield circular buffer
@@ -634,14 +1221,8 @@ void EraseASprite(ObjNode *theNodePtr)
 static void DrawPFSprite(ObjNode *theNodePtr)
 {
 long	width,height;
-uint8_t*			destStartPtr;
-const uint8_t*		tileMaskStartPtr;
-const uint8_t*		srcStartPtr;
-const uint8_t*		originalSrcStartPtr;
-const uint8_t*		maskStartPtr;
-const uint8_t*		originalMaskStartPtr;
 long	frameNum;
-long	realWidth,originalY,topToClip,leftToClip;
+long	topToClip,leftToClip;
 long	drawWidth,shapeNum,groupNum,numHSegs;
 Boolean	priorityFlag;
 int32_t	x, y;
@@ -654,20 +1235,14 @@ int32_t	x, y;
 
 	TweenObjectPosition(theNodePtr, &x, &y);
 
-					/* CALC ADDRESS OF FRAME TO DRAW */
+					/* GET FRAME TO DRAW */
 
-	const FrameHeader* fh = GetFrameHeader(
-			groupNum,
-			shapeNum,
-			frameNum,
-			(const uint8_t**) &srcStartPtr,
-			(const uint8_t**) &maskStartPtr
-	);
+	const FrameDesc* fd = GetFrameDesc(groupNum, shapeNum, frameNum);
 
-	drawWidth = realWidth = width = fh->width;		// get pixel width
-	height = fh->height;							// get height
-	x += fh->x;										// use position offsets (still global coords)
-	y += fh->y;
+	drawWidth = width = fd->width;					// get pixel width
+	height = fd->height;							// get height
+	x += fd->x;										// use position offsets (still global coords)
+	y += fd->y;
 
 				/************************/
 				/*  CHECK IF VISIBLE    */
@@ -726,7 +1301,7 @@ int32_t	x, y;
 	else
 		priorityFlag = false;
 
-	theNodePtr->drawBox.top = y = originalY =  (y % PF_BUFFER_HEIGHT);	// get PF buffer pixel coords to start @
+	theNodePtr->drawBox.top = y = (y % PF_BUFFER_HEIGHT);	// get PF buffer pixel coords to start @
 	theNodePtr->drawBox.left = x = (x % PF_BUFFER_WIDTH);
 	theNodePtr->drawBox.right = width;							// right actually = width
 	theNodePtr->drawBox.bottom = height;
@@ -739,109 +1314,13 @@ int32_t	x, y;
 	else
 		numHSegs = 1;
 
-	leftToClip += (topToClip*realWidth);
-	srcStartPtr += leftToClip;
-	maskStartPtr += leftToClip;
-	originalSrcStartPtr = srcStartPtr;	 						// get ptr to PIXEL_DATA
-	originalMaskStartPtr = maskStartPtr; 						// get ptr to MASK_DATA
-
-	destStartPtr = gPFLookUpTable[y] + x;						// calc draw addr
-
 						/* DO THE DRAW */
 
+	BlitPFSegment(fd, topToClip, height, leftToClip, leftToClip+width, x, y, priorityFlag);
 
-	if (!priorityFlag)
-	{
-		for (; numHSegs > 0; numHSegs--)
-		{
-			for (int drawHeight = 0; drawHeight < height; drawHeight++)
-			{
-				uint8_t*		destPtr		= destStartPtr;		// get line start ptr
-				const uint8_t*	srcPtr		= srcStartPtr;
-				const uint8_t*	maskPtr		= maskStartPtr;
-				for (int i = width; i; i--)
-				{
-					*destPtr = (*destPtr & *maskPtr) | *srcPtr;
-					destPtr++;
-					maskPtr++;
-					srcPtr++;
-				}
-
-				srcStartPtr += realWidth;						// next sprite line
-				maskStartPtr += realWidth;						// next mask line
-
-				if (++y >=  PF_BUFFER_HEIGHT)					// see if wrap buffer vertically
-				{
-					destStartPtr = gPFLookUpTable[0] + x;		// wrap to top
-					y = 0;
-				}
-				else
-					destStartPtr += PF_BUFFER_WIDTH;			// next buffer line
-			}
-
-			if (numHSegs == 2)
-			{
-				destStartPtr = gPFLookUpTable[y = originalY];	// set buff addr for segment #2
-				x = 0;
-				srcStartPtr = originalSrcStartPtr+width;
-				maskStartPtr = originalMaskStartPtr+width;
-				width = drawWidth-width;
-			}
-		}
-	}
-	else
+	if (numHSegs == 2)											// segment #2 wraps to left edge of buffer
 	{
-					/**************************/
-					/* DRAW IT WITH TILE MASK */
-					/**************************/
-
-		tileMaskStartPtr = gPFMaskLookUpTable[y] + x;			// calc tilemask addr
-
-		for (; numHSegs > 0; numHSegs--)
-		{
-			for (int drawHeight = 0; drawHeight < height; drawHeight++)
-			{
-				uint8_t* destPtr			= destStartPtr;		// get line start ptr
-				const uint8_t* srcPtr		= srcStartPtr;
-				const uint8_t* maskPtr		= maskStartPtr;
-				const uint8_t* tileMaskPtr	= tileMaskStartPtr;
-
-				for (int i = width; i; i--)						// draw remaining pixels
-				{
-					*destPtr =  (*destPtr & (*maskPtr | *tileMaskPtr)) |
-								 (*srcPtr & (*tileMaskPtr ^ 0xff));
-					destPtr++;
-					maskPtr++;
-					srcPtr++;
-					tileMaskPtr++;
-				}
-
-				srcStartPtr += realWidth;						// next sprite line
-				maskStartPtr += realWidth;						// next mask line
-
-				if (++y >=  PF_BUFFER_HEIGHT)					// see if wrap buffer vertically
-				{
-					destStartPtr = gPFLookUpTable[0] + x;	// wrap to top
-					tileMaskStartPtr = gPFMaskLookUpTable[0] + x;
-					y = 0;
-				}
-				else
-				{
-					destStartPtr += PF_BUFFER_WIDTH;			// next buffer line
-					tileMaskStartPtr += PF_BUFFER_WIDTH;
-				}
-			}
-
-			if (numHSegs == 2)
-			{
-				destStartPtr = gPFLookUpTable[originalY];		// set buff addr for segment #2
-				tileMaskStartPtr = gPFMaskLookUpTable[y = originalY];
-				x = 0;
-				srcStartPtr = originalSrcStartPtr+width;
-				maskStartPtr = originalMaskStartPtr+width;
-				width = drawWidth-width;
-			}
-		}
+		BlitPFSegment(fd, topToClip, height, leftToClip+width, leftToClip+drawWidth, 0, y, priorityFlag);
 	}
 }
 
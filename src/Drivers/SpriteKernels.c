@@ -0,0 +1,357 @@
+// SPRITE KERNELS
+// (C) 2025 Iliyas Jorio
+// This file is part of Mighty Mike. https://github.com/jorio/mightymike
+//
+// Vectorized masked blits for the shape manager.
+//
+// Both blits are idempotent (blitting the same sprite twice over the same spot
+// gives the same result as blitting it once), so the vector kernels finish off
+// rows wider than a vector with one overlapping vector instead of a scalar tail.
+// That last vector is computed before anything else in the row gets stored:
+// reading back bytes from a store that's still in flight stalls the CPU.
+
+#include <stddef.h>
+
+#include "myglobals.h"
+#include "misc.h"
+#include "shape.h"
+#include "simd.h"
+
+SpriteKernels gSpriteKernels;
+
+#pragma mark - Scalar
+
+static void BlitMasked_Scalar(
+		uint8_t* dst, int dstPitch,
+		const uint8_t* src, const uint8_t* mask, int srcPitch,
+		int width, int height)
+{
+	for (; height > 0; height--)
+	{
+		for (int i = 0; i < width; i++)
+			dst[i] = (dst[i] & mask[i]) | src[i];
+
+		dst += dstPitch;
+		src += srcPitch;
+		mask += srcPitch;
+	}
+}
+
+static void BlitMaskedPriority_Scalar(
+		uint8_t* dst, const uint8_t* tileMask, int dstPitch,
+		const uint8_t* src, const uint8_t* mask, int srcPitch,
+		int width, int height)
+{
+	for (; height > 0; height--)
+	{
+		for (int i = 0; i < width; i++)
+			dst[i] = (dst[i] & (mask[i] | tileMask[i])) | (src[i] & ~tileMask[i]);
+
+		dst += dstPitch;
+		tileMask += dstPitch;
+		src += srcPitch;
+		mask += srcPitch;
+	}
+}
+
+static const SpriteKernels kKernels_Scalar =
+{
+	.name				= "scalar",
+	.blitMasked			= BlitMasked_Scalar,
+	.blitMaskedPriority	= BlitMaskedPriority_Scalar,
+};
+
+#pragma mark - SSE2
+
+#if KERNELS_X86
+
+// Sprites are rarely wider than a few dozen pixels, and this is bound by
+// loads and stores anyway, so there's little to gain from AVX2 here.
+
+TARGET_SSE2 static inline __m128i Masked16_SSE2(const uint8_t* dst, const uint8_t* src, const uint8_t* mask)
+{
+	__m128i d = _mm_loadu_si128((const __m128i*) dst);
+	__m128i s = _mm_loadu_si128((const __m128i*) src);
+	__m128i m = _mm_loadu_si128((const __m128i*) mask);
+	return _mm_or_si128(_mm_and_si128(d, m), s);
+}
+
+TARGET_SSE2 static inline __m128i MaskedPriority16_SSE2(const uint8_t* dst, const uint8_t* tileMask, const uint8_t* src, const uint8_t* mask)
+{
+	__m128i d = _mm_loadu_si128((const __m128i*) dst);
+	__m128i t = _mm_loadu_si128((const __m128i*) tileMask);
+	__m128i s = _mm_loadu_si128((const __m128i*) src);
+	__m128i m = _mm_loadu_si128((const __m128i*) mask);
+	__m128i keep = _mm_and_si128(d, _mm_or_si128(m, t));
+	return _mm_or_si128(keep, _mm_andnot_si128(t, s));
+}
+
+TARGET_SSE2 static void BlitMasked_SSE2(
+		uint8_t* dst, int dstPitch,
+		const uint8_t* src, const uint8_t* mask, int srcPitch,
+		int width, int height)
+{
+	if (width < 16)
+	{
+		BlitMasked_Scalar(dst, dstPitch, src, mask, srcPitch, width, height);
+		return;
+	}
+
+	for (; height > 0; height--)
+	{
+		int last = width - 16;
+		__m128i tail = Masked16_SSE2(dst + last, src + last, mask + last);
+
+		int i = 0;
+
+		for (; i + 32 <= width; i += 32)
+		{
+			__m128i a = Masked16_SSE2(dst + i, src + i, mask + i);
+			__m128i b = Masked16_SSE2(dst + i + 16, src + i + 16, mask + i + 16);
+			_mm_storeu_si128((__m128i*) (dst + i), a);
+			_mm_storeu_si128((__m128i*) (dst + i + 16), b);
+		}
+
+		if (i + 16 <= width)
+		{
+			_mm_storeu_si128((__m128i*) (dst + i), Masked16_SSE2(dst + i, src + i, mask + i));
+		}
+
+		_mm_storeu_si128((__m128i*) (dst + last), tail);
+
+		dst += dstPitch;
+		src += srcPitch;
+		mask += srcPitch;
+	}
+}
+
+TARGET_SSE2 static void BlitMaskedPriority_SSE2(
+		uint8_t* dst, const uint8_t* tileMask, int dstPitch,
+		const uint8_t* src, const uint8_t* mask, int srcPitch,
+		int width, int height)
+{
+	if (width < 16)
+	{
+		BlitMaskedPriority_Scalar(dst, tileMask, dstPitch, src, mask, srcPitch, width, height);
+		return;
+	}
+
+	for (; height > 0; height--)
+	{
+		int last = width - 16;
+		__m128i tail = MaskedPriority16_SSE2(dst + last, tileMask + last, src + last, mask + last);
+
+		int i = 0;
+
+		for (; i + 32 <= width; i += 32)
+		{
+			__m128i a = MaskedPriority16_SSE2(dst + i, tileMask + i, src + i, mask + i);
+			__m128i b = MaskedPriority16_SSE2(dst + i + 16, tileMask + i + 16, src + i + 16, mask + i + 16);
+			_mm_storeu_si128((__m128i*) (dst + i), a);
+			_mm_storeu_si128((__m128i*) (dst + i + 16), b);
+		}
+
+		if (i + 16 <= width)
+		{
+			_mm_storeu_si128((__m128i*) (dst + i), MaskedPriority16_SSE2(dst + i, tileMask + i, src + i, mask + i));
+		}
+
+		_mm_storeu_si128((__m128i*) (dst + last), tail);
+
+		dst += dstPitch;
+		tileMask += dstPitch;
+		src += srcPitch;
+		mask += srcPitch;
+	}
+}
+
+static const SpriteKernels kKernels_SSE2 =
+{
+	.name				= "sse2",
+	.blitMasked			= BlitMasked_SSE2,
+	.blitMaskedPriority	= BlitMaskedPriority_SSE2,
+};
+
+#endif // KERNELS_X86
+
+#pragma mark - NEON
+
+#if KERNELS_NEON
+
+static inline uint8x16_t Masked16_NEON(const uint8_t* dst, const uint8_t* src, const uint8_t* mask)
+{
+	return vorrq_u8(vandq_u8(vld1q_u8(dst), vld1q_u8(mask)), vld1q_u8(src));
+}
+
+static inline uint8x16_t MaskedPriority16_NEON(const uint8_t* dst, const uint8_t* tileMask, const uint8_t* src, const uint8_t* mask)
+{
+	uint8x16_t t = vld1q_u8(tileMask);
+	uint8x16_t keep = vandq_u8(vld1q_u8(dst), vorrq_u8(vld1q_u8(mask), t));
+	return vorrq_u8(keep, vbicq_u8(vld1q_u8(src), t));
+}
+
+static void BlitMasked_NEON(
+		uint8_t* dst, int dstPitch,
+		const uint8_t* src, const uint8_t* mask, int srcPitch,
+		int width, int height)
+{
+	if (width < 16)
+	{
+		BlitMasked_Scalar(dst, dstPitch, src, mask, srcPitch, width, height);
+		return;
+	}
+
+	for (; height > 0; height--)
+	{
+		int last = width - 16;
+		uint8x16_t tail = Masked16_NEON(dst + last, src + last, mask + last);
+
+		int i = 0;
+
+		for (; i + 32 <= width; i += 32)
+		{
+			uint8x16_t a = Masked16_NEON(dst + i, src + i, mask + i);
+			uint8x16_t b = Masked16_NEON(dst + i + 16, src + i + 16, mask + i + 16);
+			vst1q_u8(dst + i, a);
+			vst1q_u8(dst + i + 16, b);
+		}
+
+		if (i + 16 <= width)
+		{
+			vst1q_u8(dst + i, Masked16_NEON(dst + i, src + i, mask + i));
+		}
+
+		vst1q_u8(dst + last, tail);
+
+		dst += dstPitch;
+		src += srcPitch;
+		mask += srcPitch;
+	}
+}
+
+static void BlitMaskedPriority_NEON(
+		uint8_t* dst, const uint8_t* tileMask, int dstPitch,
+		const uint8_t* src, const uint8_t* mask, int srcPitch,
+		int width, int height)
+{
+	if (width < 16)
+	{
+		BlitMaskedPriority_Scalar(dst, tileMask, dstPitch, src, mask, srcPitch, width, height);
+		return;
+	}
+
+	for (; height > 0; height--)
+	{
+		int last = width - 16;
+		uint8x16_t tail = MaskedPriority16_NEON(dst + last, tileMask + last, src + last, mask + last);
+
+		int i = 0;
+
+		for (; i + 32 <= width; i += 32)
+		{
+			uint8x16_t a = MaskedPriority16_NEON(dst + i, tileMask + i, src + i, mask + i);
+			uint8x16_t b = MaskedPriority16_NEON(dst + i + 16, tileMask + i + 16, src + i + 16, mask + i + 16);
+			vst1q_u8(dst + i, a);
+			vst1q_u8(dst + i + 16, b);
+		}
+
+		if (i + 16 <= width)
+		{
+			vst1q_u8(dst + i, MaskedPriority16_NEON(dst + i, tileMask + i, src + i, mask + i));
+		}
+
+		vst1q_u8(dst + last, tail);
+
+		dst += dstPitch;
+		tileMask += dstPitch;
+		src += srcPitch;
+		mask += srcPitch;
+	}
+}
+
+static const SpriteKernels kKernels_NEON =
+{
+	.name				= "neon",
+	.blitMasked			= BlitMasked_NEON,
+	.blitMaskedPriority	= BlitMaskedPriority_NEON,
+};
+
+#endif // KERNELS_NEON
+
+#pragma mark - Self-test
+
+#if _DEBUG
+
+// Runs a kernel set against the scalar reference on random sprites of every width
+// up to a few vectors, at misaligned offsets. Checks that nothing outside the
+// sprite's rectangle gets touched.
+static void SelfTestKernels(const SpriteKernels* kernels)
+{
+	enum { kPitch = 96, kRows = 5, kSize = kPitch * kRows };
+
+	static uint8_t src[kSize];
+	static uint8_t mask[kSize];
+	static uint8_t tileMask[kSize];
+	static uint8_t background[kSize];
+	static uint8_t ref[kSize];
+	static uint8_t out[kSize];
+
+	uint32_t seed = 0x53707269;
+
+	for (int i = 0; i < kSize; i++)
+	{
+		// Real masks are 0x00 or 0xFF, but the kernels must not care
+		uint32_t r = SelfTestRandom(&seed);
+		mask[i]			= (r & 3) == 0 ? (uint8_t) (r >> 8) : ((r & 4) ? 0xFF : 0x00);
+		src[i]			= mask[i] == 0xFF ? 0 : (uint8_t) (r >> 16);
+		tileMask[i]		= (r & 0x30) == 0 ? 0xFF : 0x00;
+		background[i]	= (uint8_t) SelfTestRandom(&seed);
+	}
+
+	for (int width = 0; width <= kPitch - 16; width++)
+	{
+		int offset = width % 16;
+		int height = kRows - 1;
+
+		SDL_memcpy(ref, background, kSize);
+		SDL_memcpy(out, background, kSize);
+		BlitMasked_Scalar(ref + offset, kPitch, src, mask, width, width, height);
+		kernels->blitMasked(out + offset, kPitch, src, mask, width, width, height);
+		GAME_ASSERT_MESSAGE(0 == SDL_memcmp(ref, out, kSize), kernels->name);
+
+		SDL_memcpy(ref, background, kSize);
+		SDL_memcpy(out, background, kSize);
+		BlitMaskedPriority_Scalar(ref + offset, tileMask + offset, kPitch, src, mask, width, width, height);
+		kernels->blitMaskedPriority(out + offset, tileMask + offset, kPitch, src, mask, width, width, height);
+		GAME_ASSERT_MESSAGE(0 == SDL_memcmp(ref, out, kSize), kernels->name);
+	}
+}
+
+#endif // _DEBUG
+
+#pragma mark - Init
+
+void InitSpriteKernels(void)
+{
+	gSpriteKernels = kKernels_Scalar;
+
+#if KERNELS_X86
+	if (SDL_HasSSE2())
+	{
+#if _DEBUG
+		SelfTestKernels(&kKernels_SSE2);
+#endif
+		gSpriteKernels = kKernels_SSE2;
+	}
+#elif KERNELS_NEON
+	if (SDL_HasNEON())
+	{
+#if _DEBUG
+		SelfTestKernels(&kKernels_NEON);
+#endif
+		gSpriteKernels = kKernels_NEON;
+	}
+#endif
+
+	SDL_Log("Sprite kernels: %s", gSpriteKernels.name);
+}
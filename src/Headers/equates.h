@@ -131,3 +131,25 @@ enum
 	kScaling_Stretch		= 1,
 	kScaling_HQStretch		= 2,
 };
+
+enum
+{
+	kPrescale_Nearest		= 0,	// plain pixel replication
+	kPrescale_EPX			= 1,	// Scale2x/Scale3x edge smoothing
+};
+
+enum
+{
+	kColorDepth_Auto		= 0,	// let the render driver pick whichever uploads faster
+	kColorDepth_16			= 1,	// RGB 5-6-5
+	kColorDepth_32			= 2,	// RGBA 8-8-8-8
+};
+
+enum
+{
+	kFrameCap_Refresh		= 0,	// smooth frame rate: one frame per display refresh
+	kFrameCap_None			= 1,	// smooth frame rate: as many frames as we can
+	kFrameCap_30			= 2,
+	kFrameCap_60			= 3,
+	kFrameCap_120			= 4,
+};
@@ -217,17 +217,19 @@ extern	int						VISIBLE_WIDTH;
 extern	int						VISIBLE_HEIGHT;
 extern	uint8_t					*gIndexedFramebuffer;
 extern	int						gEffectiveScalingType;
+extern	int						gPrescale;					// CPU integer prescale factor for HQ stretch (1 otherwise)
 extern	uint8_t					**gScreenLookUpTable;		// VISIBLE_HEIGHT elements
 extern	uint8_t					**gOffScreenLookUpTable;	// OFFSCREEN_HEIGHT elements
 extern	uint8_t					**gBackgroundLookUpTable;	// OFFSCREEN_HEIGHT elements
 extern	uint8_t					**gPFLookUpTable;
 extern	uint8_t					**gPFCopyLookUpTable;
 extern	uint8_t					**gPFMaskLookUpTable;
+extern	uint8_t					*gPFTileMaskStates;			// PF_TILE_HEIGHT*PF_TILE_WIDTH elements
 extern	long					gScreenXOffset;				// global centering offset applied to sprites
 extern	long					gScreenYOffset;				// global centering offset applied to sprites
 extern	Handle					gBackgroundHandle;
 extern	Handle					gOffScreenHandle;
 extern	Handle					gPFBufferHandle;
-extern	uint8_t					*gRowDitherStrides;			// for dithering filter
+extern	struct DitherSpan		*gRowDitherStrides;			// for dithering filter (VISIBLE_WIDTH spans per thread)
 extern	const char				*gRendererName;
-extern	Boolean					gCanDoHQStretch;
+extern	int						gMaxPrescale;				// set by the render driver; HQ stretch needs at least 2
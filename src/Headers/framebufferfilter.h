@@ -2,28 +2,92 @@
 
 #include <stdint.h>
 
-#define MAX_RENDER_THREADS	32
-
-#if GLRENDER
-	#define FRAMEBUFFER_COLOR_DEPTH 16
-#else
-	#define FRAMEBUFFER_COLOR_DEPTH 32
-#endif
-
-#if FRAMEBUFFER_COLOR_DEPTH == 32
-	typedef uint32_t color_t;
-	#define finalColorsXX finalColors32
-#elif FRAMEBUFFER_COLOR_DEPTH == 16
-	typedef uint16_t color_t;
-	#define finalColorsXX finalColors16
-#else
-	_Static_assert(false, "unsupported framebuffer color depth!");
-#endif
-
-void IndexedFramebufferToColor_NoFilter(color_t* color, int firstRow, int numRows);
-void IndexedFramebufferToColor_FilterDithering(color_t* color, int threadNum, int firstRow, int numRows);
-void DoublePixels(const color_t* colorx1, color_t* colorx2, int firstRow, int numRows);
-
-void ConvertFramebufferMT(color_t* colorBuffer);
+// Bytes per pixel of the converted framebuffer: 2 (RGB 5-6-5, finalColors16) or 4 (RGBA 8-8-8-8, finalColors32).
+// Both converter variants are compiled in; the render driver picks one at runtime (see GetPreferredBytesPerPixel).
+extern int gFramebufferBytesPerPixel;
+
+// Largest integer prescale factor for HQ stretch (see PrescalePixels)
+#define MAX_PRESCALE 4
+
+struct GamePalette_s;
+
+typedef struct FramebufferKernels
+{
+	const char*	name;
+
+	// Expand count palette indices to final colors
+	void		(*expand16)(uint16_t* dst, const uint8_t* src, int count, const struct GamePalette_s* palette);
+	void		(*expand32)(uint32_t* dst, const uint8_t* src, int count, const struct GamePalette_s* palette);
+
+	// Find the first x in [from, to) where row[x-1] == row[x+1] && row[x] != row[x+1], or return 'to'.
+	// Reads row[from-1 ... to].
+	int			(*findDither)(const uint8_t* row, int from, int to);
+
+	// Average each pixel with its right-hand neighbor (reads src[0 ... count])
+	void		(*blend16)(uint16_t* dst, const uint8_t* src, int count, const struct GamePalette_s* palette);
+	void		(*blend32)(uint32_t* dst, const uint8_t* src, int count, const struct GamePalette_s* palette);
+
+	// Write each of count pixels 'factor' times in a row (factor: 1 to MAX_PRESCALE)
+	void		(*replicate16)(uint16_t* dst, const uint16_t* src, int count, int factor);
+	void		(*replicate32)(uint32_t* dst, const uint32_t* src, int count, int factor);
+} FramebufferKernels;
+
+typedef struct DitherSpan
+{
+	int16_t		start;		// first smeared pixel
+	int16_t		end;		// last smeared pixel (inclusive)
+} DitherSpan;
+
+extern FramebufferKernels gFramebufferKernels;
+
+void InitFramebufferKernels(void);
+
+void IndexedFramebufferToColor_NoFilter(void* color, int firstRow, int numRows);
+void IndexedFramebufferToColor_FilterDithering(void* color, int threadNum, int firstRow, int numRows);
+void IndexedFramebufferToSmearedIndices(uint8_t* indexAndSmear, int threadNum, int firstRow, int numRows);
+void PrescalePixels(const void* colorx1, void* colorxN, int factor, int filter, int firstRow, int numRows);
+
+#define MAX_DIRTY_BANDS		16
+
+typedef struct FramebufferDamage
+{
+	int			numDirtyRows;		// total rows to convert & upload this frame
+	int			numBands;
+	struct
+	{
+		int		firstRow;
+		int		numRows;
+	} bands[MAX_DIRTY_BANDS];		// in indexed framebuffer rows (double them for HQ stretch)
+} FramebufferDamage;
+
+extern FramebufferDamage gFramebufferDamage;
+
+// The indexed image and palette that the present path reads from.
+// Usually the live gIndexedFramebuffer/gGamePalette, but the present thread
+// works from a snapshot so that the game can draw the next frame in the meantime.
+extern const uint8_t* gPresentSourceFramebuffer;
+extern const struct GamePalette_s* gPresentSourcePalette;
+
+// If not null, the PF window of gPresentSourceFramebuffer is stale and must be read from the ring buffer.
+// UpdateFramebufferDamage takes care of it, and points gPresentSourceFramebuffer to its own flat copy
+// of the frame, which is what the converters and uploaders read from.
+extern struct PlayfieldView* gPresentSourceView;
+
+// The prefs that the present path reads. SyncPresentPrefs copies them from gGamePrefs
+// with each frame, so the settings screen can change gGamePrefs while the present thread works.
+typedef struct PresentPrefs
+{
+	bool		filterDithering;
+	uint8_t		prescaleFilter;
+	bool		deferredTexUpload;
+	uint8_t		colorDepth;
+} PresentPrefs;
+
+extern PresentPrefs gPresentPrefs;
+
+int UpdateFramebufferDamage(bool indicesOnly);
+void InvalidateFramebufferDamage(void);
+void ConvertFramebufferMT(void* colorBuffer);
+int GetPreferredBytesPerPixel(int autoBytesPerPixel);
 void InitRenderThreads(void);
 void ShutdownRenderThreads(void);
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+#define NUM_JITTER_BUCKETS	10
+
+// A paced stream of frames (simulation ticks, Mac ticks, display refreshes...).
+// Each clock keeps its own deadline and a histogram of how far each frame time
+// strayed from the nominal period.
+typedef struct FrameClock
+{
+	const char*	name;
+	uint64_t	periodNS;				// nominal frame duration
+	uint64_t	deadlineNS;				// when the next frame is due (0: schedule not started)
+	uint64_t	lastFrameNS;			// when the previous frame was released (0: none yet)
+	uint32_t	numFrames;
+	uint32_t	numRestarts;			// times the schedule was dropped (paused, or fell too far behind)
+	uint64_t	maxJitterNS;
+	uint32_t	jitterHistogram[NUM_JITTER_BUCKETS];	// |frame time - period|
+} FrameClock;
+
+extern FrameClock gSimClock;			// 32 Hz simulation tick (fixed-framerate game loop)
+extern FrameClock gTickClock;			// 60 Hz Mac tick (RegulateSpeed2, Wait)
+extern FrameClock gMicrosecondClock;	// arbitrary period (RegulateSpeed)
+extern FrameClock gDisplayClock;		// display refresh (tweened game loop; paced by vsync, not by us)
+
+#define kNanosecondsPerMacTick		(1000000000ull / 60)
+#define kNanosecondsPerSimFrame		(1000000000ull / GAME_FPS)
+
+// Sleeps until SDL_GetTicksNS() reaches the deadline: coarse OS sleep, then a short spin
+void SleepUntilNS(uint64_t deadlineNS);
+
+// Waits until the clock's next deadline, then schedules the one after it (periodNS later)
+void WaitForNextFrame(FrameClock* clock, uint64_t periodNS);
+
+// Records a frame that something else paced (e.g. vsync)
+void MarkFrame(FrameClock* clock);
+
+// Paces the tweened game loop on gDisplayClock. Call WaitForNextDisplayFrame before drawing a frame
+// and EndDisplayFrame once it's presented; the wakeup adapts to how long that usually takes.
+void WaitForNextDisplayFrame(uint64_t periodNS);
+void EndDisplayFrame(void);
+uint64_t GetDisplayRefreshPeriodNS(void);
+
+void SetDisplayRefreshRate(float hz);
+void ResetFrameSchedulerStats(void);
+void DumpFrameSchedulerStats(void);
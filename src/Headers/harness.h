@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Stages of a fixed-framerate game frame, timed separately by the harness
+enum
+{
+	kHarnessStage_Input,		// UpdateShakeyScreen, ReadKeyboard
+	kHarnessStage_Move,			// MoveObjects, SortObjectsByY
+	kHarnessStage_Scroll,		// ScrollPlayfield, UpdateTileAnimation
+	kHarnessStage_Sprites,		// DrawObjects
+	kHarnessStage_Playfield,	// DisplayPlayfield
+	kHarnessStage_Infobar,		// UpdateInfoBar
+	kHarnessStage_Erase,		// EraseObjects
+	kHarnessStage_Present,		// PresentIndexedFramebuffer
+	NUM_HARNESS_STAGES
+};
+
+extern bool gHarnessActive;
+
+#define HARNESS_STAGE(stage)				\
+	do {									\
+		if (gHarnessActive)					\
+			HarnessBeginStage(stage);		\
+	} while (0)
+
+// Returns true if a harness run was requested (MIGHTYMIKE_HARNESS=<script>)
+bool InitHarness(void);
+void RunHarness(void);
+
+void HarnessBeginStage(int stage);
+void HarnessEndFrame(void);
+bool GetScriptedNeedState(int needID);
+int GetHarnessExitCode(void);
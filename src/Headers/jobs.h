@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+#define MAX_JOB_WORKERS		32
+#define MAX_JOBS_PER_BATCH	1024
+
+// Job function. 'workerNum' identifies the thread running the job (0 is the calling thread)
+// and is stable for the duration of the job, so it can index per-worker scratch memory.
+typedef void (*JobFunc)(void* userData, int workerNum, int jobIndex);
+
+typedef struct JobWorkerStats
+{
+	uint64_t	busyTicks;			// time spent running jobs (SDL performance-counter ticks)
+	uint64_t	idleTicks;			// time spent inside a batch without a job to run
+	uint32_t	jobsRun;
+	uint32_t	jobsStolen;			// jobs taken from another worker's queue
+} JobWorkerStats;
+
+void InitJobSystem(void);
+void ShutdownJobSystem(void);
+int GetNumJobWorkers(void);
+
+// Runs func(userData, workerNum, i) for every i in [0, numJobs) across all workers,
+// including the calling thread. Returns when all jobs are complete.
+// Jobs are handed out in contiguous runs per worker; idle workers steal from the back of busy workers' queues.
+// Batches submitted from several threads run one after the other.
+// Not reentrant: don't call this from within a job.
+void RunParallelJobs(JobFunc func, void* userData, int numJobs);
+
+// Stats are updated by each worker without synchronization,
+// so they may be slightly behind when read between batches. Good enough for debug display.
+const JobWorkerStats* GetJobWorkerStats(int workerNum);
+void ResetJobWorkerStats(void);
@@ -15,9 +15,6 @@
 // Duration of a simulation frame in microseconds.
 #define		GAME_SPEED_MICROSECONDS		(1000L*1000L/(GAME_FPS))
 
-// Duration of a simulation frame in milliseconds (SDL clock ticks).
-#define		GAME_SPEED_SDL				(1000/(GAME_FPS))
-
 #define	ONE_PLAYER		0
 #define	TWO_PLAYER		1
 
@@ -55,6 +52,10 @@ void	InitPaletteStuff(void);
 void	FadeInGameCLUT(void);
 void	EraseCLUT(void);
 void	FadeOutGameCLUT(void);
+void	StartFadeInGameCLUT(void);
+void	StartFadeOutGameCLUT(void);
+Boolean	IsGameCLUTFading(void);
+void	UpdateGameCLUTFade(void);
 void	SetPaletteColorCorrection(void);
 void	SetPaletteColor(struct GamePalette_s *palette, int index, const RGBColor *color);
 
@@ -65,6 +65,15 @@ struct TileAttribType
 typedef struct TileAttribType TileAttribType;
 
 
+// What the tile mask looks like in each tile cell of the PF buffer (see gPFTileMaskStates)
+enum
+{
+	kTileMask_Clear,					// all 0x00: sprites draw over the tile
+	kTileMask_Solid,					// all 0xFF: the tile hides sprites completely
+	kTileMask_Pixels,					// mixed: the tile hides sprites pixel by pixel
+};
+
+
 struct TileAnimDefType
 {
 	int16_t		speed;					// speed of anim
@@ -114,8 +123,8 @@ void	StartShakeyScreen(short);
 void	UpdateShakeyScreen(void);
 short	MoveOnPath(long, Boolean);
 Boolean	NilAdd(ObjectEntryType *);
-void	CreatePlayfieldPermanentMemory(void);
 void	UpdateTileAnimation(void);
+Boolean	CheckPriorityTiles(long row, long leftCol, long rightCol);
 
 // Editor accessors
 int MM_GetNumTiles(void);
@@ -3,8 +3,39 @@
 void GLRender_Init(void);
 void GLRender_Shutdown(void);
 void GLRender_PresentFramebuffer(void);
+void GLRender_ReleaseContext(void);
 
 Boolean SDLRender_Init(void);
 void SDLRender_Shutdown(void);
 void SDLRender_InitTexture(void);
 void SDLRender_PresentFramebuffer(void);
+
+// Headless driver (no window), selected at runtime with MIGHTYMIKE_RENDER_DRIVER=null
+extern Boolean gHeadless;
+Boolean NullRender_Init(void);
+void NullRender_Shutdown(void);
+void NullRender_InitTexture(void);
+void NullRender_PresentFramebuffer(void);
+const void* NullRender_GetFinalFramebuffer(size_t* outSize);
+
+// Per-frame cost of each presentation stage, accumulated in
+// SDL performance-counter ticks until the debug title bar is refreshed.
+typedef struct RenderTimings
+{
+	uint32_t	numFrames;
+	uint64_t	map;			// waiting for/mapping the upload buffer
+	uint64_t	convert;		// indexed -> RGB conversion
+	uint64_t	upload;			// texture upload calls
+	uint64_t	swap;			// buffer swap / present
+} RenderTimings;
+
+extern RenderTimings gRenderTimings;
+
+typedef struct PresentPipelineStats
+{
+	uint32_t	numFrames;
+	uint64_t	mainWaitTicks;			// main thread waiting for the present thread to finish the previous frame
+	uint64_t	presentWaitTicks;		// present thread waiting for the main thread to submit a frame
+} PresentPipelineStats;
+
+extern PresentPipelineStats gPresentPipelineStats;
@@ -23,9 +23,22 @@ typedef struct FrameList
 } FrameList;
 #pragma pack(pop)
 
+// Everything needed to draw a frame, gathered from the shape file at load time (see GetFrameDesc)
+typedef struct FrameDesc
+{
+	int16_t						width;
+	int16_t						height;
+	int16_t						x;
+	int16_t						y;
+	const uint8_t*				pixels;
+	const uint8_t*				mask;
+	const struct FrameSpans*	spans;		// mask analysis, private to the shape manager
+} FrameDesc;
+
 ObjNode	*MakeNewShape(long groupNum, long type, long subType, short x, short y, short z, void (*moveCall)(void), Boolean pfRelativeFlag);
 void LoadShapeTable(const char* filename, long groupNum);
-const FrameHeader* GetFrameHeader(long groupNum, long shapeNum, long frameNum, const uint8_t** outPixelPtr, const uint8_t** outMaskPtr);
+const FrameDesc* GetFrameDesc(long groupNum, long shapeNum, long frameNum);
+void	RebuildFrameTable(long groupNum);
 void	DrawFrameToScreen(long, long, long, long, long);
 void	DrawFrameToScreen_NoMask(long, long, long, long, long);
 void DrawFrameToBackground(long x, long y, long groupNum, long shapeNum, long frameNum);
@@ -33,3 +46,24 @@ void	ZapShapeTable(long);
 bool	CheckFootPriority(long x, long y, long width);
 void	DrawASprite(ObjNode *);
 void	EraseASprite(ObjNode *);
+void	BeginSpriteBatch(void);
+void	EndSpriteBatch(void);
+
+typedef struct SpriteKernels
+{
+	const char*	name;
+
+	// dst = (dst & mask) | src, over a width x height rectangle
+	void		(*blitMasked)(uint8_t* dst, int dstPitch,
+							  const uint8_t* src, const uint8_t* mask, int srcPitch,
+							  int width, int height);
+
+	// Same, but pixels under set bits in tileMask (same pitch as dst) keep the background
+	void		(*blitMaskedPriority)(uint8_t* dst, const uint8_t* tileMask, int dstPitch,
+									  const uint8_t* src, const uint8_t* mask, int srcPitch,
+									  int width, int height);
+} SpriteKernels;
+
+extern SpriteKernels gSpriteKernels;
+
+void InitSpriteKernels(void);
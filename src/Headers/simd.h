@@ -0,0 +1,31 @@
+#pragma once
+
+// Shared by the vector kernel files (FramebufferKernels.c, SpriteKernels.c).
+// Kernels are compiled per instruction set with TARGET_xxx and picked at runtime,
+// so the base build flags don't need to enable any of them.
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define KERNELS_X86 1
+	#include <immintrin.h>
+	#if defined(__GNUC__) || defined(__clang__)
+		#define TARGET_SSE2 __attribute__((target("sse2")))
+		#define TARGET_AVX2 __attribute__((target("avx2")))
+	#else
+		#define TARGET_SSE2
+		#define TARGET_AVX2
+	#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	#define KERNELS_NEON 1
+	#include <arm_neon.h>
+#endif
+
+#if _DEBUG
+// Deterministic filler for the kernel self-tests (LCG; the low bits are dropped).
+static inline uint32_t SelfTestRandom(uint32_t* seed)
+{
+	*seed = *seed * 1664525u + 1013904223u;
+	return *seed >> 8;
+}
+#endif
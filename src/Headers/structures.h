@@ -304,8 +304,13 @@ struct PrefsType
 	Boolean		debugInfoInTitleBar;
     Boolean		colorCorrection;
     Boolean		autoFireSingleShots;   // hold-to-fire for single-shot weapons
+	Boolean		deferredTexUpload;		// GL renderer: upload frame after swapping buffers
+	Byte		presentLatency;			// 0: present on main thread; 1: present previous frame on a separate thread
+	Byte		prescaleFilter;			// HQ stretch: kPrescale_Nearest or kPrescale_EPX
+	Byte		colorDepth;				// kColorDepth_Auto, kColorDepth_16 or kColorDepth_32
+	Byte		frameCap;				// smooth frame rate pacing (kFrameCap_...)
     KeyBinding	keys[NUM_CONTROL_NEEDS];
 };
 typedef struct PrefsType PrefsType;
 
-#define PREFS_MAGIC "Mighty Mike Prefs v6"
+#define PREFS_MAGIC "Mighty Mike Prefs v11"
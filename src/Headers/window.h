@@ -2,6 +2,8 @@
 // WINDOWS.h
 //
 
+#pragma once
+
 
 					/* OFFSCREEN DEFINES */
 
@@ -21,6 +23,20 @@
 
 
 
+// The PF window of the framebuffer may be left in the Playfield ring buffer instead
+// of being copied into gIndexedFramebuffer every frame (see DisplayPlayfield).
+// The present path reads it from there. Anything else that reads or draws into
+// gIndexedFramebuffer must call ResolvePlayfieldView first.
+typedef struct PlayfieldView
+{
+	bool			live;				// PF window pixels in gIndexedFramebuffer are stale
+	int				left;				// top-left corner of the window in the ring buffer
+	int				top;
+	const uint8_t*	presentedFrame;		// once presented: a flat copy of the whole frame
+} PlayfieldView;
+
+extern PlayfieldView gPlayfieldView;
+
 void CleanupDisplay(void);
 
 void	EraseBackgroundBuffer(void);
@@ -34,7 +50,17 @@ void	BlankEntireScreenArea(void);
 void	SetScreenOffsetForArea(void);
 void	SetScreenOffsetFor640x480(void);
 
+void	SetPlayfieldView(int left, int top);
+int		GetPlayfieldViewRow(const PlayfieldView* view, int y, const uint8_t* outSrc[2], int outWidth[2]);
+void	ComposePlayfieldView(uint8_t* dst);
+void	ResolvePlayfieldView(void);
+void	ResolvePlayfieldViewRect(int left, int top, int right, int bottom);
+
 void PresentIndexedFramebuffer(void);
+void SubmitFrameForPresentation(void);
+void FlushPresentPipeline(void);
+void SyncPresentPrefs(void);
+void ShutdownPresentPipeline(void);
 void DumpIndexedTGA(const char* hostPath, int width, int height, const char* data);
 void SetFullscreenMode(bool enforceDisplayPref);
 int GetNumDisplays(void);
@@ -2,180 +2,322 @@
 // (C) 2025 Iliyas Jorio
 // This file is part of Mighty Mike. https://github.com/jorio/mightymike
 
-#include <SDL3/SDL_mutex.h>
-#include <SDL3/SDL_thread.h>
-
 #include "externs.h"
 #include "misc.h"
 #include "window.h"
+#include "playfield.h"
 #include "framebufferfilter.h"
+#include "jobs.h"
 
 int gNumThreads = 0;
-
-static SDL_Thread* gRenderThreadPool[MAX_RENDER_THREADS];
-static SDL_Mutex* gMutex;
-static SDL_Condition* gCondition_GetToWork;			// Main thread tells worker threads to start processing the image
-static SDL_Condition* gCondition_AllThreadsReady;	// Last thread tells main thread the image is complete
-static bool gQuitRenderThreads = false;
-static int gNumThreadsReady = 0;
-
-static color_t gScratch[1024*512];  // todo: actual size
-static color_t* gFinalColor = NULL;
-
-typedef struct ThreadParams { int threadNum, firstRow, numRows; } ThreadParams;
+int gFramebufferBytesPerPixel = 4;
+
+static uint32_t gScratch[1024*512];  // todo: actual size (big enough for either color depth)
+static void* gFinalColor = NULL;
+
+// The converter's work is split into small chunks of rows so that the job system
+// can balance the load between fast and slow cores.
+#define kRowsPerConvertJob 16
+
+typedef struct ConvertJob { int16_t firstRow, numRows; } ConvertJob;
+static ConvertJob gConvertJobs[MAX_JOBS_PER_BATCH];
+
+// Dirty row tracking.
+// We keep a copy of the indexed rows that were last converted, and only convert rows that differ.
+// Anything that affects all rows (palette, filter, scaling, new texture) forces a full update.
+FramebufferDamage gFramebufferDamage;
+static uint8_t* gPresentedFramebuffer = NULL;
+static int gPresentedWidth = 0;
+static int gPresentedHeight = 0;
+static int gPresentedScalingType = kScaling_Unspecified;
+static int gPresentedPrescale = 0;
+static int gPresentedPrescaleFilter = -1;
+static int gPresentedBytesPerPixel = 0;
+static bool gPresentedDithering = false;
+static bool gForceFullUpdate = true;
+static uint32_t gPresentedColors32[256];
+static uint16_t gPresentedColors16[256];
+
+// Don't split bands over small gaps of clean rows: one upload is cheaper than two
+static const int kMinCleanGapBetweenBands = 8;
 
 // ----------------------------------------------------------------------------
 
-static void Convert(int threadNum, int firstRow, int numRows)
+static void ConvertRows(int threadNum, int firstRow, int numRows)
 {
-	bool doX2 = gEffectiveScalingType == kScaling_HQStretch;
+	bool doPrescale = gPrescale > 1;
 
-	color_t* scratch = doX2 ? gScratch: gFinalColor;
+	void* scratch = doPrescale ? gScratch: gFinalColor;
 
-	if (gGamePrefs.filterDithering)
+	if (gPresentPrefs.filterDithering)
 		IndexedFramebufferToColor_FilterDithering(scratch, threadNum, firstRow, numRows);
 	else
 		IndexedFramebufferToColor_NoFilter(scratch, firstRow, numRows);
 
-	if (gEffectiveScalingType == kScaling_HQStretch)
-		DoublePixels(scratch, gFinalColor, firstRow, numRows);
+	if (doPrescale)
+		PrescalePixels(scratch, gFinalColor, gPrescale, gPresentPrefs.prescaleFilter, firstRow, numRows);
+}
+
+static void ConvertJobFunc(void* userData, int workerNum, int jobIndex)
+{
+	(void) userData;
+	const ConvertJob* job = &gConvertJobs[jobIndex];
+	ConvertRows(workerNum, job->firstRow, job->numRows);
+}
+
+void InitRenderThreads(void)
+{
+	GAME_ASSERT(gNumThreads == 0);
+
+	InitFramebufferKernels();
+	InitJobSystem();
+
+	// The dithering filter keeps scratch memory per worker
+	gNumThreads = GetNumJobWorkers();
 }
 
-static int ConverterThread(void* data)
+// ----------------------------------------------------------------------------
+// Dirty rows
+
+// Row y of the frame being presented, in up to 4 pieces: if the PF window is still in the
+// ring buffer (see PlayfieldView), it sits between two bits of the framebuffer and may wrap.
+typedef struct RowPiece
+{
+	const uint8_t*	src;
+	int				x;
+	int				width;
+} RowPiece;
+
+static int GetSourceRowPieces(int y, RowPiece pieces[4])
 {
-	ThreadParams params = *(ThreadParams*) data;
+	const uint8_t* row = gPresentSourceFramebuffer + y * VISIBLE_WIDTH;
 
-	while (true)
+	if (!gPresentSourceView || y < PF_WINDOW_TOP || y >= PF_WINDOW_TOP + PF_WINDOW_HEIGHT)
 	{
-		SDL_LockMutex(gMutex);
-		{
-			// We're ready to receive more work.
-			gNumThreadsReady++;
-
-			// When all threads are ready, tell the main thread to present the image.
-			if (gNumThreadsReady == gNumThreads)
-			{
-				gNumThreadsReady = 0;
-				SDL_SignalCondition(gCondition_AllThreadsReady);
-			}
-
-			// Let main thread wake us up when it's time to process the next image.
-			SDL_WaitCondition(gCondition_GetToWork, gMutex);
-			GAME_ASSERT(gNumThreadsReady < gNumThreads);
-		}
-		SDL_UnlockMutex(gMutex);
+		pieces[0] = (RowPiece) { row, 0, VISIBLE_WIDTH };
+		return 1;
+	}
+
+	int numPieces = 0;
+	int x = PF_WINDOW_LEFT;
+
+	if (x > 0)
+		pieces[numPieces++] = (RowPiece) { row, 0, x };
 
-		if (gQuitRenderThreads)
-			break;
+	const uint8_t* segSrc[2];
+	int segWidth[2];
+	int numSegs = GetPlayfieldViewRow(gPresentSourceView, y, segSrc, segWidth);
 
-		// Do the work
-		Convert(params.threadNum, params.firstRow, params.numRows);
+	for (int i = 0; i < numSegs; i++)
+	{
+		pieces[numPieces++] = (RowPiece) { segSrc[i], x, segWidth[i] };
+		x += segWidth[i];
 	}
 
-	return 0;
+	if (x < VISIBLE_WIDTH)
+		pieces[numPieces++] = (RowPiece) { row + x, x, VISIBLE_WIDTH - x };
+
+	return numPieces;
 }
 
-void InitRenderThreads(void)
+static bool IsRowClean(int y, const uint8_t* presentedRow)
 {
-	static ThreadParams threadParams[MAX_RENDER_THREADS];
-	char name[32];
+	RowPiece pieces[4];
+	int numPieces = GetSourceRowPieces(y, pieces);
 
-	GAME_ASSERT(gNumThreads == 0);
-	GAME_ASSERT(gNumThreadsReady == 0);
-	GAME_ASSERT(!gMutex);
-	GAME_ASSERT(!gCondition_GetToWork);
-	GAME_ASSERT(!gCondition_AllThreadsReady);
+	for (int i = 0; i < numPieces; i++)
+	{
+		if (0 != SDL_memcmp(presentedRow + pieces[i].x, pieces[i].src, pieces[i].width))
+			return false;
+	}
 
-	gNumThreads = SDL_GetNumLogicalCPUCores();
-	gNumThreads = SDL_clamp(gNumThreads, 1, MAX_RENDER_THREADS);
-	SDL_Log("Render thread pool: %d", gNumThreads);
+	return true;
+}
 
-	if (gNumThreads <= 1)	// single-threaded rendering: don't create extra threads
+static void CopyRow(int y, uint8_t* presentedRow)
+{
+	RowPiece pieces[4];
+	int numPieces = GetSourceRowPieces(y, pieces);
+
+	for (int i = 0; i < numPieces; i++)
 	{
-		return;
+		SDL_memcpy(presentedRow + pieces[i].x, pieces[i].src, pieces[i].width);
 	}
+}
 
-	gMutex = SDL_CreateMutex();
-	gCondition_AllThreadsReady = SDL_CreateCondition();
-	gCondition_GetToWork = SDL_CreateCondition();
-	gQuitRenderThreads = false;
+void InvalidateFramebufferDamage(void)
+{
+	gForceFullUpdate = true;
+}
 
-	SDL_LockMutex(gMutex);
+static void DisposeFramebufferDamage(void)
+{
+	CHECKED_DISPOSEPTR(gPresentedFramebuffer);
+	gPresentedWidth = 0;
+	gPresentedHeight = 0;
+	gForceFullUpdate = true;
+}
 
-	int rowsPerThread = VISIBLE_HEIGHT / gNumThreads;
-	int remainder = VISIBLE_HEIGHT - rowsPerThread * gNumThreads;
-	int y = 0;
+static void AddDirtyBand(int firstRow, int numRows)
+{
+	FramebufferDamage* damage = &gFramebufferDamage;
 
-	for (int i = 0; i < gNumThreads; i++)
+	if (damage->numBands > 0)
 	{
-		// Distribute number of rows as evenly as possible
-		int rowsThisThread = rowsPerThread;
-		if (remainder > 0)
+		int* lastFirst = &damage->bands[damage->numBands-1].firstRow;
+		int* lastNum = &damage->bands[damage->numBands-1].numRows;
+		int gap = firstRow - (*lastFirst + *lastNum);
+
+		// Extend the previous band if the gap is small or if we're out of bands
+		if (gap < kMinCleanGapBetweenBands || damage->numBands == MAX_DIRTY_BANDS)
+		{
+			*lastNum = firstRow + numRows - *lastFirst;
+			return;
+		}
+	}
+
+	damage->bands[damage->numBands].firstRow = firstRow;
+	damage->bands[damage->numBands].numRows = numRows;
+	damage->numBands++;
+}
+
+// Compares the indexed framebuffer to the last frame that we converted
+// and works out which row bands need to be converted and uploaded.
+// Call this before ConvertFramebufferMT. Returns the number of dirty rows.
+// Pass indicesOnly=true if the caller uploads raw palette indices (e.g. the GL palette shader),
+// so that palette, filter and scaling changes don't dirty any rows.
+int UpdateFramebufferDamage(bool indicesOnly)
+{
+	const int width = VISIBLE_WIDTH;
+	const int height = VISIBLE_HEIGHT;
+
+	if (width != gPresentedWidth || height != gPresentedHeight)
+	{
+		DisposeFramebufferDamage();
+		gPresentedFramebuffer = (uint8_t*) NewPtr(width * height);
+		GAME_ASSERT(gPresentedFramebuffer);
+		gPresentedWidth = width;
+		gPresentedHeight = height;
+	}
+
+	bool full = gForceFullUpdate
+		|| (!indicesOnly && gPresentedScalingType != gEffectiveScalingType)
+		|| (!indicesOnly && gPresentedPrescale != gPrescale)
+		|| (!indicesOnly && gPresentedPrescaleFilter != gPresentPrefs.prescaleFilter)
+		|| (!indicesOnly && gPresentedBytesPerPixel != gFramebufferBytesPerPixel)
+		|| (!indicesOnly && gPresentedDithering != gPresentPrefs.filterDithering)
+		|| (!indicesOnly && 0 != SDL_memcmp(gPresentedColors32, gPresentSourcePalette->finalColors32, sizeof(gPresentedColors32)))
+		|| (!indicesOnly && 0 != SDL_memcmp(gPresentedColors16, gPresentSourcePalette->finalColors16, sizeof(gPresentedColors16)));
+
+	if (full)
+	{
+		gForceFullUpdate = false;
+		gPresentedScalingType = gEffectiveScalingType;
+		gPresentedPrescale = gPrescale;
+		gPresentedPrescaleFilter = gPresentPrefs.prescaleFilter;
+		gPresentedBytesPerPixel = gFramebufferBytesPerPixel;
+		gPresentedDithering = gPresentPrefs.filterDithering;
+		SDL_memcpy(gPresentedColors32, gPresentSourcePalette->finalColors32, sizeof(gPresentedColors32));
+		SDL_memcpy(gPresentedColors16, gPresentSourcePalette->finalColors16, sizeof(gPresentedColors16));
+	}
+
+	bool epx = !indicesOnly && gPrescale > 1 && gPresentPrefs.prescaleFilter == kPrescale_EPX;
+
+	gFramebufferDamage.numBands = 0;
+	gFramebufferDamage.numDirtyRows = 0;
+
+	for (int y = 0; y < height; )
+	{
+		uint8_t* presentedRow = gPresentedFramebuffer + y * width;
+
+		if (!full && IsRowClean(y, presentedRow))
 		{
-			rowsThisThread++;
-			remainder--;
+			y++;
+			continue;
 		}
 
-		SDL_snprintf(name, sizeof(name), "Filter%c-%03d-%03d", 'A' + i, y, y+rowsThisThread-1);
+		int runStart = y;
+		do
+		{
+			CopyRow(y, presentedRow);
+			y++;
+			presentedRow += width;
+		} while (y < height && (full || !IsRowClean(y, presentedRow)));
+
+		// EPX looks at the rows above and below, so their prescaled output changes too
+		if (epx)
+			AddDirtyBand(SDL_max(0, runStart - 1), SDL_min(height, y + 1) - SDL_max(0, runStart - 1));
+		else
+			AddDirtyBand(runStart, y - runStart);
+	}
 
-		threadParams[i] = (ThreadParams) { .threadNum = i, .firstRow = y, .numRows = rowsThisThread };
+	// The converter processes whole bands. This includes any clean rows that got merged
+	// into a band, because the renderer's staging buffer may not hold them anymore.
+	for (int i = 0; i < gFramebufferDamage.numBands; i++)
+	{
+		gFramebufferDamage.numDirtyRows += gFramebufferDamage.bands[i].numRows;
+	}
 
-		// Create thread
-		gRenderThreadPool[i] = SDL_CreateThread(ConverterThread, name, &threadParams[i]);
+	// Our copy is now identical to the frame, and it's in one piece, so read from it from here on
+	gPresentSourceFramebuffer = gPresentedFramebuffer;
 
-		y += rowsThisThread;
+	if (gPresentSourceView)
+	{
+		gPresentSourceView->presentedFrame = gPresentedFramebuffer;
 	}
 
-	// Wait for all threads to be ready so they don't miss the condition when we start rendering
-	SDL_WaitCondition(gCondition_AllThreadsReady, gMutex);
-	SDL_UnlockMutex(gMutex);
+	return gFramebufferDamage.numDirtyRows;
 }
 
-void ConvertFramebufferMT(color_t* colorBuffer)
+// ----------------------------------------------------------------------------
+
+void ConvertFramebufferMT(void* colorBuffer)
 {
 	GAME_ASSERT(gNumThreads != 0);
 
 	gFinalColor = colorBuffer;
 
-	if (gNumThreads == 1)	// single-threaded: do rendering on main thread
+	// Chop the dirty bands into jobs
+	int numJobs = 0;
+
+	for (int i = 0; i < gFramebufferDamage.numBands; i++)
 	{
-		Convert(0, 0, VISIBLE_HEIGHT);
-		return;
+		int firstRow = gFramebufferDamage.bands[i].firstRow;
+		int endRow = firstRow + gFramebufferDamage.bands[i].numRows;
+
+		for (int y = firstRow; y < endRow; y += kRowsPerConvertJob)
+		{
+			GAME_ASSERT(numJobs < MAX_JOBS_PER_BATCH);
+			gConvertJobs[numJobs].firstRow = y;
+			gConvertJobs[numJobs].numRows = SDL_min(kRowsPerConvertJob, endRow - y);
+			numJobs++;
+		}
 	}
 
-	SDL_LockMutex(gMutex);
-	SDL_BroadcastCondition(gCondition_GetToWork);
-	SDL_WaitCondition(gCondition_AllThreadsReady, gMutex);
-	SDL_UnlockMutex(gMutex);
+	RunParallelJobs(ConvertJobFunc, NULL, numJobs);		// no-op if nothing changed since last frame
 }
 
-void ShutdownRenderThreads(void)
+// Resolves the color depth pref to 2 or 4 bytes per pixel.
+// autoBytesPerPixel is whatever the driver found to be fastest.
+int GetPreferredBytesPerPixel(int autoBytesPerPixel)
 {
-	if (gNumThreads <= 1)
+	switch (gPresentPrefs.colorDepth)
 	{
-		return;
+		case kColorDepth_16:	return 2;
+		case kColorDepth_32:	return 4;
+		default:				return autoBytesPerPixel;
 	}
+}
 
-	// Tell all threads to quit
-	SDL_LockMutex(gMutex);
-	gQuitRenderThreads = true;
-	SDL_BroadcastCondition(gCondition_GetToWork);
-	SDL_UnlockMutex(gMutex);
+void ShutdownRenderThreads(void)
+{
+	DisposeFramebufferDamage();
 
-	// Join all threads
-	for (int i = 0; i < gNumThreads; i++)
+	if (gNumThreads == 0)
 	{
-		SDL_WaitThread(gRenderThreadPool[i], NULL);
-		gRenderThreadPool[i] = NULL;
+		return;
 	}
 
+	ShutdownJobSystem();
 	gNumThreads = 0;
-	gNumThreadsReady = 0;
-
-	SDL_DestroyMutex(gMutex);
-	SDL_DestroyCondition(gCondition_GetToWork);
-	SDL_DestroyCondition(gCondition_AllThreadsReady);
-	gMutex = NULL;
-	gCondition_GetToWork = NULL;
-	gCondition_AllThreadsReady = NULL;
 }
@@ -0,0 +1,233 @@
+// FRAME SCHEDULER
+// (C) 2025 Iliyas Jorio
+// This file is part of Mighty Mike. https://github.com/jorio/mightymike
+//
+// Frame pacing with nanosecond deadlines. We sleep until shortly before the deadline,
+// then spin the rest of the way. The sleep's lead time adapts to how much the OS
+// tends to oversleep, so we spin for as little time as we can get away with.
+//
+// Deadlines advance by whole periods (rather than "period after the last wakeup"),
+// so timer granularity doesn't make the game run slow.
+
+#include <SDL3/SDL.h>
+
+#include "myglobals.h"
+#include "externs.h"
+#include "misc.h"
+#include "renderdrivers.h"
+#include "framescheduler.h"
+
+// A frame that's more than this many periods late restarts the schedule instead of catching up
+#define kMaxPeriodsBehind		1
+
+// Frame times over this many periods aren't frame-to-frame jitter; the clock was idle
+#define kMaxPeriodsPerSample	4
+
+static const uint64_t kMinSleepLeadNS		= 250 * 1000;
+static const uint64_t kMaxSleepLeadNS		= 4 * 1000 * 1000;
+
+// Upper bounds of the jitter histogram buckets (the last one catches everything else)
+static const uint32_t kJitterBucketMicroseconds[NUM_JITTER_BUCKETS - 1] =
+{
+	100, 250, 500, 1000, 2000, 4000, 8000, 16000, 32000
+};
+
+FrameClock gSimClock			= { .name = "sim",		.periodNS = kNanosecondsPerSimFrame };
+FrameClock gTickClock			= { .name = "tick",		.periodNS = kNanosecondsPerMacTick };
+FrameClock gMicrosecondClock	= { .name = "us" };
+FrameClock gDisplayClock		= { .name = "display",	.periodNS = 1000000000ull / 60 };
+
+static uint64_t gSleepLeadNS = 2 * 1000 * 1000;		// wake up this long before the deadline
+
+static uint64_t gDisplayRefreshPeriodNS = 1000000000ull / 60;
+static uint64_t gDisplayFrameWorkNS = 0;				// smoothed time from wakeup to end of present
+static uint64_t gDisplayFrameStartNS = 0;
+
+/****************** SLEEP *********************/
+
+void SleepUntilNS(uint64_t deadlineNS)
+{
+	uint64_t now = SDL_GetTicksNS();
+
+	if (now + gSleepLeadNS < deadlineNS)
+	{
+		uint64_t requestNS = deadlineNS - gSleepLeadNS - now;
+		SDL_DelayNS(requestNS);
+
+		uint64_t after = SDL_GetTicksNS();
+
+		// Track how much the OS oversleeps: grow the lead quickly, shrink it slowly
+		uint64_t oversleepNS = (after - now > requestNS) ? (after - now - requestNS) : 0;
+		uint64_t lead = SDL_max(oversleepNS + oversleepNS / 4, gSleepLeadNS - gSleepLeadNS / 16);
+		gSleepLeadNS = SDL_clamp(lead, kMinSleepLeadNS, kMaxSleepLeadNS);
+
+		now = after;
+	}
+
+	while (now < deadlineNS)
+	{
+		SDL_CPUPauseInstruction();
+		now = SDL_GetTicksNS();
+	}
+}
+
+/****************** FRAME CLOCKS *********************/
+
+void MarkFrame(FrameClock* clock)
+{
+	uint64_t now = SDL_GetTicksNS();
+
+	if (clock->lastFrameNS != 0 && clock->periodNS != 0)
+	{
+		uint64_t frameNS = now - clock->lastFrameNS;
+
+		if (frameNS <= clock->periodNS * kMaxPeriodsPerSample)
+		{
+			uint64_t jitterNS = frameNS > clock->periodNS
+					? frameNS - clock->periodNS
+					: clock->periodNS - frameNS;
+
+			int bucket = 0;
+			while (bucket < NUM_JITTER_BUCKETS - 1 && jitterNS > kJitterBucketMicroseconds[bucket] * 1000ull)
+				bucket++;
+
+			clock->jitterHistogram[bucket]++;
+			clock->maxJitterNS = SDL_max(clock->maxJitterNS, jitterNS);
+		}
+	}
+
+	clock->lastFrameNS = now;
+	clock->numFrames++;
+}
+
+// Waits until leadNS before the clock's next deadline, then schedules the one after it
+static void WaitForDeadline(FrameClock* clock, uint64_t periodNS, uint64_t leadNS)
+{
+	clock->periodNS = periodNS;
+
+	if (gHeadless)									// no one's watching, go as fast as we can
+	{
+		clock->numFrames++;
+		return;
+	}
+
+	uint64_t now = SDL_GetTicksNS();
+
+	if (clock->deadlineNS == 0 || now > clock->deadlineNS + periodNS * kMaxPeriodsBehind)
+	{
+		// First frame, or we were away (loading, paused...): start a new schedule from here
+		if (clock->deadlineNS != 0)
+			clock->numRestarts++;
+		clock->deadlineNS = now;
+		clock->lastFrameNS = 0;						// the gap isn't jitter
+	}
+	else
+	{
+		SleepUntilNS(clock->deadlineNS - SDL_min(leadNS, clock->deadlineNS));
+	}
+
+	MarkFrame(clock);
+
+	clock->deadlineNS += periodNS;
+}
+
+void WaitForNextFrame(FrameClock* clock, uint64_t periodNS)
+{
+	WaitForDeadline(clock, periodNS, 0);
+}
+
+/****************** DISPLAY FRAMES *********************/
+//
+// For the tweened game loop. We want each frame to be on screen by its deadline,
+// so we wake up early by however long it usually takes to draw and present a frame.
+// With vsync on, presenting blocks until the next refresh, so the estimate grows to
+// about a full period and we stop sleeping altogether: vsync does the pacing.
+//
+
+void WaitForNextDisplayFrame(uint64_t periodNS)
+{
+	gDisplayFrameWorkNS = SDL_min(gDisplayFrameWorkNS, periodNS);
+	WaitForDeadline(&gDisplayClock, periodNS, gDisplayFrameWorkNS);
+	gDisplayFrameStartNS = SDL_GetTicksNS();
+}
+
+void EndDisplayFrame(void)
+{
+	if (gDisplayFrameStartNS == 0)
+		return;
+
+	uint64_t workNS = SDL_GetTicksNS() - gDisplayFrameStartNS;
+	gDisplayFrameStartNS = 0;
+
+	// React quickly to slower frames so we don't miss deadlines; relax slowly
+	if (workNS > gDisplayFrameWorkNS)
+		gDisplayFrameWorkNS = (gDisplayFrameWorkNS + workNS) / 2;
+	else
+		gDisplayFrameWorkNS -= (gDisplayFrameWorkNS - workNS) / 16;
+}
+
+uint64_t GetDisplayRefreshPeriodNS(void)
+{
+	return gDisplayRefreshPeriodNS;
+}
+
+void SetDisplayRefreshRate(float hz)
+{
+	if (hz <= 0)									// unknown (e.g. some virtual displays)
+		hz = 60;
+
+	gDisplayRefreshPeriodNS = (uint64_t) (1e9 / hz);
+	gDisplayClock.periodNS = gDisplayRefreshPeriodNS;
+	gDisplayClock.lastFrameNS = 0;
+}
+
+/****************** STATS *********************/
+
+static FrameClock* const kAllClocks[] = { &gSimClock, &gTickClock, &gMicrosecondClock, &gDisplayClock };
+
+void ResetFrameSchedulerStats(void)
+{
+	for (size_t i = 0; i < SDL_arraysize(kAllClocks); i++)
+	{
+		FrameClock* clock = kAllClocks[i];
+		clock->numFrames = 0;
+		clock->numRestarts = 0;
+		clock->maxJitterNS = 0;
+		SDL_zeroa(clock->jitterHistogram);
+	}
+}
+
+void DumpFrameSchedulerStats(void)
+{
+	SDL_Log("Frame scheduler: sleep lead %.2f ms, refresh %.2f ms, display frame work %.2f ms",
+			gSleepLeadNS * 1e-6, gDisplayRefreshPeriodNS * 1e-6, gDisplayFrameWorkNS * 1e-6);
+
+	for (size_t i = 0; i < SDL_arraysize(kAllClocks); i++)
+	{
+		const FrameClock* clock = kAllClocks[i];
+
+		if (clock->numFrames == 0)
+			continue;
+
+		char histogram[256] = "";
+		size_t len = 0;
+		for (int b = 0; b < NUM_JITTER_BUCKETS; b++)
+		{
+			if (b < NUM_JITTER_BUCKETS - 1)
+				len += SDL_snprintf(histogram + len, sizeof(histogram) - len, " <%gms:%u", kJitterBucketMicroseconds[b] * 1e-3, clock->jitterHistogram[b]);
+			else
+				len += SDL_snprintf(histogram + len, sizeof(histogram) - len, " more:%u", clock->jitterHistogram[b]);
+
+			if (len >= sizeof(histogram))
+				break;
+		}
+
+		SDL_Log("  %-8s %u frames @ %.2f ms, %u restarts, max jitter %.2f ms, jitter:%s",
+				clock->name,
+				clock->numFrames,
+				clock->periodNS * 1e-6,
+				clock->numRestarts,
+				clock->maxJitterNS * 1e-6,
+				histogram);
+	}
+}
@@ -5,85 +5,98 @@
 #include "externs.h"
 #include "framebufferfilter.h"
 
-static inline void FilterDithering_Row(const uint8_t* indexedRow, uint8_t* rowSmearFlags);
+static inline int FilterDithering_Row(const uint8_t* indexedRow, DitherSpan* spans);
 
-void IndexedFramebufferToColor_NoFilter(color_t* color, int firstRow, int numRows)
+// Dispatch to the kernel variant that matches the framebuffer's color depth
+static inline void ExpandPixels(void* dst, const uint8_t* src, int count)
 {
-	color						= color + firstRow * VISIBLE_WIDTH;
-	const uint8_t* indexed		= gIndexedFramebuffer + firstRow * VISIBLE_WIDTH;
+	if (gFramebufferBytesPerPixel == 2)
+		gFramebufferKernels.expand16((uint16_t*) dst, src, count, gPresentSourcePalette);
+	else
+		gFramebufferKernels.expand32((uint32_t*) dst, src, count, gPresentSourcePalette);
+}
+
+static inline void BlendPixels(void* dst, const uint8_t* src, int count)
+{
+	if (gFramebufferBytesPerPixel == 2)
+		gFramebufferKernels.blend16((uint16_t*) dst, src, count, gPresentSourcePalette);
+	else
+		gFramebufferKernels.blend32((uint32_t*) dst, src, count, gPresentSourcePalette);
+}
+
+void IndexedFramebufferToColor_NoFilter(void* color, int firstRow, int numRows)
+{
+	const int bpp				= gFramebufferBytesPerPixel;
+	uint8_t* colorBytes			= (uint8_t*) color + firstRow * VISIBLE_WIDTH * bpp;
+	const uint8_t* indexed		= gPresentSourceFramebuffer + firstRow * VISIBLE_WIDTH;
+
+	// Rows are contiguous, so the whole band can be expanded in one go
+	ExpandPixels(colorBytes, indexed, numRows * VISIBLE_WIDTH);
+}
+
+void IndexedFramebufferToColor_FilterDithering(void* color, int threadNum, int firstRow, int numRows)
+{
+	const int bpp				= gFramebufferBytesPerPixel;
+	uint8_t* colorBytes			= (uint8_t*) color + firstRow * VISIBLE_WIDTH * bpp;
+	const uint8_t* indexed		= gPresentSourceFramebuffer + firstRow * VISIBLE_WIDTH;
+	DitherSpan* spans			= gRowDitherStrides + threadNum * VISIBLE_WIDTH;
 
 	for (int y = 0; y < numRows; y++)
 	{
-		for (int x = 0; x < VISIBLE_WIDTH; x++)
+		// Expand the entire row, then overwrite smeared pixels with a mix of each pixel and its right-hand neighbor
+		ExpandPixels(colorBytes, indexed, VISIBLE_WIDTH);
+
+		int numSpans = FilterDithering_Row(indexed, spans);
+
+		for (int i = 0; i < numSpans; i++)
 		{
-			*(color++) = gGamePalette.finalColorsXX[*(indexed++)];
+			int x = spans[i].start;
+			BlendPixels(colorBytes + x * bpp, indexed + x, spans[i].end - x + 1);
 		}
+
+		colorBytes += VISIBLE_WIDTH * bpp;
+		indexed += VISIBLE_WIDTH;
 	}
 }
 
-void IndexedFramebufferToColor_FilterDithering(color_t* color, int threadNum, int firstRow, int numRows)
+// For renderers that do the palette lookup on the GPU:
+// interleaves each palette index with a flag (0 or 255) telling whether the pixel must be smeared.
+void IndexedFramebufferToSmearedIndices(uint8_t* indexAndSmear, int threadNum, int firstRow, int numRows)
 {
-	color						= color + firstRow * VISIBLE_WIDTH;
-	const uint8_t* indexed		= gIndexedFramebuffer + firstRow * VISIBLE_WIDTH;
-	uint8_t* smearFlags			= gRowDitherStrides + threadNum * VISIBLE_WIDTH;
-
-#if __BIG_ENDIAN__
-	static const int RI = 0, GI = 1, BI = 2;
-#else
-	static const int RI = 3, GI = 2, BI = 1;
-#endif
+	indexAndSmear				= indexAndSmear + firstRow * VISIBLE_WIDTH * 2;
+	const uint8_t* indexed		= gPresentSourceFramebuffer + firstRow * VISIBLE_WIDTH;
+	DitherSpan* spans			= gRowDitherStrides + threadNum * VISIBLE_WIDTH;
 
 	for (int y = 0; y < numRows; y++)
 	{
-		FilterDithering_Row(indexed, smearFlags);
-
-		for (int x = 0; x < VISIBLE_WIDTH-1; x++)
+		for (int x = 0; x < VISIBLE_WIDTH; x++)
 		{
-			if (smearFlags[x])
-			{
-				uint8_t* left32		= (uint8_t*) &gGamePalette.finalColors32[indexed[0]];
-				uint8_t* right32	= (uint8_t*) &gGamePalette.finalColors32[indexed[1]];
-
-				uint16_t rmix8 = (left32[RI] + right32[RI]) >> 1;
-				uint16_t gmix8 = (left32[GI] + right32[GI]) >> 1;
-				uint16_t bmix8 = (left32[BI] + right32[BI]) >> 1;
-
-#if FRAMEBUFFER_COLOR_DEPTH == 16
-				*color = (bmix8 >> 3) | ((gmix8 >> 2) << 5) | ((rmix8 >> 3) << 11);
-#elif FRAMEBUFFER_COLOR_DEPTH == 32
-				((uint8_t*)color)[RI] = rmix8;
-				((uint8_t*)color)[GI] = gmix8;
-				((uint8_t*)color)[BI] = bmix8;
-#else
-				_Static_assert(false, "unsupported framebuffer color depth");
-#endif
-
-				smearFlags[x] = 0;			// clear for next row
-			}
-			else
-			{
-				*color = gGamePalette.finalColorsXX[*indexed];
-			}
+			indexAndSmear[2*x+0] = indexed[x];
+			indexAndSmear[2*x+1] = 0;
+		}
+
+		int numSpans = FilterDithering_Row(indexed, spans);
 
-			color++;
-			indexed++;
+		for (int i = 0; i < numSpans; i++)
+		{
+			for (int x = spans[i].start; x <= spans[i].end; x++)
+				indexAndSmear[2*x+1] = 255;
 		}
 
-		*color = gGamePalette.finalColorsXX[*indexed];		// last
-		color++;
-		indexed++;
+		indexAndSmear += VISIBLE_WIDTH * 2;
+		indexed += VISIBLE_WIDTH;
 	}
 }
 
-static inline void FilterDithering_Row(const uint8_t* indexedRow, uint8_t* rowSmearFlags)
+static inline int FilterDithering_Row(const uint8_t* indexedRow, DitherSpan* spans)
 {
 	static const int THRESH = 2;
 	static const int BLEED = 1;
 
-	int prev	= -1;
-	int me		= indexedRow[0];
-	int next	= indexedRow[1];
+	// The rightmost pixel is never smeared (it has no right-hand neighbor)
+	const int lastX = VISIBLE_WIDTH - 1;
 
+	int numSpans		= 0;
 	int ditherStart		= 0;
 	int ditherEnd		= -1;
 
@@ -91,12 +104,28 @@ static inline void FilterDithering_Row(const uint8_t* indexedRow, uint8_t* rowSm
 #define COMMIT_STRIDE do { \
 	int ditherLength = ditherEnd - ditherStart;								\
 	if (ditherLength > THRESH)												\
-		SDL_memset(rowSmearFlags+ditherStart, 1, ditherLength+BLEED);		\
+	{																		\
+		int smearEnd = ditherStart + ditherLength + BLEED - 1;				\
+		spans[numSpans].start = ditherStart;								\
+		spans[numSpans].end = SDL_min(smearEnd, lastX - 1);					\
+		numSpans++;															\
+	}																		\
 	} while(0)
 
-	for (int x = 0; x < VISIBLE_WIDTH-1; x++)
+	for (int x = 0; x < lastX; x++)
 	{
-		next = indexedRow[x+1];
+		// Outside of a dither stride, every pixel that can't start one is a no-op,
+		// so let the kernel skip ahead to the next candidate.
+		if (ditherEnd < 0)
+		{
+			x = gFramebufferKernels.findDither(indexedRow, x, lastX);
+			if (x >= lastX)
+				break;
+		}
+
+		int prev	= x > 0 ? indexedRow[x-1] : -1;
+		int me		= indexedRow[x];
+		int next	= indexedRow[x+1];
 
 		if (me==next || me==prev)	// contiguous solid color
 		{
@@ -118,34 +147,144 @@ static inline void FilterDithering_Row(const uint8_t* indexedRow, uint8_t* rowSm
 			COMMIT_STRIDE;			// 			commit current dither stride if any
 			ditherEnd = -1;			// 			break dither stride
 		}
-
-		prev = me;
-		me = next;
 	}
 
 	// commit last
 	COMMIT_STRIDE;
 
 #undef COMMIT_STRIDE
+
+	return numSpans;
 }
 
-void DoublePixels(const color_t* colorx1, color_t* colorx2, int firstRow, int numRows)
+// The EPX rules (Scale2x/Scale3x) only ever output a pixel or one of its left/right neighbors
+// (picking a neighbor that has the same index as the one above/below it).
+// So we make the decisions on palette indices, which are all available, and take the colors
+// from the same converted row. That way, a band never has to wait for another band's output.
+
+static inline void CopyPixel(void* dst, int dstIndex, const void* src, int srcIndex, int bpp)
 {
-	colorx1		= colorx1 + firstRow * VISIBLE_WIDTH;
-	colorx2		= colorx2 + firstRow * VISIBLE_WIDTH * 2 * 2;
+	if (bpp == 2)
+		((uint16_t*) dst)[dstIndex] = ((const uint16_t*) src)[srcIndex];
+	else
+		((uint32_t*) dst)[dstIndex] = ((const uint32_t*) src)[srcIndex];
+}
 
-	for (int y = 0; y < numRows; y++)
+static void Scale2xRow(uint8_t* dst, int pitch, int cell, const void* color,
+					   const uint8_t* above, const uint8_t* row, const uint8_t* below)
+{
+	const int w = VISIBLE_WIDTH;
+	const int bpp = gFramebufferBytesPerPixel;
+	const int pitchBytes = pitch * bpp;
+	uint8_t* top = dst;
+	uint8_t* bottom = dst + cell * pitchBytes;
+
+	for (int x = 0; x < w; x++)
 	{
-		color_t* x2RowStart = colorx2;
+		int xl = x > 0 ? x-1 : x;
+		int xr = x < w-1 ? x+1 : x;
 
-		for (int x = 0; x < VISIBLE_WIDTH; x++)
+		int A = above[x];		//   A
+		int B = row[xr];		// C P B
+		int C = row[xl];		//   D
+		int D = below[x];
+
+		// Which pixel in the converted row each quadrant takes its color from
+		int e0 = (C==A && C!=D && A!=B) ? xl : x;
+		int e1 = (A==B && A!=C && B!=D) ? xr : x;
+		int e2 = (D==C && D!=B && C!=A) ? xl : x;
+		int e3 = (B==D && B!=A && D!=C) ? xr : x;
+
+		for (int i = 0; i < cell; i++)
+		{
+			CopyPixel(top,		(2*x+0)*cell + i, color, e0, bpp);
+			CopyPixel(top,		(2*x+1)*cell + i, color, e1, bpp);
+			CopyPixel(bottom,	(2*x+0)*cell + i, color, e2, bpp);
+			CopyPixel(bottom,	(2*x+1)*cell + i, color, e3, bpp);
+		}
+	}
+
+	for (int i = 1; i < cell; i++)
+	{
+		SDL_memcpy(top + i * pitchBytes, top, pitchBytes);
+		SDL_memcpy(bottom + i * pitchBytes, bottom, pitchBytes);
+	}
+}
+
+static void Scale3xRow(uint8_t* dst, int pitch, const void* color,
+					   const uint8_t* above, const uint8_t* row, const uint8_t* below)
+{
+	const int w = VISIBLE_WIDTH;
+	const int bpp = gFramebufferBytesPerPixel;
+	uint8_t* r0 = dst;
+	uint8_t* r1 = dst + pitch * bpp;
+	uint8_t* r2 = dst + pitch * bpp * 2;
+
+	for (int x = 0; x < w; x++)
+	{
+		int xl = x > 0 ? x-1 : x;
+		int xr = x < w-1 ? x+1 : x;
+
+		int A = above[xl],	B = above[x],	C = above[xr];		// A B C
+		int D = row[xl],	E = row[x],		F = row[xr];		// D E F
+		int G = below[xl],	H = below[x],	I = below[xr];		// G H I
+
+		bool db = D==B && B!=F && D!=H;
+		bool bf = B==F && B!=D && F!=H;
+		bool dh = D==H && D!=B && H!=F;
+		bool hf = H==F && D!=H && B!=F;
+
+		CopyPixel(r0, 3*x+0, color, db ? xl : x, bpp);
+		CopyPixel(r0, 3*x+1, color, (db && E!=C) ? xl : (bf && E!=A) ? xr : x, bpp);		// B, which equals D or F
+		CopyPixel(r0, 3*x+2, color, bf ? xr : x, bpp);
+		CopyPixel(r1, 3*x+0, color, ((db && E!=G) || (dh && E!=A)) ? xl : x, bpp);
+		CopyPixel(r1, 3*x+1, color, x, bpp);
+		CopyPixel(r1, 3*x+2, color, ((bf && E!=I) || (hf && E!=C)) ? xr : x, bpp);
+		CopyPixel(r2, 3*x+0, color, dh ? xl : x, bpp);
+		CopyPixel(r2, 3*x+1, color, (dh && E!=I) ? xl : (hf && E!=G) ? xr : x, bpp);		// H, which equals D or F
+		CopyPixel(r2, 3*x+2, color, hf ? xr : x, bpp);
+	}
+}
+
+// Scales converted rows up by an integer factor (1 to MAX_PRESCALE) for HQ stretch.
+// colorx1 is VISIBLE_WIDTH pixels wide; colorxN is VISIBLE_WIDTH*factor pixels wide.
+// kPrescale_EPX smooths out diagonal edges: Scale2x at 2x, Scale3x at 3x, Scale2x with doubled pixels at 4x.
+void PrescalePixels(const void* colorx1, void* colorxN, int factor, int filter, int firstRow, int numRows)
+{
+	const int w = VISIBLE_WIDTH;
+	const int h = VISIBLE_HEIGHT;
+	const int bpp = gFramebufferBytesPerPixel;
+	const int pitchN = w * factor;
+
+	const uint8_t* srcRow	= (const uint8_t*) colorx1 + firstRow * w * bpp;
+	uint8_t* dstRow			= (uint8_t*) colorxN + firstRow * factor * pitchN * bpp;
+
+	for (int y = firstRow; y < firstRow + numRows; y++)
+	{
+		if (filter == kPrescale_EPX && factor > 1)
 		{
-			color_t pixel = *(colorx1++);
-			*(colorx2++) = pixel;
-			*(colorx2++) = pixel;
+			const uint8_t* row		= gPresentSourceFramebuffer + y * w;
+			const uint8_t* above	= y > 0 ? row - w : row;
+			const uint8_t* below	= y < h-1 ? row + w : row;
+
+			if (factor == 3)
+				Scale3xRow(dstRow, pitchN, srcRow, above, row, below);
+			else
+				Scale2xRow(dstRow, pitchN, factor / 2, srcRow, above, row, below);
+		}
+		else
+		{
+			// Widen the row, then copy it down
+			if (bpp == 2)
+				gFramebufferKernels.replicate16((uint16_t*) dstRow, (const uint16_t*) srcRow, w, factor);
+			else
+				gFramebufferKernels.replicate32((uint32_t*) dstRow, (const uint32_t*) srcRow, w, factor);
+
+			for (int i = 1; i < factor; i++)
+				SDL_memcpy(dstRow + i * pitchN * bpp, dstRow, pitchN * bpp);
 		}
 
-		SDL_memcpy(colorx2, x2RowStart, sizeof(color_t) * VISIBLE_WIDTH * 2);
-		colorx2 += VISIBLE_WIDTH * 2;
+		srcRow += w * bpp;
+		dstRow += factor * pitchN * bpp;
 	}
 }
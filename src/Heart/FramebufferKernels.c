@@ -0,0 +1,842 @@
+// FRAMEBUFFER KERNELS
+// (C) 2025 Iliyas Jorio
+// This file is part of Mighty Mike. https://github.com/jorio/mightymike
+//
+// Vectorized inner loops for the framebuffer converter.
+// The best kernel set for the host CPU is picked once at startup.
+// The scalar kernels are the reference implementation; every vector kernel
+// must produce bit-identical output.
+
+#include <stddef.h>
+
+#include "externs.h"
+#include "misc.h"
+#include "framebufferfilter.h"
+#include "simd.h"
+
+#if defined(_MSC_VER) && !defined(__clang__)
+	#include <intrin.h>
+#endif
+
+FramebufferKernels gFramebufferKernels;
+
+static inline int CountTrailingZeros32(uint32_t bits)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	unsigned long index;
+	_BitScanForward(&index, bits);
+	return (int) index;
+#else
+	return __builtin_ctz(bits);
+#endif
+}
+
+static inline int CountTrailingZeros64(uint64_t bits)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return (int) index;
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+// Average of two RGBA8888 colors, channel by channel, rounding down.
+// Unlike the vector averaging instructions, this doesn't round up.
+static inline uint32_t MixColors32(uint32_t a, uint32_t b)
+{
+	return (a & b) + (((a ^ b) >> 1) & 0x7F7F7F7F);
+}
+
+static inline uint16_t Color32To565(uint32_t c)
+{
+	return	  (((c >> 27) & 0x1F) << 11)
+			| (((c >> 18) & 0x3F) << 5)
+			|  ((c >> 11) & 0x1F);
+}
+
+#pragma mark - Scalar
+
+static void Expand16_Scalar(uint16_t* dst, const uint8_t* src, int count, const GamePalette* palette)
+{
+	for (int i = 0; i < count; i++)
+		dst[i] = palette->finalColors16[src[i]];
+}
+
+static void Expand32_Scalar(uint32_t* dst, const uint8_t* src, int count, const GamePalette* palette)
+{
+	for (int i = 0; i < count; i++)
+		dst[i] = palette->finalColors32[src[i]];
+}
+
+static int FindDither_Scalar(const uint8_t* row, int from, int to)
+{
+	int x = from > 0 ? from : 1;		// pixel 0 has no left-hand neighbor
+
+	for (; x < to; x++)
+	{
+		if (row[x-1] == row[x+1] && row[x] != row[x+1])
+			return x;
+	}
+
+	return to;
+}
+
+static void Blend16_Scalar(uint16_t* dst, const uint8_t* src, int count, const GamePalette* palette)
+{
+	for (int i = 0; i < count; i++)
+		dst[i] = Color32To565(MixColors32(palette->finalColors32[src[i]], palette->finalColors32[src[i+1]]));
+}
+
+static void Blend32_Scalar(uint32_t* dst, const uint8_t* src, int count, const GamePalette* palette)
+{
+	for (int i = 0; i < count; i++)
+		dst[i] = MixColors32(palette->finalColors32[src[i]], palette->finalColors32[src[i+1]]);
+}
+
+static void Replicate16_Scalar(uint16_t* dst, const uint16_t* src, int count, int factor)
+{
+	for (int i = 0; i < count; i++)
+		for (int j = 0; j < factor; j++)
+			*(dst++) = src[i];
+}
+
+static void Replicate32_Scalar(uint32_t* dst, const uint32_t* src, int count, int factor)
+{
+	for (int i = 0; i < count; i++)
+		for (int j = 0; j < factor; j++)
+			*(dst++) = src[i];
+}
+
+static const FramebufferKernels kKernels_Scalar =
+{
+	.name			= "scalar",
+	.expand16		= Expand16_Scalar,
+	.expand32		= Expand32_Scalar,
+	.findDither		= FindDither_Scalar,
+	.blend16		= Blend16_Scalar,
+	.blend32		= Blend32_Scalar,
+	.replicate16	= Replicate16_Scalar,
+	.replicate32	= Replicate32_Scalar,
+};
+
+#pragma mark - SSE2
+
+#if KERNELS_X86
+
+// SSE2 has no gather instruction, so we look up the entries one by one,
+// but assemble them in registers to store a full vector at a time.
+
+TARGET_SSE2 static void Expand16_SSE2(uint16_t* dst, const uint8_t* src, int count, const GamePalette* palette)
+{
+	const uint16_t* pal = palette->finalColors16;
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i v = _mm_setr_epi16(
+				pal[src[i+0]], pal[src[i+1]], pal[src[i+2]], pal[src[i+3]],
+				pal[src[i+4]], pal[src[i+5]], pal[src[i+6]], pal[src[i+7]]);
+		_mm_storeu_si128((__m128i*) (dst + i), v);
+	}
+
+	for (; i < count; i++)
+		dst[i] = pal[src[i]];
+}
+
+TARGET_SSE2 static void Expand32_SSE2(uint32_t* dst, const uint8_t* src, int count, const GamePalette* palette)
+{
+	const int32_t* pal = (const int32_t*) palette->finalColors32;
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i a = _mm_setr_epi32(pal[src[i+0]], pal[src[i+1]], pal[src[i+2]], pal[src[i+3]]);
+		__m128i b = _mm_setr_epi32(pal[src[i+4]], pal[src[i+5]], pal[src[i+6]], pal[src[i+7]]);
+		_mm_storeu_si128((__m128i*) (dst + i), a);
+		_mm_storeu_si128((__m128i*) (dst + i + 4), b);
+	}
+
+	for (; i < count; i++)
+		dst[i] = pal[src[i]];
+}
+
+// Returns a bitmask of the pixels in row[x ... x+15] that sit in the middle of a dither pattern
+TARGET_SSE2 static inline uint32_t DitherMask_SSE2(const uint8_t* row, int x)
+{
+	__m128i prev = _mm_loadu_si128((const __m128i*) (row + x - 1));
+	__m128i me   = _mm_loadu_si128((const __m128i*) (row + x));
+	__m128i next = _mm_loadu_si128((const __m128i*) (row + x + 1));
+	__m128i prevIsNext = _mm_cmpeq_epi8(prev, next);
+	__m128i meIsNext   = _mm_cmpeq_epi8(me, next);
+	return (uint32_t) _mm_movemask_epi8(_mm_andnot_si128(meIsNext, prevIsNext));
+}
+
+TARGET_SSE2 static int FindDither_SSE2(const uint8_t* row, int from, int to)
+{
+	int x = from > 0 ? from : 1;
+
+	for (; x + 16 <= to; x += 16)
+	{
+		uint32_t mask = DitherMask_SSE2(row, x);
+		if (mask)
+			return x + CountTrailingZeros32(mask);
+	}
+
+	return FindDither_Scalar(row, x, to);
+}
+
+TARGET_SSE2 static inline __m128i MixColors32_SSE2(__m128i a, __m128i b)
+{
+	// pavgb rounds up; subtract the carry bit to round down like the scalar version
+	__m128i roundedUp = _mm_avg_epu8(a, b);
+	return _mm_sub_epi8(roundedUp, _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+}
+
+// Converts 4 RGBA8888 colors to 565, leaving the results in the low half of each 32-bit lane
+TARGET_SSE2 static inline __m128i Color32To565_SSE2(__m128i c)
+{
+	__m128i r = _mm_slli_epi32(_mm_srli_epi32(c, 27), 11);
+	__m128i g = _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(c, 18), _mm_set1_epi32(0x3F)), 5);
+	__m128i b = _mm_and_si128(_mm_srli_epi32(c, 11), _mm_set1_epi32(0x1F));
+	return _mm_or_si128(_mm_or_si128(r, g), b);
+}
+
+TARGET_SSE2 static void Blend16_SSE2(uint16_t* dst, const uint8_t* src, int count, const GamePalette* palette)
+{
+	const int32_t* pal = (const int32_t*) palette->finalColors32;
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i l0 = _mm_setr_epi32(pal[src[i+0]], pal[src[i+1]], pal[src[i+2]], pal[src[i+3]]);
+		__m128i l1 = _mm_setr_epi32(pal[src[i+4]], pal[src[i+5]], pal[src[i+6]], pal[src[i+7]]);
+		__m128i r0 = _mm_setr_epi32(pal[src[i+1]], pal[src[i+2]], pal[src[i+3]], pal[src[i+4]]);
+		__m128i r1 = _mm_setr_epi32(pal[src[i+5]], pal[src[i+6]], pal[src[i+7]], pal[src[i+8]]);
+		__m128i c0 = Color32To565_SSE2(MixColors32_SSE2(l0, r0));
+		__m128i c1 = Color32To565_SSE2(MixColors32_SSE2(l1, r1));
+
+		// No unsigned saturating 32->16 pack in SSE2; sign-extend so the signed pack keeps the bits intact
+		c0 = _mm_srai_epi32(_mm_slli_epi32(c0, 16), 16);
+		c1 = _mm_srai_epi32(_mm_slli_epi32(c1, 16), 16);
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_packs_epi32(c0, c1));
+	}
+
+	Blend16_Scalar(dst + i, src + i, count - i, palette);
+}
+
+TARGET_SSE2 static void Blend32_SSE2(uint32_t* dst, const uint8_t* src, int count, const GamePalette* palette)
+{
+	const int32_t* pal = (const int32_t*) palette->finalColors32;
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i l = _mm_setr_epi32(pal[src[i+0]], pal[src[i+1]], pal[src[i+2]], pal[src[i+3]]);
+		__m128i r = _mm_setr_epi32(pal[src[i+1]], pal[src[i+2]], pal[src[i+3]], pal[src[i+4]]);
+		_mm_storeu_si128((__m128i*) (dst + i), MixColors32_SSE2(l, r));
+	}
+
+	Blend32_Scalar(dst + i, src + i, count - i, palette);
+}
+
+// Interleaving a vector with itself doubles each pixel; doing it twice quadruples them.
+// There's no cheap 3-way interleave in SSE2, so 3x goes through the scalar kernel.
+TARGET_SSE2 static void Replicate16_SSE2(uint16_t* dst, const uint16_t* src, int count, int factor)
+{
+	if (factor != 2 && factor != 4)
+	{
+		Replicate16_Scalar(dst, src, count, factor);
+		return;
+	}
+
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i lo = _mm_unpacklo_epi16(v, v);
+		__m128i hi = _mm_unpackhi_epi16(v, v);
+
+		if (factor == 2)
+		{
+			_mm_storeu_si128((__m128i*) (dst + 0), lo);
+			_mm_storeu_si128((__m128i*) (dst + 8), hi);
+			dst += 16;
+		}
+		else
+		{
+			_mm_storeu_si128((__m128i*) (dst +  0), _mm_unpacklo_epi32(lo, lo));
+			_mm_storeu_si128((__m128i*) (dst +  8), _mm_unpackhi_epi32(lo, lo));
+			_mm_storeu_si128((__m128i*) (dst + 16), _mm_unpacklo_epi32(hi, hi));
+			_mm_storeu_si128((__m128i*) (dst + 24), _mm_unpackhi_epi32(hi, hi));
+			dst += 32;
+		}
+	}
+
+	Replicate16_Scalar(dst, src + i, count - i, factor);
+}
+
+TARGET_SSE2 static void Replicate32_SSE2(uint32_t* dst, const uint32_t* src, int count, int factor)
+{
+	if (factor != 2 && factor != 4)
+	{
+		Replicate32_Scalar(dst, src, count, factor);
+		return;
+	}
+
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i lo = _mm_unpacklo_epi32(v, v);
+		__m128i hi = _mm_unpackhi_epi32(v, v);
+
+		if (factor == 2)
+		{
+			_mm_storeu_si128((__m128i*) (dst + 0), lo);
+			_mm_storeu_si128((__m128i*) (dst + 4), hi);
+			dst += 8;
+		}
+		else
+		{
+			_mm_storeu_si128((__m128i*) (dst +  0), _mm_unpacklo_epi64(lo, lo));
+			_mm_storeu_si128((__m128i*) (dst +  4), _mm_unpackhi_epi64(lo, lo));
+			_mm_storeu_si128((__m128i*) (dst +  8), _mm_unpacklo_epi64(hi, hi));
+			_mm_storeu_si128((__m128i*) (dst + 12), _mm_unpackhi_epi64(hi, hi));
+			dst += 16;
+		}
+	}
+
+	Replicate32_Scalar(dst, src + i, count - i, factor);
+}
+
+static const FramebufferKernels kKernels_SSE2 =
+{
+	.name			= "sse2",
+	.expand16		= Expand16_SSE2,
+	.expand32		= Expand32_SSE2,
+	.findDither		= FindDither_SSE2,
+	.blend16		= Blend16_SSE2,
+	.blend32		= Blend32_SSE2,
+	.replicate16	= Replicate16_SSE2,
+	.replicate32	= Replicate32_SSE2,
+};
+
+#pragma mark - AVX2
+
+// The 16-bit kernel gathers 32-bit words at 2-byte strides and keeps the low half.
+// Entry 255 therefore reads 2 bytes past the end of finalColors16, which is fine
+// as long as something else in GamePalette follows it.
+_Static_assert(offsetof(GamePalette, finalColors16) + sizeof(((GamePalette*)0)->finalColors16) + 2 <= sizeof(GamePalette),
+			   "AVX2 16-bit gather needs 2 bytes of slack after finalColors16");
+
+TARGET_AVX2 static void Expand16_AVX2(uint16_t* dst, const uint8_t* src, int count, const GamePalette* palette)
+{
+	const int* pal = (const int*) palette->finalColors16;
+	const __m256i lowHalf = _mm256_set1_epi32(0xFFFF);
+	int i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i indices = _mm_loadu_si128((const __m128i*) (src + i));
+		__m256i a = _mm256_i32gather_epi32(pal, _mm256_cvtepu8_epi32(indices), 2);
+		__m256i b = _mm256_i32gather_epi32(pal, _mm256_cvtepu8_epi32(_mm_srli_si128(indices, 8)), 2);
+		a = _mm256_and_si256(a, lowHalf);
+		b = _mm256_and_si256(b, lowHalf);
+
+		// packus interleaves 128-bit lanes (a0 b0 a1 b1); put them back in order
+		__m256i packed = _mm256_packus_epi32(a, b);
+		packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i*) (dst + i), packed);
+	}
+
+	for (; i < count; i++)
+		dst[i] = palette->finalColors16[src[i]];
+}
+
+TARGET_AVX2 static void Expand32_AVX2(uint32_t* dst, const uint8_t* src, int count, const GamePalette* palette)
+{
+	const int* pal = (const int*) palette->finalColors32;
+	int i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i indices = _mm_loadu_si128((const __m128i*) (src + i));
+		__m256i a = _mm256_i32gather_epi32(pal, _mm256_cvtepu8_epi32(indices), 4);
+		__m256i b = _mm256_i32gather_epi32(pal, _mm256_cvtepu8_epi32(_mm_srli_si128(indices, 8)), 4);
+		_mm256_storeu_si256((__m256i*) (dst + i), a);
+		_mm256_storeu_si256((__m256i*) (dst + i + 8), b);
+	}
+
+	for (; i < count; i++)
+		dst[i] = palette->finalColors32[src[i]];
+}
+
+TARGET_AVX2 static int FindDither_AVX2(const uint8_t* row, int from, int to)
+{
+	int x = from > 0 ? from : 1;
+
+	for (; x + 32 <= to; x += 32)
+	{
+		__m256i prev = _mm256_loadu_si256((const __m256i*) (row + x - 1));
+		__m256i me   = _mm256_loadu_si256((const __m256i*) (row + x));
+		__m256i next = _mm256_loadu_si256((const __m256i*) (row + x + 1));
+		__m256i prevIsNext = _mm256_cmpeq_epi8(prev, next);
+		__m256i meIsNext   = _mm256_cmpeq_epi8(me, next);
+		uint32_t mask = (uint32_t) _mm256_movemask_epi8(_mm256_andnot_si256(meIsNext, prevIsNext));
+		if (mask)
+			return x + CountTrailingZeros32(mask);
+	}
+
+	return FindDither_SSE2(row, x, to);
+}
+
+// Looks up 8 pixels and their right-hand neighbors and mixes them
+TARGET_AVX2 static inline __m256i MixNeighbors8_AVX2(const uint8_t* src, const int* pal)
+{
+	__m256i l = _mm256_i32gather_epi32(pal, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) (src))), 4);
+	__m256i r = _mm256_i32gather_epi32(pal, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) (src + 1))), 4);
+	__m256i roundedUp = _mm256_avg_epu8(l, r);
+	return _mm256_sub_epi8(roundedUp, _mm256_and_si256(_mm256_xor_si256(l, r), _mm256_set1_epi8(1)));
+}
+
+TARGET_AVX2 static void Blend16_AVX2(uint16_t* dst, const uint8_t* src, int count, const GamePalette* palette)
+{
+	const int* pal = (const int*) palette->finalColors32;
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i c = MixNeighbors8_AVX2(src + i, pal);
+		__m256i r = _mm256_slli_epi32(_mm256_srli_epi32(c, 27), 11);
+		__m256i g = _mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(c, 18), _mm256_set1_epi32(0x3F)), 5);
+		__m256i b = _mm256_and_si256(_mm256_srli_epi32(c, 11), _mm256_set1_epi32(0x1F));
+		c = _mm256_or_si256(_mm256_or_si256(r, g), b);
+
+		__m256i packed = _mm256_packus_epi32(c, c);
+		packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+		_mm_storeu_si128((__m128i*) (dst + i), _mm256_castsi256_si128(packed));
+	}
+
+	Blend16_Scalar(dst + i, src + i, count - i, palette);
+}
+
+TARGET_AVX2 static void Blend32_AVX2(uint32_t* dst, const uint8_t* src, int count, const GamePalette* palette)
+{
+	const int* pal = (const int*) palette->finalColors32;
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm256_storeu_si256((__m256i*) (dst + i), MixNeighbors8_AVX2(src + i, pal));
+	}
+
+	Blend32_Scalar(dst + i, src + i, count - i, palette);
+}
+
+// AVX2 unpacks work within 128-bit lanes, which would need extra permutes
+// to replicate pixels in order. This is bound by stores anyway, so stick to SSE2.
+static const FramebufferKernels kKernels_AVX2 =
+{
+	.name			= "avx2",
+	.expand16		= Expand16_AVX2,
+	.expand32		= Expand32_AVX2,
+	.findDither		= FindDither_AVX2,
+	.blend16		= Blend16_AVX2,
+	.blend32		= Blend32_AVX2,
+	.replicate16	= Replicate16_SSE2,
+	.replicate32	= Replicate32_SSE2,
+};
+
+#endif // KERNELS_X86
+
+#pragma mark - NEON
+
+#if KERNELS_NEON
+
+// NEON can look up 16 bytes at a time in a 64-byte table (TBL/TBX with 4 registers).
+// We split the palette into byte planes and cover the 256 entries with 4 such tables
+// per plane, then interleave the planes back into pixels with VST2/VST4.
+
+typedef struct { uint8x16x4_t quarter[4]; } PalettePlane;
+
+static inline PalettePlane LoadPalettePlane(const uint8_t* plane)
+{
+	PalettePlane p;
+	for (int q = 0; q < 4; q++)
+	{
+		p.quarter[q].val[0] = vld1q_u8(plane + 64*q + 0);
+		p.quarter[q].val[1] = vld1q_u8(plane + 64*q + 16);
+		p.quarter[q].val[2] = vld1q_u8(plane + 64*q + 32);
+		p.quarter[q].val[3] = vld1q_u8(plane + 64*q + 48);
+	}
+	return p;
+}
+
+static inline uint8x16_t LookUpPlane(const PalettePlane* p, uint8x16_t indices)
+{
+	// TBL yields 0 for out-of-range indices and TBX leaves them untouched,
+	// so each quarter only fills in the lanes whose index falls in its range.
+	const uint8x16_t sixtyFour = vdupq_n_u8(64);
+	uint8x16_t result = vqtbl4q_u8(p->quarter[0], indices);
+	indices = vsubq_u8(indices, sixtyFour);
+	result = vqtbx4q_u8(result, p->quarter[1], indices);
+	indices = vsubq_u8(indices, sixtyFour);
+	result = vqtbx4q_u8(result, p->quarter[2], indices);
+	indices = vsubq_u8(indices, sixtyFour);
+	result = vqtbx4q_u8(result, p->quarter[3], indices);
+	return result;
+}
+
+static void Expand16_NEON(uint16_t* dst, const uint8_t* src, int count, const GamePalette* palette)
+{
+	uint8_t planes[2][256];
+	for (int c = 0; c < 256; c++)
+	{
+		planes[0][c] = (uint8_t) (palette->finalColors16[c]);
+		planes[1][c] = (uint8_t) (palette->finalColors16[c] >> 8);
+	}
+
+	const PalettePlane lo = LoadPalettePlane(planes[0]);
+	const PalettePlane hi = LoadPalettePlane(planes[1]);
+	int i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		uint8x16_t indices = vld1q_u8(src + i);
+		uint8x16x2_t pixels;
+		pixels.val[0] = LookUpPlane(&lo, indices);
+		pixels.val[1] = LookUpPlane(&hi, indices);
+		vst2q_u8((uint8_t*) (dst + i), pixels);
+	}
+
+	for (; i < count; i++)
+		dst[i] = palette->finalColors16[src[i]];
+}
+
+static void Expand32_NEON(uint32_t* dst, const uint8_t* src, int count, const GamePalette* palette)
+{
+	uint8_t planes[4][256];
+	for (int c = 0; c < 256; c++)
+	{
+		uint32_t color = palette->finalColors32[c];
+		planes[0][c] = (uint8_t) (color);
+		planes[1][c] = (uint8_t) (color >> 8);
+		planes[2][c] = (uint8_t) (color >> 16);
+		planes[3][c] = (uint8_t) (color >> 24);
+	}
+
+	int i = 0;
+
+	if (count >= 16)
+	{
+		const PalettePlane p0 = LoadPalettePlane(planes[0]);
+		const PalettePlane p1 = LoadPalettePlane(planes[1]);
+		const PalettePlane p2 = LoadPalettePlane(planes[2]);
+		const PalettePlane p3 = LoadPalettePlane(planes[3]);
+
+		for (; i + 16 <= count; i += 16)
+		{
+			uint8x16_t indices = vld1q_u8(src + i);
+			uint8x16x4_t pixels;
+			pixels.val[0] = LookUpPlane(&p0, indices);
+			pixels.val[1] = LookUpPlane(&p1, indices);
+			pixels.val[2] = LookUpPlane(&p2, indices);
+			pixels.val[3] = LookUpPlane(&p3, indices);
+			vst4q_u8((uint8_t*) (dst + i), pixels);
+		}
+	}
+
+	for (; i < count; i++)
+		dst[i] = palette->finalColors32[src[i]];
+}
+
+static int FindDither_NEON(const uint8_t* row, int from, int to)
+{
+	int x = from > 0 ? from : 1;
+
+	for (; x + 16 <= to; x += 16)
+	{
+		uint8x16_t prev = vld1q_u8(row + x - 1);
+		uint8x16_t me   = vld1q_u8(row + x);
+		uint8x16_t next = vld1q_u8(row + x + 1);
+		uint8x16_t hits = vbicq_u8(vceqq_u8(prev, next), vceqq_u8(me, next));
+
+		// No movemask on NEON: narrow each byte to a nibble to get a 64-bit mask
+		uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(hits), 4);
+		uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+		if (mask)
+			return x + CountTrailingZeros64(mask) / 4;
+	}
+
+	return FindDither_Scalar(row, x, to);
+}
+
+// Looks up 4 pixels and their right-hand neighbors and mixes them (vhadd rounds down)
+static inline uint32x4_t MixNeighbors4_NEON(const uint8_t* src, const uint32_t* pal)
+{
+	const uint32_t l[4] = { pal[src[0]], pal[src[1]], pal[src[2]], pal[src[3]] };
+	const uint32_t r[4] = { pal[src[1]], pal[src[2]], pal[src[3]], pal[src[4]] };
+	uint8x16_t mix = vhaddq_u8(vreinterpretq_u8_u32(vld1q_u32(l)), vreinterpretq_u8_u32(vld1q_u32(r)));
+	return vreinterpretq_u32_u8(mix);
+}
+
+static void Blend16_NEON(uint16_t* dst, const uint8_t* src, int count, const GamePalette* palette)
+{
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		uint32x4_t c = MixNeighbors4_NEON(src + i, palette->finalColors32);
+		uint32x4_t r = vshlq_n_u32(vshrq_n_u32(c, 27), 11);
+		uint32x4_t g = vshlq_n_u32(vandq_u32(vshrq_n_u32(c, 18), vdupq_n_u32(0x3F)), 5);
+		uint32x4_t b = vandq_u32(vshrq_n_u32(c, 11), vdupq_n_u32(0x1F));
+		vst1_u16(dst + i, vmovn_u32(vorrq_u32(vorrq_u32(r, g), b)));
+	}
+
+	Blend16_Scalar(dst + i, src + i, count - i, palette);
+}
+
+static void Blend32_NEON(uint32_t* dst, const uint8_t* src, int count, const GamePalette* palette)
+{
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		vst1q_u32(dst + i, MixNeighbors4_NEON(src + i, palette->finalColors32));
+	}
+
+	Blend32_Scalar(dst + i, src + i, count - i, palette);
+}
+
+// Interleaved stores of the same vector replicate each pixel 2, 3 or 4 times
+static void Replicate16_NEON(uint16_t* dst, const uint16_t* src, int count, int factor)
+{
+	int i = 0;
+
+	switch (factor)
+	{
+		case 2:
+			for (; i + 8 <= count; i += 8, dst += 16)
+			{
+				uint16x8_t v = vld1q_u16(src + i);
+				vst2q_u16(dst, (uint16x8x2_t) {{ v, v }});
+			}
+			break;
+
+		case 3:
+			for (; i + 8 <= count; i += 8, dst += 24)
+			{
+				uint16x8_t v = vld1q_u16(src + i);
+				vst3q_u16(dst, (uint16x8x3_t) {{ v, v, v }});
+			}
+			break;
+
+		case 4:
+			for (; i + 8 <= count; i += 8, dst += 32)
+			{
+				uint16x8_t v = vld1q_u16(src + i);
+				vst4q_u16(dst, (uint16x8x4_t) {{ v, v, v, v }});
+			}
+			break;
+	}
+
+	Replicate16_Scalar(dst, src + i, count - i, factor);
+}
+
+static void Replicate32_NEON(uint32_t* dst, const uint32_t* src, int count, int factor)
+{
+	int i = 0;
+
+	switch (factor)
+	{
+		case 2:
+			for (; i + 4 <= count; i += 4, dst += 8)
+			{
+				uint32x4_t v = vld1q_u32(src + i);
+				vst2q_u32(dst, (uint32x4x2_t) {{ v, v }});
+			}
+			break;
+
+		case 3:
+			for (; i + 4 <= count; i += 4, dst += 12)
+			{
+				uint32x4_t v = vld1q_u32(src + i);
+				vst3q_u32(dst, (uint32x4x3_t) {{ v, v, v }});
+			}
+			break;
+
+		case 4:
+			for (; i + 4 <= count; i += 4, dst += 16)
+			{
+				uint32x4_t v = vld1q_u32(src + i);
+				vst4q_u32(dst, (uint32x4x4_t) {{ v, v, v, v }});
+			}
+			break;
+	}
+
+	Replicate32_Scalar(dst, src + i, count - i, factor);
+}
+
+static const FramebufferKernels kKernels_NEON =
+{
+	.name			= "neon",
+	.expand16		= Expand16_NEON,
+	.expand32		= Expand32_NEON,
+	.findDither		= FindDither_NEON,
+	.blend16		= Blend16_NEON,
+	.blend32		= Blend32_NEON,
+	.replicate16	= Replicate16_NEON,
+	.replicate32	= Replicate32_NEON,
+};
+
+#endif // KERNELS_NEON
+
+#pragma mark - Self-test
+
+#if _DEBUG
+
+// Runs a kernel set against the scalar reference on random data.
+// Covers odd lengths and misaligned buffers so that the vector tails get exercised.
+static void SelfTestKernels(const FramebufferKernels* kernels)
+{
+	enum { kMaxCount = 1100, kSlack = 16 };
+
+	static GamePalette palette;
+	static uint8_t src[kMaxCount + kSlack];
+	static uint16_t ref16[kMaxCount + kSlack];
+	static uint16_t out16[kMaxCount + kSlack];
+	static uint32_t ref32[kMaxCount + kSlack];
+	static uint32_t out32[kMaxCount + kSlack];
+
+	uint32_t seed = 0x4D696B65;
+
+	for (int i = 0; i < 256; i++)
+	{
+		palette.finalColors32[i] = SelfTestRandom(&seed) << 8 | 0xFF;
+		palette.finalColors16[i] = (uint16_t) SelfTestRandom(&seed);
+	}
+
+	for (int i = 0; i < kMaxCount + kSlack; i++)
+	{
+		src[i] = (uint8_t) SelfTestRandom(&seed);
+	}
+
+	// Make sure the first and last palette entries get looked up
+	src[0] = 0;
+	src[1] = 255;
+
+	for (int count = 0; count <= kMaxCount; count += (count < 80 ? 1 : 173))
+	{
+		int offset = count % kSlack;
+
+		SDL_memset(out16, 0xAB, sizeof(out16));
+		SDL_memset(out32, 0xAB, sizeof(out32));
+		SDL_memcpy(ref16, out16, sizeof(out16));
+		SDL_memcpy(ref32, out32, sizeof(out32));
+
+		Expand16_Scalar(ref16 + offset, src + offset, count, &palette);
+		Expand32_Scalar(ref32 + offset, src + offset, count, &palette);
+		kernels->expand16(out16 + offset, src + offset, count, &palette);
+		kernels->expand32(out32 + offset, src + offset, count, &palette);
+
+		GAME_ASSERT_MESSAGE(0 == SDL_memcmp(ref16, out16, sizeof(out16)), kernels->name);
+		GAME_ASSERT_MESSAGE(0 == SDL_memcmp(ref32, out32, sizeof(out32)), kernels->name);
+
+		// Blend kernels read one pixel past the end
+		if (count + 1 + offset > kMaxCount + kSlack)
+			continue;
+
+		Blend16_Scalar(ref16 + offset, src + offset, count, &palette);
+		Blend32_Scalar(ref32 + offset, src + offset, count, &palette);
+		kernels->blend16(out16 + offset, src + offset, count, &palette);
+		kernels->blend32(out32 + offset, src + offset, count, &palette);
+
+		GAME_ASSERT_MESSAGE(0 == SDL_memcmp(ref16, out16, sizeof(out16)), kernels->name);
+		GAME_ASSERT_MESSAGE(0 == SDL_memcmp(ref32, out32, sizeof(out32)), kernels->name);
+	}
+
+	// Pixel replication, from the expanded colors above
+	static uint16_t rep16Ref[(kMaxCount + kSlack) * MAX_PRESCALE];
+	static uint16_t rep16Out[(kMaxCount + kSlack) * MAX_PRESCALE];
+	static uint32_t rep32Ref[(kMaxCount + kSlack) * MAX_PRESCALE];
+	static uint32_t rep32Out[(kMaxCount + kSlack) * MAX_PRESCALE];
+
+	for (int factor = 1; factor <= MAX_PRESCALE; factor++)
+	{
+		for (int count = 0; count <= kMaxCount; count += (count < 80 ? 1 : 173))
+		{
+			int offset = count % kSlack;
+
+			SDL_memset(rep16Ref, 0xAB, sizeof(rep16Ref));
+			SDL_memset(rep32Ref, 0xAB, sizeof(rep32Ref));
+			SDL_memcpy(rep16Out, rep16Ref, sizeof(rep16Ref));
+			SDL_memcpy(rep32Out, rep32Ref, sizeof(rep32Ref));
+
+			Replicate16_Scalar(rep16Ref + offset, ref16 + offset, count, factor);
+			Replicate32_Scalar(rep32Ref + offset, ref32 + offset, count, factor);
+			kernels->replicate16(rep16Out + offset, ref16 + offset, count, factor);
+			kernels->replicate32(rep32Out + offset, ref32 + offset, count, factor);
+
+			GAME_ASSERT_MESSAGE(0 == SDL_memcmp(rep16Ref, rep16Out, sizeof(rep16Ref)), kernels->name);
+			GAME_ASSERT_MESSAGE(0 == SDL_memcmp(rep32Ref, rep32Out, sizeof(rep32Ref)), kernels->name);
+		}
+	}
+
+	// Dither detection: use a tiny alphabet so that dither patterns actually occur,
+	// and sprinkle in long solid runs so the vector loops get to skip ahead.
+	for (int i = 0; i < kMaxCount + kSlack; i++)
+	{
+		src[i] = (i / 97) % 3 == 0 ? 7 : (uint8_t) (SelfTestRandom(&seed) % 3);
+	}
+
+	for (int to = 1; to < kMaxCount; to += 37)
+	{
+		for (int from = 0; from < to; )
+		{
+			int expected = FindDither_Scalar(src, from, to);
+			GAME_ASSERT_MESSAGE(expected == kernels->findDither(src, from, to), kernels->name);
+			from = expected + 1;
+		}
+	}
+}
+
+#endif // _DEBUG
+
+#pragma mark - Init
+
+void InitFramebufferKernels(void)
+{
+	gFramebufferKernels = kKernels_Scalar;
+
+#if KERNELS_X86
+	if (SDL_HasSSE2())
+	{
+#if _DEBUG
+		SelfTestKernels(&kKernels_SSE2);
+#endif
+		gFramebufferKernels = kKernels_SSE2;
+	}
+
+	if (SDL_HasAVX2())
+	{
+#if _DEBUG
+		SelfTestKernels(&kKernels_AVX2);
+#endif
+		gFramebufferKernels = kKernels_AVX2;
+	}
+#elif KERNELS_NEON
+	if (SDL_HasNEON())
+	{
+#if _DEBUG
+		SelfTestKernels(&kKernels_NEON);
+#endif
+		gFramebufferKernels = kKernels_NEON;
+	}
+#endif
+
+	SDL_Log("Framebuffer kernels: %s", gFramebufferKernels.name);
+}
@@ -0,0 +1,535 @@
+// GOLDEN-FRAME HARNESS
+// (C) 2025 Iliyas Jorio
+// This file is part of Mighty Mike. https://github.com/jorio/mightymike
+//
+// Plays an area with scripted input for a fixed number of frames, hashes every
+// frame (indexed framebuffer + palette, and the converted image when headless),
+// and times each stage of the frame. Compare the hashes against a golden file
+// to check that an optimization is bit-exact, and read the timings to see if it paid off.
+//
+// Usage (best combined with MIGHTYMIKE_RENDER_DRIVER=null):
+//   MIGHTYMIKE_HARNESS=<script>          run the harness instead of the game
+//   MIGHTYMIKE_HARNESS_GOLDEN=<file>     compare frame hashes against this file
+//   MIGHTYMIKE_HARNESS_RECORD=<file>     write frame hashes to this file (to make a new golden file)
+//   MIGHTYMIKE_HARNESS_CSV=<file>        write per-frame hashes and stage timings
+//
+// Script format, one command per line ('#' starts a comment):
+//   scene 0                  scene number (0-4)
+//   area 0                   area number (0-2)
+//   seed 1234                random seed
+//   frames 600               number of frames to run
+//   0-59 right               hold needs during frames 0 through 59
+//   60 attack up             hold needs during frame 60 only
+// Needs: up down left right attack nextweapon prevweapon radar
+//
+// The converted-image hash depends on the color depth the driver picks for the
+// colorDepth pref (auto, the default, is 32-bit on the null driver), so golden
+// files for it are only comparable between runs that end up at the same depth.
+// Harness runs use the default prefs, so results don't depend on the user's settings.
+
+#include <SDL3/SDL.h>
+
+#include "myglobals.h"
+#include "externs.h"
+#include "misc.h"
+#include "main.h"
+#include "window.h"
+#include "renderdrivers.h"
+#include "harness.h"
+
+#define kHarnessHint			"MIGHTYMIKE_HARNESS"
+#define kHarnessGoldenHint		"MIGHTYMIKE_HARNESS_GOLDEN"
+#define kHarnessRecordHint		"MIGHTYMIKE_HARNESS_RECORD"
+#define kHarnessCSVHint			"MIGHTYMIKE_HARNESS_CSV"
+
+#define MAX_SCRIPT_EVENTS		512
+#define MAX_HARNESS_FRAMES		(60*60*60)		// an hour's worth
+
+typedef struct
+{
+	int			firstFrame;
+	int			lastFrame;
+	uint32_t	needMask;
+} ScriptEvent;
+
+typedef struct
+{
+	uint64_t	indexHash;			// indexed framebuffer + palette
+	uint64_t	colorHash;			// converted image (0 if not available)
+	uint64_t	stageTicks[NUM_HARNESS_STAGES];
+} HarnessFrame;
+
+static const char* kStageNames[NUM_HARNESS_STAGES] =
+{
+	[kHarnessStage_Input]		= "input",
+	[kHarnessStage_Move]		= "move",
+	[kHarnessStage_Scroll]		= "scroll",
+	[kHarnessStage_Sprites]		= "sprites",
+	[kHarnessStage_Playfield]	= "playfield",
+	[kHarnessStage_Infobar]		= "infobar",
+	[kHarnessStage_Erase]		= "erase",
+	[kHarnessStage_Present]		= "present",
+};
+
+static const struct { const char* name; int need; } kScriptNeeds[] =
+{
+	{ "up",				kNeed_Up },
+	{ "down",			kNeed_Down },
+	{ "left",			kNeed_Left },
+	{ "right",			kNeed_Right },
+	{ "attack",			kNeed_Attack },
+	{ "nextweapon",		kNeed_NextWeapon },
+	{ "prevweapon",		kNeed_PrevWeapon },
+	{ "radar",			kNeed_Radar },
+};
+
+bool gHarnessActive = false;
+
+static bool				gHarnessPlaying = false;		// scripted input only kicks in once the area is running
+static int				gHarnessExitCode = 0;
+
+static int				gScriptScene = 0;
+static int				gScriptArea = 0;
+static uint32_t			gScriptSeed = 1234;
+static int				gScriptNumFrames = 600;
+static int				gNumScriptEvents = 0;
+static ScriptEvent		gScriptEvents[MAX_SCRIPT_EVENTS];
+
+static HarnessFrame*	gHarnessFrames = NULL;
+static int				gFrameNum = 0;
+static int				gCurrentStage = -1;
+static uint64_t			gStageStartTicks = 0;
+
+#pragma mark - Hashing
+
+#define kFNVOffsetBasis		0xcbf29ce484222325ull
+#define kFNVPrime			0x00000100000001b3ull
+
+static uint64_t FNV1a(uint64_t hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = (const uint8_t*) data;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= kFNVPrime;
+	}
+
+	return hash;
+}
+
+#pragma mark - Script
+
+static int ParseNeed(const char* word)
+{
+	for (int i = 0; i < (int) SDL_arraysize(kScriptNeeds); i++)
+	{
+		if (0 == SDL_strcasecmp(word, kScriptNeeds[i].name))
+			return kScriptNeeds[i].need;
+	}
+	return -1;
+}
+
+static void ParseScriptLine(char* line, int lineNum)
+{
+	char errorBuf[256];
+	char* saveptr = NULL;
+
+	char* comment = SDL_strchr(line, '#');
+	if (comment)
+		*comment = '\0';
+
+	const char* command = SDL_strtok_r(line, " \t\r", &saveptr);
+	if (!command)
+		return;
+
+	const char* arg = SDL_strtok_r(NULL, " \t\r", &saveptr);
+
+	if (0 == SDL_strcmp(command, "scene") && arg)
+	{
+		gScriptScene = SDL_atoi(arg);
+	}
+	else if (0 == SDL_strcmp(command, "area") && arg)
+	{
+		gScriptArea = SDL_atoi(arg);
+	}
+	else if (0 == SDL_strcmp(command, "seed") && arg)
+	{
+		gScriptSeed = (uint32_t) SDL_strtoul(arg, NULL, 0);
+	}
+	else if (0 == SDL_strcmp(command, "frames") && arg)
+	{
+		gScriptNumFrames = SDL_clamp(SDL_atoi(arg), 1, MAX_HARNESS_FRAMES);
+	}
+	else if (SDL_isdigit(command[0]))
+	{
+		if (gNumScriptEvents >= MAX_SCRIPT_EVENTS)
+		{
+			DoFatalAlert("Harness script: too many input events");
+		}
+
+		ScriptEvent* event = &gScriptEvents[gNumScriptEvents++];
+
+		char* dash = NULL;
+		event->firstFrame = (int) SDL_strtol(command, &dash, 10);
+		event->lastFrame = (dash && *dash == '-') ? (int) SDL_strtol(dash + 1, NULL, 10) : event->firstFrame;
+		event->needMask = 0;
+
+		for (; arg; arg = SDL_strtok_r(NULL, " \t\r", &saveptr))
+		{
+			int need = ParseNeed(arg);
+			if (need < 0)
+			{
+				SDL_snprintf(errorBuf, sizeof(errorBuf), "Harness script line %d: unknown need \"%s\"", lineNum, arg);
+				DoFatalAlert(errorBuf);
+			}
+			event->needMask |= 1u << need;
+		}
+	}
+	else
+	{
+		SDL_snprintf(errorBuf, sizeof(errorBuf), "Harness script line %d: can't parse \"%s\"", lineNum, command);
+		DoFatalAlert(errorBuf);
+	}
+}
+
+static void LoadScript(const char* path)
+{
+	size_t size = 0;
+	char* text = (char*) SDL_LoadFile(path, &size);
+	if (!text)
+	{
+		DoFatalAlert2("Couldn't load harness script", path);
+	}
+
+	int lineNum = 1;
+	for (char* line = text; line; lineNum++)
+	{
+		char* next = SDL_strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+
+		ParseScriptLine(line, lineNum);
+		line = next;
+	}
+
+	SDL_free(text);
+}
+
+bool GetScriptedNeedState(int needID)
+{
+	if (!gHarnessPlaying)
+		return false;
+
+	for (int i = 0; i < gNumScriptEvents; i++)
+	{
+		const ScriptEvent* event = &gScriptEvents[i];
+
+		if (gFrameNum >= event->firstFrame
+			&& gFrameNum <= event->lastFrame
+			&& (event->needMask & (1u << needID)))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+#pragma mark - Golden files
+
+// Returns the number of frames in the file. Frames missing from the file have both hashes set to 0.
+static int LoadGoldenHashes(const char* path, uint64_t* indexHashes, uint64_t* colorHashes)
+{
+	size_t size = 0;
+	char* text = (char*) SDL_LoadFile(path, &size);
+	if (!text)
+	{
+		DoFatalAlert2("Couldn't load golden hashes", path);
+	}
+
+	int numRead = 0;
+	char* saveptr = NULL;
+	for (char* line = SDL_strtok_r(text, "\n", &saveptr); line; line = SDL_strtok_r(NULL, "\n", &saveptr))
+	{
+		if (line[0] == '#')
+			continue;
+
+		char* end = NULL;
+		long frame = SDL_strtol(line, &end, 10);
+		if (end == line || frame < 0)
+			continue;
+
+		numRead++;
+
+		if (frame < gScriptNumFrames)
+		{
+			indexHashes[frame] = SDL_strtoull(end, &end, 16);
+			colorHashes[frame] = SDL_strtoull(end, &end, 16);
+		}
+	}
+
+	SDL_free(text);
+	return numRead;
+}
+
+static void WriteHashes(const char* path)
+{
+	SDL_IOStream* file = SDL_IOFromFile(path, "wb");
+	if (!file)
+	{
+		DoAlert("Couldn't write golden hashes");
+		return;
+	}
+
+	SDL_IOprintf(file, "# frame indexhash colorhash (%s)\n", gRendererName);
+	for (int i = 0; i < gFrameNum; i++)
+	{
+		SDL_IOprintf(file, "%d %016" SDL_PRIx64 " %016" SDL_PRIx64 "\n", i, gHarnessFrames[i].indexHash, gHarnessFrames[i].colorHash);
+	}
+
+	SDL_CloseIO(file);
+	SDL_Log("Harness: wrote %s", path);
+}
+
+static void WriteCSV(const char* path)
+{
+	SDL_IOStream* file = SDL_IOFromFile(path, "wb");
+	if (!file)
+	{
+		DoAlert("Couldn't write harness CSV");
+		return;
+	}
+
+	double msPerTick = 1000.0 / (double) SDL_GetPerformanceFrequency();
+
+	SDL_IOprintf(file, "frame,indexhash,colorhash");
+	for (int s = 0; s < NUM_HARNESS_STAGES; s++)
+		SDL_IOprintf(file, ",%s_ms", kStageNames[s]);
+	SDL_IOprintf(file, "\n");
+
+	for (int i = 0; i < gFrameNum; i++)
+	{
+		SDL_IOprintf(file, "%d,%016" SDL_PRIx64 ",%016" SDL_PRIx64, i, gHarnessFrames[i].indexHash, gHarnessFrames[i].colorHash);
+		for (int s = 0; s < NUM_HARNESS_STAGES; s++)
+			SDL_IOprintf(file, ",%.4f", gHarnessFrames[i].stageTicks[s] * msPerTick);
+		SDL_IOprintf(file, "\n");
+	}
+
+	SDL_CloseIO(file);
+	SDL_Log("Harness: wrote %s", path);
+}
+
+#pragma mark - Report
+
+static void CompareAgainstGolden(const char* path)
+{
+	uint64_t* goldenIndex = (uint64_t*) NewPtrClear(sizeof(uint64_t) * gScriptNumFrames);
+	uint64_t* goldenColor = (uint64_t*) NewPtrClear(sizeof(uint64_t) * gScriptNumFrames);
+	GAME_ASSERT(goldenIndex && goldenColor);
+
+	int numGolden = LoadGoldenHashes(path, goldenIndex, goldenColor);
+
+	int indexMismatches = 0;
+	int colorMismatches = 0;
+	int firstMismatch = -1;
+
+	for (int i = 0; i < gFrameNum; i++)
+	{
+		bool bad = false;
+
+		if (goldenIndex[i] != gHarnessFrames[i].indexHash)
+		{
+			indexMismatches++;
+			bad = true;
+		}
+
+		// Only compare converted images if both sides have them
+		if (goldenColor[i] && gHarnessFrames[i].colorHash && goldenColor[i] != gHarnessFrames[i].colorHash)
+		{
+			colorMismatches++;
+			bad = true;
+		}
+
+		if (bad && firstMismatch < 0)
+		{
+			firstMismatch = i;
+		}
+	}
+
+	if (numGolden != gFrameNum)
+	{
+		SDL_Log("Harness: golden file has %d frames, we ran %d", numGolden, gFrameNum);
+		gHarnessExitCode = 1;
+	}
+
+	if (firstMismatch >= 0)
+	{
+		SDL_Log("Harness: FAIL -- %d indexed and %d converted frames differ from golden; first bad frame: %d",
+				indexMismatches, colorMismatches, firstMismatch);
+		gHarnessExitCode = 1;
+	}
+	else
+	{
+		SDL_Log("Harness: PASS -- all %d frames match golden", gFrameNum);
+	}
+
+	DisposePtr((Ptr) goldenIndex);
+	DisposePtr((Ptr) goldenColor);
+}
+
+static void PrintTimings(void)
+{
+	double msPerTick = 1000.0 / (double) SDL_GetPerformanceFrequency();
+	double totalMean = 0;
+
+	SDL_Log("Harness: %d frames (%s, %d workers)", gFrameNum, gRendererName, gNumThreads);
+	SDL_Log("%-10s %9s %9s %9s", "stage", "mean ms", "min ms", "max ms");
+
+	for (int s = 0; s < NUM_HARNESS_STAGES; s++)
+	{
+		uint64_t sum = 0;
+		uint64_t lo = UINT64_MAX;
+		uint64_t hi = 0;
+
+		for (int i = 0; i < gFrameNum; i++)
+		{
+			uint64_t t = gHarnessFrames[i].stageTicks[s];
+			sum += t;
+			lo = SDL_min(lo, t);
+			hi = SDL_max(hi, t);
+		}
+
+		double mean = sum * msPerTick / SDL_max(1, gFrameNum);
+		totalMean += mean;
+
+		SDL_Log("%-10s %9.3f %9.3f %9.3f", kStageNames[s], mean, lo * msPerTick, hi * msPerTick);
+	}
+
+	SDL_Log("%-10s %9.3f", "total", totalMean);
+}
+
+static void FinishHarness(void)
+{
+	gHarnessPlaying = false;
+	gHarnessActive = false;
+
+	PrintTimings();
+
+	const char* csvPath = SDL_GetHint(kHarnessCSVHint);
+	if (csvPath)
+		WriteCSV(csvPath);
+
+	const char* recordPath = SDL_GetHint(kHarnessRecordHint);
+	if (recordPath)
+		WriteHashes(recordPath);
+
+	const char* goldenPath = SDL_GetHint(kHarnessGoldenHint);
+	if (goldenPath)
+		CompareAgainstGolden(goldenPath);
+
+	CleanQuit();
+}
+
+#pragma mark - Frame hooks
+
+void HarnessBeginStage(int stage)
+{
+	if (!gHarnessPlaying)
+		return;
+
+	uint64_t now = SDL_GetPerformanceCounter();
+
+	if (gCurrentStage >= 0)
+	{
+		gHarnessFrames[gFrameNum].stageTicks[gCurrentStage] += now - gStageStartTicks;
+	}
+
+	gCurrentStage = stage;
+	gStageStartTicks = now;
+}
+
+void HarnessEndFrame(void)
+{
+	if (!gHarnessPlaying)
+		return;
+
+	HarnessBeginStage(-1);		// close the last stage
+
+	HarnessFrame* frame = &gHarnessFrames[gFrameNum];
+
+	// The PF window may not be in gIndexedFramebuffer, but the present path kept a copy of the whole frame
+	const uint8_t* indexed = gPlayfieldView.presentedFrame ? gPlayfieldView.presentedFrame : gIndexedFramebuffer;
+
+	uint64_t hash = kFNVOffsetBasis;
+	hash = FNV1a(hash, indexed, VISIBLE_WIDTH * VISIBLE_HEIGHT);
+	hash = FNV1a(hash, gGamePalette.finalColors32, sizeof(gGamePalette.finalColors32));
+	frame->indexHash = hash;
+
+	size_t colorSize = 0;
+	const void* colorPixels = gHeadless ? NullRender_GetFinalFramebuffer(&colorSize) : NULL;
+	frame->colorHash = colorPixels ? FNV1a(kFNVOffsetBasis, colorPixels, colorSize) : 0;
+
+	gFrameNum++;
+
+	if (gFrameNum >= gScriptNumFrames)
+	{
+		FinishHarness();
+	}
+}
+
+#pragma mark - Setup
+
+bool InitHarness(void)
+{
+	const char* scriptPath = SDL_GetHint(kHarnessHint);
+	if (!scriptPath)
+	{
+		return false;
+	}
+
+	LoadScript(scriptPath);
+
+	gHarnessFrames = (HarnessFrame*) NewPtrClear(sizeof(HarnessFrame) * gScriptNumFrames);
+	GAME_ASSERT(gHarnessFrames);
+
+	// Tweened frames depend on the wall clock, so they can't be reproduced
+	gGamePrefs.uncappedFramerate = false;
+
+	gHarnessActive = true;
+
+	SDL_Log("Harness: scene %d, area %d, seed %u, %d frames, %d input events",
+			gScriptScene, gScriptArea, gScriptSeed, gScriptNumFrames, gNumScriptEvents);
+
+	return true;
+}
+
+void RunHarness(void)
+{
+	GAME_ASSERT(gHarnessActive);
+
+	SetMyRandomSeed(gScriptSeed);
+
+	gPlayerMode = ONE_PLAYER;
+	gStartingScene = gScriptScene;
+	InitGame();
+
+	gSceneNum = gScriptScene;
+	gAreaNum = gScriptArea;
+	InitArea();
+
+	gFrameNum = 0;
+	gCurrentStage = -1;
+	gHarnessPlaying = true;
+
+	PlayArea();
+
+	// The area ended (death, exit...) before we ran all the frames
+	SDL_Log("Harness: area ended after %d frames", gFrameNum);
+	FinishHarness();
+}
+
+int GetHarnessExitCode(void)
+{
+	return gHarnessExitCode;
+}
@@ -19,6 +19,7 @@
 #include "window.h"
 #include "structures.h"
 #include "externs.h"
+#include "harness.h"
 
 /**********************/
 /*     PROTOTYPES     */
@@ -181,6 +182,12 @@ void UpdateInput(void)
 
 	for (int i = 0; i < NUM_CONTROL_NEEDS; i++)
 	{
+		if (gHarnessActive)				// scripted input replaces the real thing
+		{
+			UpdateKeyState(&gNeedStates[i], i < NUM_REMAPPABLE_NEEDS && GetScriptedNeedState(i));
+			continue;
+		}
+
 		const KeyBinding* kb = &gGamePrefs.keys[i];
 
 		bool downNow = false;
@@ -0,0 +1,300 @@
+// JOB SYSTEM
+// (C) 2025 Iliyas Jorio
+// This file is part of Mighty Mike. https://github.com/jorio/mightymike
+//
+// Small fork-join pool for per-frame work (framebuffer conversion, etc.)
+// Each worker owns a deque of job indices. A batch is spread across the deques
+// in contiguous runs; a worker that runs dry steals from the far end of another
+// worker's deque, so a slow core (e.g. an efficiency core) can't hold up the frame.
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+
+#include "externs.h"
+#include "misc.h"
+#include "jobs.h"
+
+// Set this hint (or environment variable) to override the number of workers
+#define kJobWorkersHint "MIGHTYMIKE_JOB_WORKERS"
+
+typedef struct
+{
+	SDL_SpinLock	lock;
+	int				head;		// thieves take from here
+	int				tail;		// owner takes from here
+	int				jobs[MAX_JOBS_PER_BATCH];
+} JobDeque;
+
+typedef struct
+{
+	JobFunc			func;
+	void*			userData;
+	SDL_AtomicInt	remaining;
+} JobBatch;
+
+static int				gNumJobWorkers = 0;
+static SDL_Thread*		gJobThreads[MAX_JOB_WORKERS];
+static JobDeque			gJobDeques[MAX_JOB_WORKERS];
+static JobWorkerStats	gJobWorkerStats[MAX_JOB_WORKERS];
+static JobBatch			gBatch;
+static SDL_Semaphore*	gWakeWorkers;			// one signal per worker per batch
+static SDL_Semaphore*	gBatchDone;				// signaled by whoever completes the last job
+static SDL_Mutex*		gBatchMutex;			// one batch at a time, even if several threads submit work
+static SDL_AtomicInt	gQuitJobWorkers;
+
+#pragma mark - Deques
+
+static bool PopJob(int workerNum, int* outJob)
+{
+	JobDeque* deque = &gJobDeques[workerNum];
+	bool found = false;
+
+	SDL_LockSpinlock(&deque->lock);
+	if (deque->head < deque->tail)
+	{
+		// Owner works through its run front-to-back (keeps rows in order for the cache)
+		*outJob = deque->jobs[deque->head++];
+		found = true;
+	}
+	SDL_UnlockSpinlock(&deque->lock);
+
+	return found;
+}
+
+static bool StealJob(int thiefNum, int* outJob)
+{
+	for (int i = 1; i < gNumJobWorkers; i++)
+	{
+		JobDeque* deque = &gJobDeques[(thiefNum + i) % gNumJobWorkers];
+		bool found = false;
+
+		SDL_LockSpinlock(&deque->lock);
+		if (deque->head < deque->tail)
+		{
+			// Steal from the end that the owner will reach last
+			*outJob = deque->jobs[--deque->tail];
+			found = true;
+		}
+		SDL_UnlockSpinlock(&deque->lock);
+
+		if (found)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Runs jobs until there are none left to pop or steal. Returns the time spent in job functions.
+static uint64_t RunJobsUntilEmpty(int workerNum)
+{
+	JobWorkerStats* stats = &gJobWorkerStats[workerNum];
+	uint64_t busyTicks = 0;
+	int job;
+
+	while (true)
+	{
+		if (PopJob(workerNum, &job))
+		{
+			// got one from our own queue
+		}
+		else if (StealJob(workerNum, &job))
+		{
+			stats->jobsStolen++;
+		}
+		else
+		{
+			break;
+		}
+
+		uint64_t start = SDL_GetPerformanceCounter();
+		gBatch.func(gBatch.userData, workerNum, job);
+		busyTicks += SDL_GetPerformanceCounter() - start;
+		stats->jobsRun++;
+
+		if (SDL_AddAtomicInt(&gBatch.remaining, -1) == 1)
+		{
+			SDL_SignalSemaphore(gBatchDone);
+		}
+	}
+
+	stats->busyTicks += busyTicks;
+	return busyTicks;
+}
+
+#pragma mark - Worker threads
+
+static int JobWorkerThread(void* data)
+{
+	int workerNum = (int) (intptr_t) data;
+
+	while (true)
+	{
+		SDL_WaitSemaphore(gWakeWorkers);
+
+		if (SDL_GetAtomicInt(&gQuitJobWorkers))
+			break;
+
+		uint64_t start = SDL_GetPerformanceCounter();
+		uint64_t busyTicks = RunJobsUntilEmpty(workerNum);
+		gJobWorkerStats[workerNum].idleTicks += SDL_GetPerformanceCounter() - start - busyTicks;
+	}
+
+	return 0;
+}
+
+void InitJobSystem(void)
+{
+	GAME_ASSERT(gNumJobWorkers == 0);
+
+	gNumJobWorkers = SDL_GetNumLogicalCPUCores();
+
+	const char* workersHint = SDL_GetHint(kJobWorkersHint);
+	if (workersHint)
+	{
+		gNumJobWorkers = SDL_atoi(workersHint);
+	}
+
+	gNumJobWorkers = SDL_clamp(gNumJobWorkers, 1, MAX_JOB_WORKERS);
+	SDL_Log("Job workers: %d", gNumJobWorkers);
+
+	ResetJobWorkerStats();
+
+	gBatchMutex = SDL_CreateMutex();
+	GAME_ASSERT(gBatchMutex);
+
+	if (gNumJobWorkers <= 1)	// run everything on the calling thread
+	{
+		return;
+	}
+
+	gWakeWorkers = SDL_CreateSemaphore(0);
+	gBatchDone = SDL_CreateSemaphore(0);
+	SDL_SetAtomicInt(&gQuitJobWorkers, 0);
+
+	// Worker 0 is the thread that submits the batch
+	for (int i = 1; i < gNumJobWorkers; i++)
+	{
+		char name[32];
+		SDL_snprintf(name, sizeof(name), "Job%02d", i);
+		gJobThreads[i] = SDL_CreateThread(JobWorkerThread, name, (void*) (intptr_t) i);
+		GAME_ASSERT(gJobThreads[i]);
+	}
+}
+
+void ShutdownJobSystem(void)
+{
+	if (gNumJobWorkers > 1)
+	{
+		SDL_SetAtomicInt(&gQuitJobWorkers, 1);
+
+		for (int i = 1; i < gNumJobWorkers; i++)
+			SDL_SignalSemaphore(gWakeWorkers);
+
+		for (int i = 1; i < gNumJobWorkers; i++)
+		{
+			SDL_WaitThread(gJobThreads[i], NULL);
+			gJobThreads[i] = NULL;
+		}
+
+		SDL_DestroySemaphore(gWakeWorkers);
+		SDL_DestroySemaphore(gBatchDone);
+		gWakeWorkers = NULL;
+		gBatchDone = NULL;
+	}
+
+	SDL_DestroyMutex(gBatchMutex);
+	gBatchMutex = NULL;
+
+	gNumJobWorkers = 0;
+}
+
+int GetNumJobWorkers(void)
+{
+	return gNumJobWorkers;
+}
+
+#pragma mark - Batches
+
+void RunParallelJobs(JobFunc func, void* userData, int numJobs)
+{
+	GAME_ASSERT(gNumJobWorkers != 0);
+	GAME_ASSERT(numJobs <= MAX_JOBS_PER_BATCH);
+
+	if (numJobs <= 0)
+	{
+		return;
+	}
+
+	SDL_LockMutex(gBatchMutex);
+
+	GAME_ASSERT_MESSAGE(!gBatch.func, "RunParallelJobs isn't reentrant");		// (the mutex is recursive)
+
+	if (gNumJobWorkers == 1 || numJobs == 1)	// not worth waking anyone up
+	{
+		uint64_t start = SDL_GetPerformanceCounter();
+		for (int i = 0; i < numJobs; i++)
+			func(userData, 0, i);
+		gJobWorkerStats[0].busyTicks += SDL_GetPerformanceCounter() - start;
+		gJobWorkerStats[0].jobsRun += numJobs;
+		SDL_UnlockMutex(gBatchMutex);
+		return;
+	}
+
+	gBatch.func = func;
+	gBatch.userData = userData;
+	SDL_SetAtomicInt(&gBatch.remaining, numJobs);
+
+	// Deal out contiguous runs of jobs, as evenly as possible
+	int jobsPerWorker = numJobs / gNumJobWorkers;
+	int remainder = numJobs - jobsPerWorker * gNumJobWorkers;
+	int job = 0;
+
+	for (int i = 0; i < gNumJobWorkers; i++)
+	{
+		JobDeque* deque = &gJobDeques[i];
+		int jobsThisWorker = jobsPerWorker + (i < remainder ? 1 : 0);
+
+		SDL_LockSpinlock(&deque->lock);
+		deque->head = 0;
+		deque->tail = jobsThisWorker;
+		for (int j = 0; j < jobsThisWorker; j++)
+			deque->jobs[j] = job++;
+		SDL_UnlockSpinlock(&deque->lock);
+	}
+
+	GAME_ASSERT(job == numJobs);
+
+	// Get the other workers going, then pitch in
+	int numHelpers = SDL_min(numJobs, gNumJobWorkers) - 1;
+	for (int i = 0; i < numHelpers; i++)
+		SDL_SignalSemaphore(gWakeWorkers);
+
+	uint64_t start = SDL_GetPerformanceCounter();
+	uint64_t busyTicks = RunJobsUntilEmpty(0);
+
+	// Wait for stragglers
+	SDL_WaitSemaphore(gBatchDone);
+
+	gJobWorkerStats[0].idleTicks += SDL_GetPerformanceCounter() - start - busyTicks;
+
+	gBatch.func = NULL;
+	gBatch.userData = NULL;
+
+	SDL_UnlockMutex(gBatchMutex);
+}
+
+#pragma mark - Stats
+
+const JobWorkerStats* GetJobWorkerStats(int workerNum)
+{
+	GAME_ASSERT(workerNum >= 0 && workerNum < MAX_JOB_WORKERS);
+	return &gJobWorkerStats[workerNum];
+}
+
+void ResetJobWorkerStats(void)
+{
+	SDL_zeroa(gJobWorkerStats);
+}
@@ -30,6 +30,9 @@
 #include "version.h"
 #include "externs.h"
 #include "framebufferfilter.h"
+#include "renderdrivers.h"
+#include "harness.h"
+#include "framescheduler.h"
 #include <SDL3/SDL.h>
 
 /****************************/
@@ -77,7 +80,7 @@ Boolean		gScreenScrollFlag = true;
 
 MikeFixed	gTweenFrameFactor			= { .L = 0x00000000 };
 MikeFixed	gOneMinusTweenFrameFactor	= { .L = 0x00010000 };
-static uint32_t	gTimeSinceSim = GAME_SPEED_SDL;
+static uint64_t	gTimeSinceSim = kNanosecondsPerSimFrame;			// nanoseconds, on the same sim period as the fixed-framerate loop
 
 /*****************/
 /* TOOLBOX INIT  */
@@ -147,15 +150,17 @@ void InitGame(void)
 
 	for (int i = 0; i < 3; i++)		// #0: quit, #1: resume, #2: none
 	{
-		const uint8_t* pixelData;
-		const FrameHeader* fh = GetFrameHeader(GroupNum_Quit, ObjType_Quit, i, &pixelData, nil);
-		pixelData += fh->width - 1;						// start on last column
-		for (int y = 0; y < fh->height; y++)
+		const FrameDesc* fd = GetFrameDesc(GroupNum_Quit, ObjType_Quit, i);
+		const uint8_t* pixelData = fd->pixels;
+		pixelData += fd->width - 1;						// start on last column
+		for (int y = 0; y < fd->height; y++)
 		{
 			* (uint8_t*) pixelData = pixelData[-5];		// copy fifth-from-last column to last column
-			pixelData += fh->width;						// next row
+			pixelData += fd->width;						// next row
 		}
 	}
+
+	RebuildFrameTable(GroupNum_Quit);					// pixels changed, redo mask analysis
 }
 
 
@@ -207,7 +212,7 @@ void InitArea(void)
 	DisplayPlayfield();
 	EraseObjects();
 
-	FadeInGameCLUT();											// fade in new screen
+	StartFadeInGameCLUT();										// fade in new screen while the game gets going
 }
 
 
@@ -259,33 +264,56 @@ void LoadAreaArt(void)
 
 static void UpdateSimAndRenderFixedFrame(void)
 {
-	static uint32_t oldTick = 0;
-
 	gTweenFrameFactor.L			= 0x00010000;				// reset frame interpolation (factor=1: force new coordinates)
 	gOneMinusTweenFrameFactor.L	= 0x00000000;
 
 	gFrames++;												// one more simulation frame
 
+	HARNESS_STAGE(kHarnessStage_Input);
 	UpdateShakeyScreen();
 	ReadKeyboard();
+	HARNESS_STAGE(kHarnessStage_Move);
 	MoveObjects();
 	SortObjectsByY();										// sort 'em
+	HARNESS_STAGE(kHarnessStage_Scroll);
 	ScrollPlayfield();										// do playfield updating
 	UpdateTileAnimation();
+	HARNESS_STAGE(kHarnessStage_Sprites);
 	DrawObjects();
+	HARNESS_STAGE(kHarnessStage_Playfield);
 	DisplayPlayfield();
+	HARNESS_STAGE(kHarnessStage_Infobar);
 	UpdateInfoBar();
+	HARNESS_STAGE(kHarnessStage_Present);
+	PresentIndexedFramebuffer();							// (before erasing: the PF window is read from the PF buffer)
+	HARNESS_STAGE(kHarnessStage_Erase);
 	EraseObjects();
-	PresentIndexedFramebuffer();
 
-	// Regulate speed
-	uint32_t tick = SDL_GetTicks();
-	while ((tick - oldTick) < GAME_SPEED_SDL)
+	if (gHarnessActive)										// hash & log the frame we just presented
+		HarnessEndFrame();
+
+	// Regulate speed (unless we're headless -- then go as fast as we can)
+	WaitForNextFrame(&gSimClock, kNanosecondsPerSimFrame);
+}
+
+
+/*************** GET TWEENED FRAME PERIOD ****************/
+//
+// How often the variable framerate version should draw a frame, in nanoseconds.
+// Returns 0 to draw as many frames as we can.
+//
+
+static uint64_t GetTweenedFramePeriodNS(void)
+{
+	switch (gGamePrefs.frameCap)
 	{
-		SDL_Delay(2);
-		tick = SDL_GetTicks();
+		case kFrameCap_None:		return 0;
+		case kFrameCap_30:			return 1000000000ull / 30;
+		case kFrameCap_60:			return 1000000000ull / 60;
+		case kFrameCap_120:			return 1000000000ull / 120;
+		case kFrameCap_Refresh:
+		default:					return GetDisplayRefreshPeriodNS();
 	}
-	oldTick = tick;
 }
 
 
@@ -302,9 +330,9 @@ static void UpdateSimAndRenderTweenedFrames(void)
 
 				/* SEE IF WE NEED TO SKIP SIMULATION FRAMES */
 
-	if (gTimeSinceSim >= GAME_SPEED_SDL*2)					// if we need to skip sim frames, the program probably got paused
+	if (gTimeSinceSim >= kNanosecondsPerSimFrame*2)			// if we need to skip sim frames, the program probably got paused
 	{														// in that case, slow down the sim
-		gTimeSinceSim = GAME_SPEED_SDL;
+		gTimeSinceSim = kNanosecondsPerSimFrame;
 	}
 
 				/* RUN ONE SIMULATION FRAME */
@@ -320,17 +348,32 @@ static void UpdateSimAndRenderTweenedFrames(void)
 	UpdateTileAnimation();
 	UpdateInfoBar();
 
-	gTimeSinceSim -= GAME_SPEED_SDL;						// catch up
+	gTimeSinceSim -= kNanosecondsPerSimFrame;				// catch up
 
 				/* GRAPHICS FRAMES */
 				// We can render a variable number of
+				// them: one per display refresh (or per frame cap period), or as many as we can.
 
-	uint32_t startOfFrameTimestamp = SDL_GetTicks();
+	uint64_t framePeriodNS = GetTweenedFramePeriodNS();
+	uint64_t startOfFrameTimestamp = SDL_GetTicksNS();
 
-	while (gTimeSinceSim < GAME_SPEED_SDL)					// render as many graphics frames as we can until it's time to run the sim again
+	while (gTimeSinceSim < kNanosecondsPerSimFrame)		// render graphics frames until it's time to run the sim again
 	{
+		if (framePeriodNS != 0)
+		{
+			// Sleep until it's time for the next frame (if vsync isn't already holding us back)
+			WaitForNextDisplayFrame(framePeriodNS);
+
+			uint64_t now = SDL_GetTicksNS();
+			gTimeSinceSim += now - startOfFrameTimestamp;
+			startOfFrameTimestamp = now;
+
+			if (gTimeSinceSim >= kNanosecondsPerSimFrame)	// slept into the next sim frame
+				break;
+		}
+
 		// Update tween factor at beginning of frame
-		gTweenFrameFactor.L			= 0x10000 * gTimeSinceSim / GAME_SPEED_SDL;
+		gTweenFrameFactor.L			= (int32_t) (0x10000 * gTimeSinceSim / kNanosecondsPerSimFrame);
 		gOneMinusTweenFrameFactor.L	= 0x10000 - gTweenFrameFactor.L;
 
 		GAME_ASSERT(gTweenFrameFactor.L >= 0 && gTweenFrameFactor.L <= 0x10000);
@@ -338,10 +381,15 @@ static void UpdateSimAndRenderTweenedFrames(void)
 		ScrollPlayfield();									// also tweens camera position
 		DrawObjects();
 		DisplayPlayfield();
-		EraseObjects();
 		PresentIndexedFramebuffer();
+		EraseObjects();
 
-		uint32_t now = SDL_GetTicks();
+		if (framePeriodNS != 0)
+			EndDisplayFrame();								// learn how long drawing & presenting takes
+		else
+			MarkFrame(&gDisplayClock);						// unpaced; just keep stats
+
+		uint64_t now = SDL_GetTicksNS();
 		gTimeSinceSim += now - startOfFrameTimestamp;
 		startOfFrameTimestamp = now;
 	}
@@ -362,13 +410,13 @@ void PlayArea(void)
 
 	gIsInGame = true;
 
-	gTimeSinceSim = GAME_SPEED_SDL;						// force simulation to run once when we enter this function
+	gTimeSinceSim = kNanosecondsPerSimFrame;				// force simulation to run once when we enter this function
 
 	do
 	{
 					/* UPDATE SIMULATION & RENDER FRAME(S) */
 
-		if (gGamePrefs.uncappedFramerate)
+		if (gGamePrefs.uncappedFramerate && !gHeadless)	// tweening is driven by the wall clock, which a headless run ignores
 			UpdateSimAndRenderTweenedFrames();
 		else
 			UpdateSimAndRenderFixedFrame();
@@ -404,6 +452,12 @@ void PlayArea(void)
 
 		if (GetNewSDLKeyState(SDL_SCANCODE_F9))
 			gScreenScrollFlag = !gScreenScrollFlag;
+
+		if (GetNewSDLKeyState(SDL_SCANCODE_F7))
+		{
+			DumpFrameSchedulerStats();
+			ResetFrameSchedulerStats();
+		}
 #endif
 
 	} while (!gGlobFlag_MeDoneDead && !gAbortGameFlag && !gFinishedArea && !gAbortDemoFlag);
@@ -1276,6 +1330,11 @@ static void InitDefaultPrefs(void)
 	gGamePrefs.debugInfoInTitleBar = false;
 	gGamePrefs.colorCorrection = true;
 	gGamePrefs.autoFireSingleShots = false; // default off
+	gGamePrefs.deferredTexUpload = false;
+	gGamePrefs.presentLatency = 0;
+	gGamePrefs.prescaleFilter = kPrescale_Nearest;
+	gGamePrefs.colorDepth = kColorDepth_Auto;
+	gGamePrefs.frameCap = kFrameCap_Refresh;
 	SDL_memcpy(gGamePrefs.keys, kDefaultKeyBindings, sizeof(kDefaultKeyBindings));
 }
 
@@ -1380,25 +1439,37 @@ long				count;
 void GameMain(void)
 {
 	InitRenderThreads();
+	InitSpriteKernels();
     TryOpenGamepad(true);
 
 	ToolBoxInit();
 	VerifySystem();
 
 	InitDefaultPrefs();
-	LoadPrefs();
+	if (!InitHarness())								// harness runs stick to the default prefs
+		LoadPrefs();
 	ApplyPrefs();
 	MakeGameWindow();	// now called by ApplyPrefs
 
 	InitInput();                                    // init ISp
+
+	uint64_t paletteStart = SDL_GetPerformanceCounter();
 	InitPaletteStuff();
-	CreatePlayfieldPermanentMemory();				// init permanent playfield stuff
+	uint64_t paletteTicks = SDL_GetPerformanceCounter() - paletteStart;
+
 	InitObjectManager();							// call this just to allocate memory
 	InitSoundTools();
 	GetDateTime ((unsigned long *)(&someLong));		// init random seed
 	SetMyRandomSeed(someLong);
 	LoadHighScores();
 
+	SDL_Log("Boot: ready after %d ms (palette tables: %.2f ms)",
+			(int) SDL_GetTicks(),
+			1000.0 * paletteTicks / SDL_GetPerformanceFrequency());
+
+	if (gHarnessActive)								// play scripted frames, then quit
+		RunHarness();
+
 #if 0												// Source port TEMP: in debug mode, boot straight to game
 	SDL_Log("WARNING: DEBUG MODE: Jumping straight to game");
 	gSceneNum = 0;	// 0...4
@@ -22,6 +22,8 @@
 #include "cinema.h"
 #include "externs.h"
 #include "main.h"
+#include "renderdrivers.h"
+#include "framescheduler.h"
 
 /****************************/
 /*    PROTOTYPES             */
@@ -32,9 +34,8 @@
 /****************************/
 
 // Source port note: the game's Wait functions were pure spinlocks.
-// I threw in a simple SDL_Delay in Wait's loop so the game consumes less power
-// until I get around to implementing a better solution for speed regulation.
-#define		SPINLOCK_DELAY		2
+// They now go through the frame scheduler (FrameScheduler.c), which sleeps until shortly
+// before each deadline and only spins for the last stretch.
 
 #define	DECOMP_PACKET_SIZE	20000L
 
@@ -152,6 +153,7 @@ static Boolean beenHereFlag = false;
 
 	CleanMemory();
 	ZapAllSounds();
+	DumpFrameSchedulerStats();
 	CleanupDisplay();								// unloads Draw Sprocket
 
 exit:
@@ -170,15 +172,9 @@ exit:
 
 Boolean Wait(long time)
 {
-uint32_t	old;
-
 	while (time > 0)
 	{
-		old = TickCount();							// wait for 1 tick to pass
-		while(TickCount() == old)
-		{
-			SDL_Delay(SPINLOCK_DELAY);
-		}
+		WaitForNextFrame(&gTickClock, kNanosecondsPerMacTick);	// wait for 1 tick to pass
 		PresentIndexedFramebuffer();
 		--time;
 		ReadKeyboard();
@@ -221,11 +217,10 @@ void Wait2(long time)
 
 void Wait4(long time)
 {
-uint32_t	start;
+	if (gHeadless)										// skipped when headless, like the frame scheduler's waits
+		return;
 
-	start = TickCount();
-	while (TickCount() < (start+time))
-		SDL_Delay(SPINLOCK_DELAY);
+	SleepUntilNS(SDL_GetTicksNS() + (uint64_t) time * kNanosecondsPerMacTick);
 }
 
 
@@ -567,25 +562,7 @@ long		numToRead;
 
 void RegulateSpeed(long speed)
 {
-UnsignedWide	tick;
-static	UnsignedWide oldTick = {0,0};
-
-	do
-	{
-		Microseconds(&tick);					// get current micro secs
-
-		if (tick.hi != oldTick.hi)              // if hi value is diff then just skip a beat and bail
-		    break;
-
-        if ((tick.lo - oldTick.lo) >= (unsigned long) speed)    // see if enough time has passed
-            break;
-
-		SDL_Delay(SPINLOCK_DELAY);
-
-	} while(true);
-
-	oldTick = tick;
-
+	WaitForNextFrame(&gMicrosecondClock, (uint64_t) speed * 1000);
 	gFrames++;
 }
 
@@ -597,11 +574,7 @@ static	UnsignedWide oldTick = {0,0};
 
 void RegulateSpeed2(short speed)
 {
-static uint32_t gTick = 0;
-
-	while ((TickCount() - gTick) < (uint32_t)speed)	// wait for 1 tick
-		SDL_Delay(SPINLOCK_DELAY);
-	gTick = TickCount();							// remember current time
+	WaitForNextFrame(&gTickClock, (uint64_t) speed * kNanosecondsPerMacTick);
 	gFrames++;
 }
 
@@ -715,6 +688,8 @@ void FillThermometer(short percent)
 	int right = left + width;
 	int bottom = top + height;
 
+	ResolvePlayfieldView();
+
 	if (percent == 0)
 	{
 				/* INIT THERMOMETER */
@@ -64,6 +64,7 @@ void LoadImage(const char* fileName, short showMode)
 	}
 	else
 	{
+		ResolvePlayfieldView();
 		destPtr = gIndexedFramebuffer;
 		destRowBytes = VISIBLE_WIDTH;
 	}
@@ -0,0 +1,246 @@
+// PRESENT PIPELINE
+// (C) 2025 Iliyas Jorio
+// This file is part of Mighty Mike. https://github.com/jorio/mightymike
+//
+// With 1 frame of latency, a dedicated thread converts, uploads and swaps frame N
+// while the main thread moves and draws frame N+1.
+// The game keeps drawing into gIndexedFramebuffer (it relies on the previous frame's
+// contents being there), so the present thread gets a snapshot of it and of the palette.
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_thread.h>
+
+#include "myglobals.h"
+#include "externs.h"
+#include "misc.h"
+#include "window.h"
+#include "renderdrivers.h"
+#include "framebufferfilter.h"
+
+const uint8_t* gPresentSourceFramebuffer = NULL;
+const GamePalette* gPresentSourcePalette = NULL;
+PlayfieldView* gPresentSourceView = NULL;
+PresentPrefs gPresentPrefs;
+
+PresentPipelineStats gPresentPipelineStats;
+
+static SDL_Thread* gPresentThread = NULL;
+static SDL_Semaphore* gFrameReady = NULL;		// main thread -> present thread
+static SDL_Semaphore* gFrameDone = NULL;		// present thread -> main thread
+static SDL_AtomicInt gQuitPresentThread;
+static bool gFrameInFlight = false;				// only touched by the main thread
+
+static uint8_t* gSnapshotFramebuffer = NULL;
+static int gSnapshotSize = 0;
+static GamePalette gSnapshotPalette;
+
+/****************** PRESENT THREAD *************************/
+
+static void PresentNow(void)
+{
+	if (gHeadless)
+	{
+		NullRender_PresentFramebuffer();
+		return;
+	}
+
+#if GLRENDER
+	GLRender_PresentFramebuffer();
+#else
+	SDLRender_PresentFramebuffer();
+#endif
+}
+
+static int PresentThread(void* unused)
+{
+	(void) unused;
+
+	while (true)
+	{
+		uint64_t waitStart = SDL_GetPerformanceCounter();
+		SDL_WaitSemaphore(gFrameReady);
+		uint64_t waitTicks = SDL_GetPerformanceCounter() - waitStart;
+
+		if (SDL_GetAtomicInt(&gQuitPresentThread))
+			break;
+
+		PresentNow();
+
+		// Only touch the shared stats between gFrameReady and gFrameDone,
+		// while the main thread keeps its hands off them (see FlushPresentPipeline)
+		gPresentPipelineStats.presentWaitTicks += waitTicks;
+
+		SDL_SignalSemaphore(gFrameDone);
+	}
+
+#if GLRENDER
+	// Hand the context back so the main thread can present or shut down
+	GLRender_ReleaseContext();
+#endif
+
+	return 0;
+}
+
+static void StartPresentThread(void)
+{
+	GAME_ASSERT(!gPresentThread);
+
+	gFrameReady = SDL_CreateSemaphore(0);
+	gFrameDone = SDL_CreateSemaphore(0);
+	SDL_SetAtomicInt(&gQuitPresentThread, 0);
+
+#if GLRENDER
+	// A GL context can only be current in one thread at a time
+	GLRender_ReleaseContext();
+#endif
+
+	gPresentThread = SDL_CreateThread(PresentThread, "Present", NULL);
+	GAME_ASSERT(gPresentThread);
+
+	SDL_Log("Present thread started");
+}
+
+static void StopPresentThread(void)
+{
+	if (!gPresentThread)
+	{
+		return;
+	}
+
+	FlushPresentPipeline();
+
+	SDL_SetAtomicInt(&gQuitPresentThread, 1);
+	SDL_SignalSemaphore(gFrameReady);
+	SDL_WaitThread(gPresentThread, NULL);
+	gPresentThread = NULL;
+
+	SDL_DestroySemaphore(gFrameReady);
+	SDL_DestroySemaphore(gFrameDone);
+	gFrameReady = NULL;
+	gFrameDone = NULL;
+
+	SDL_Log("Present thread stopped");
+}
+
+/****************** MAIN THREAD SIDE *************************/
+
+// Blocks until the present thread is done with the frame it's working on, if any.
+// Call this before changing anything that the present path reads
+// (framebuffer dimensions, scaling, dither buffers...)
+void FlushPresentPipeline(void)
+{
+	if (!gFrameInFlight)
+	{
+		return;
+	}
+
+	uint64_t waitStart = SDL_GetPerformanceCounter();
+#if __APPLE__
+	// Swapping buffers may require the main thread to service a Cocoa GL context update,
+	// so keep the run loop turning while we wait
+	while (!SDL_WaitSemaphoreTimeout(gFrameDone, 1))
+	{
+		SDL_PumpEvents();
+	}
+#else
+	SDL_WaitSemaphore(gFrameDone);
+#endif
+	gPresentPipelineStats.mainWaitTicks += SDL_GetPerformanceCounter() - waitStart;
+
+	gFrameInFlight = false;
+}
+
+// Copies the prefs that the present path reads out of gGamePrefs (see PresentPrefs).
+void SyncPresentPrefs(void)
+{
+	FlushPresentPipeline();
+
+	gPresentPrefs.filterDithering	= gGamePrefs.filterDithering;
+	gPresentPrefs.prescaleFilter	= gGamePrefs.prescaleFilter;
+	gPresentPrefs.deferredTexUpload	= gGamePrefs.deferredTexUpload;
+	gPresentPrefs.colorDepth		= gGamePrefs.colorDepth;
+}
+
+void SubmitFrameForPresentation(void)
+{
+	FlushPresentPipeline();
+
+	// Showing the same frame again? The PF buffer may have moved on since, so use the copy we presented
+	if (gPlayfieldView.presentedFrame)
+	{
+		ResolvePlayfieldView();
+	}
+
+#if GLRENDER
+	bool pipelined = gGamePrefs.presentLatency > 0 && !gHeadless;	// the null driver may quit from within its present function
+#else
+	bool pipelined = false;		// SDL's 2D renderer may only be driven from the main thread
+#endif
+
+	gPresentPipelineStats.numFrames++;
+
+	SyncPresentPrefs();		// pick up pref changes made since the last frame
+
+	if (!pipelined)
+	{
+		StopPresentThread();
+
+		gPresentSourceFramebuffer = gIndexedFramebuffer;
+		gPresentSourcePalette = &gGamePalette;
+		gPresentSourceView = gPlayfieldView.live ? &gPlayfieldView : NULL;
+		PresentNow();
+		gPresentSourceView = NULL;
+
+		// If the driver didn't get around to reading the frame, copy the PF window out before the PF buffer changes
+		if (gPlayfieldView.live && !gPlayfieldView.presentedFrame)
+		{
+			ResolvePlayfieldView();
+		}
+		return;
+	}
+
+	if (!gPresentThread)
+	{
+		StartPresentThread();
+	}
+
+	// Take a snapshot of the frame for the present thread
+	int size = VISIBLE_WIDTH * VISIBLE_HEIGHT;
+	if (size != gSnapshotSize)
+	{
+		CHECKED_DISPOSEPTR(gSnapshotFramebuffer);
+		gSnapshotFramebuffer = (uint8_t*) NewPtr(size);
+		GAME_ASSERT(gSnapshotFramebuffer);
+		gSnapshotSize = size;
+	}
+
+	if (gPlayfieldView.live)		// take the PF window straight from the ring buffer
+	{
+		ComposePlayfieldView(gSnapshotFramebuffer);
+		gPlayfieldView.presentedFrame = gSnapshotFramebuffer;
+	}
+	else
+	{
+		SDL_memcpy(gSnapshotFramebuffer, gIndexedFramebuffer, size);
+	}
+
+	gSnapshotPalette = gGamePalette;
+
+	gPresentSourceFramebuffer = gSnapshotFramebuffer;
+	gPresentSourcePalette = &gSnapshotPalette;
+
+	// Off it goes; we'll wait for it next time around (or in FlushPresentPipeline)
+	gFrameInFlight = true;
+	SDL_SignalSemaphore(gFrameReady);
+}
+
+void ShutdownPresentPipeline(void)
+{
+	StopPresentThread();
+
+	CHECKED_DISPOSEPTR(gSnapshotFramebuffer);
+	gSnapshotSize = 0;
+
+	gPresentSourceFramebuffer = NULL;
+	gPresentSourcePalette = NULL;
+}
@@ -150,6 +150,16 @@ static MenuItem gVideoMenu[] =
 			.choices = { "32 fps, like original", "smooth" },
 		}
 	},
+	{
+		.type = kMenuItem_Cycler, .cycler =
+		{
+			.caption = "smooth fps cap",
+			.callback = nil,
+			.valuePtr = &gGamePrefs.frameCap,
+			.numChoices = 5,
+			.choices = { "display refresh", "none", "30", "60", "120" },
+		}
+	},
 	{ .type = kMenuItem_Separator },
 	{
 		.type = kMenuItem_Cycler, .cycler =
@@ -251,6 +261,52 @@ static MenuItem gVideoMenu[] =
 		}
 	},
 
+	{
+		.type = kMenuItem_Cycler, .cycler =
+		{
+			.caption = "upscaling",
+			.callback = nil,
+			.valuePtr = &gGamePrefs.prescaleFilter,
+			.numChoices = 2,
+			.choices = { "sharp pixels", "smooth edges" },
+		}
+	},
+
+	{
+		.type = kMenuItem_Cycler, .cycler =
+		{
+			.caption = "color depth",
+			.callback = nil,
+			.valuePtr = &gGamePrefs.colorDepth,
+			.numChoices = 3,
+			.choices = { "auto", "16-bit", "32-bit" },
+		}
+	},
+
+#if GLRENDER
+	{
+		.type = kMenuItem_Cycler, .cycler =
+		{
+			.caption = "texture upload",
+			.callback = nil,
+			.valuePtr = &gGamePrefs.deferredTexUpload,
+			.numChoices = 2,
+			.choices = { "immediate", "deferred, faster" },
+		}
+	},
+
+	{
+		.type = kMenuItem_Cycler, .cycler =
+		{
+			.caption = "present thread",
+			.callback = nil,
+			.valuePtr = &gGamePrefs.presentLatency,
+			.numChoices = 2,
+			.choices = { "off, lowest latency", "on, 1 frame latency" },
+		}
+	},
+#endif
+
 	{ .type = kMenuItem_Action, .button = { .caption = "done", .callback = OnDone } },
 
 	{ .type = kMenuItem_END_SENTINEL },
@@ -1352,6 +1408,7 @@ void DoSettingsScreen(void)
 
 void ApplyPrefs(void)
 {
+	SyncPresentPrefs();						// the window & textures about to be made depend on these
 	OnChangePlayfieldSize();
 	SetFullscreenMode(true);
 	OnChangeIntegerScaling();
@@ -363,6 +363,8 @@ void DrawSpinFrame(Ptr srcPtr)
 	if (numChunks == 0)
 		return;
 
+	ResolvePlayfieldView();
+
 	do
 	{
 		int x = *srcPtr;				srcPtr += 1;		// get X coord (in longs)
@@ -19,6 +19,9 @@
 #include "input.h"
 #include "externs.h"
 #include "renderdrivers.h"
+#include "framebufferfilter.h"
+#include "jobs.h"
+#include "framescheduler.h"
 #include "version.h"
 
 /****************************/
@@ -48,8 +51,9 @@ int				VISIBLE_HEIGHT = 480;
 uint8_t*		gIndexedFramebuffer = nil;		// [VISIBLE_WIDTH * VISIBLE_HEIGHT]
 
 int				gEffectiveScalingType = kScaling_Stretch;
+int				gPrescale = 1;
 
-uint8_t*		gRowDitherStrides = nil;		// for dithering filter
+DitherSpan*		gRowDitherStrides = nil;		// for dithering filter
 
 										// GAME STUFF
 Handle			gBackgroundHandle = nil;
@@ -70,12 +74,18 @@ uint8_t**		gBackgroundLookUpTable = nil;	//[OFFSCREEN_HEIGHT]
 uint8_t**		gPFLookUpTable = nil;
 uint8_t**		gPFCopyLookUpTable = nil;
 uint8_t**		gPFMaskLookUpTable = nil;
+uint8_t*		gPFTileMaskStates = nil;
+
+PlayfieldView	gPlayfieldView;
 
 static const uint32_t	kDebugTextUpdateInterval = 1000;
 static uint32_t			gDebugTextFrameAccumulator = 0;
+static uint32_t			gDebugTextRowAccumulator = 0;
 static uint64_t			gDebugTextLastUpdatedAt = 0;
 static char				gDebugTextBuffer[1024];
 
+RenderTimings			gRenderTimings;
+
 
 /********************** ERASE BACKGROUND BUFFER ********************/
 
@@ -108,6 +118,8 @@ void MakeGameWindow(void)
 
 void DumpGameWindow(void)
 {
+	ResolvePlayfieldView();
+
 				/* GET SCREEN PIXMAP INFO */
 
 	uint8_t* destPtr	= gIndexedFramebuffer;
@@ -157,6 +169,8 @@ long		size;
 
 	if (gGamePrefs.interlaceMode)
 	{
+		ResolvePlayfieldView();
+
 		destPtr = gScreenLookUpTable[PF_WINDOW_TOP+1] + PF_WINDOW_LEFT;
 
 		for (short height = PF_WINDOW_HEIGHT>>1; height > 0; height--)
@@ -185,6 +199,8 @@ Rect	r;
 
 static void DisposeScreenBuffers(void)
 {
+	FlushPresentPipeline();			// present thread may be reading the dither buffers
+
 	CHECKED_DISPOSEPTR(gIndexedFramebuffer);
 
 	CHECKED_DISPOSEHANDLE(gOffScreenHandle);
@@ -197,6 +213,7 @@ static void DisposeScreenBuffers(void)
 	CHECKED_DISPOSEPTR(gPFLookUpTable);
 	CHECKED_DISPOSEPTR(gPFCopyLookUpTable);
 	CHECKED_DISPOSEPTR(gPFMaskLookUpTable);
+	CHECKED_DISPOSEPTR(gPFTileMaskStates);
 
 	CHECKED_DISPOSEHANDLE(gPFBufferHandle);
 	CHECKED_DISPOSEHANDLE(gPFBufferCopyHandle);
@@ -215,6 +232,8 @@ static void InitScreenBuffers(void)
 {
 	DisposeScreenBuffers();
 
+	SDL_zero(gPlayfieldView);				// whatever it pointed to is going away
+
 					/* MAKE INDEXED FRAMEBUFFER */
 
 	gIndexedFramebuffer = (uint8_t*) NewPtrClear(VISIBLE_WIDTH * VISIBLE_HEIGHT);
@@ -263,6 +282,7 @@ static void InitScreenBuffers(void)
 	gPFBufferHandle		= NewHandleClear(PF_BUFFER_HEIGHT * PF_BUFFER_WIDTH);
 	gPFBufferCopyHandle	= NewHandleClear(PF_BUFFER_HEIGHT * PF_BUFFER_WIDTH);
 	gPFMaskBufferHandle	= NewHandleClear(PF_BUFFER_HEIGHT * PF_BUFFER_WIDTH);
+	gPFTileMaskStates	= (uint8_t*) NewPtrClear(PF_TILE_HEIGHT * PF_TILE_WIDTH);	// all kTileMask_Clear, like the mask buffer
 
 	GAME_ASSERT(gPFLookUpTable);
 	GAME_ASSERT(gPFCopyLookUpTable);
@@ -270,6 +290,7 @@ static void InitScreenBuffers(void)
 	GAME_ASSERT(gPFBufferHandle);
 	GAME_ASSERT(gPFBufferCopyHandle);
 	GAME_ASSERT(gPFMaskBufferHandle);
+	GAME_ASSERT(gPFTileMaskStates);
 
 					/* BUILD SCREEN LOOKUP TABLE */
 
@@ -291,7 +312,7 @@ static void InitScreenBuffers(void)
 
 					/* BUILD DITHERING FILTER BUFFER */
 
-	gRowDitherStrides = (uint8_t*) NewPtrClear(gNumThreads * VISIBLE_WIDTH);
+	gRowDitherStrides = (DitherSpan*) NewPtrClear(gNumThreads * VISIBLE_WIDTH * sizeof(DitherSpan));
 }
 
 
@@ -350,6 +371,8 @@ long	x,y;
 	width = (theArea.right - (x = theArea.left));
 	height = (theArea.bottom - (y = theArea.top));
 
+	ResolvePlayfieldViewRect(theArea.left, theArea.top, theArea.right, theArea.bottom);
+
 	destPtr = gScreenLookUpTable[y] + x;			// calc write addr
 
 						/* DO THE ERASE */
@@ -382,14 +405,147 @@ void SetScreenOffsetFor640x480(void)
 
 #pragma mark -
 
+/****************** SET PLAYFIELD VIEW *************************/
+//
+// Shows the PF window starting at left,top in the ring buffer, without copying it anywhere.
+// Until the frame is presented, the ring buffer must not change.
+//
+
+void SetPlayfieldView(int left, int top)
+{
+	gPlayfieldView.live = true;
+	gPlayfieldView.left = left;
+	gPlayfieldView.top = top;
+	gPlayfieldView.presentedFrame = nil;
+}
+
+/****************** GET PLAYFIELD VIEW ROW *************************/
+//
+// Finds row y (in framebuffer coords) of the PF window in the ring buffer.
+// The row wraps around the buffer horizontally in 1 or 2 segments; returns how many.
+//
+
+int GetPlayfieldViewRow(const PlayfieldView* view, int y, const uint8_t* outSrc[2], int outWidth[2])
+{
+	int row = view->top + (y - PF_WINDOW_TOP);
+	if (row >= PF_BUFFER_HEIGHT)
+		row -= PF_BUFFER_HEIGHT;
+
+	const uint8_t* rowPtr = gPFLookUpTable[row];
+
+	outSrc[0] = rowPtr + view->left;
+	outWidth[0] = SDL_min(PF_WINDOW_WIDTH, PF_BUFFER_WIDTH - view->left);
+
+	if (outWidth[0] == PF_WINDOW_WIDTH)
+		return 1;
+
+	outSrc[1] = rowPtr;											// rest of the row wraps to the left edge of the buffer
+	outWidth[1] = PF_WINDOW_WIDTH - outWidth[0];
+	return 2;
+}
+
+/****************** COMPOSE PLAYFIELD VIEW *************************/
+//
+// Writes the frame as it should appear on screen into dst (laid out like gIndexedFramebuffer):
+// the PF window comes from the ring buffer, everything else from gIndexedFramebuffer.
+//
+
+void ComposePlayfieldView(uint8_t* dst)
+{
+	GAME_ASSERT(gPlayfieldView.live);
+
+	for (int y = 0; y < VISIBLE_HEIGHT; y++)
+	{
+		const uint8_t* srcRow = gScreenLookUpTable[y];
+		uint8_t* dstRow = dst + y * VISIBLE_WIDTH;
+
+		if (y < PF_WINDOW_TOP || y >= PF_WINDOW_TOP + PF_WINDOW_HEIGHT)
+		{
+			SDL_memcpy(dstRow, srcRow, VISIBLE_WIDTH);
+			continue;
+		}
+
+		const uint8_t* segSrc[2];
+		int segWidth[2];
+		int numSegs = GetPlayfieldViewRow(&gPlayfieldView, y, segSrc, segWidth);
+		int x = PF_WINDOW_LEFT;
+
+		SDL_memcpy(dstRow, srcRow, x);							// border left of the window
+
+		for (int i = 0; i < numSegs; i++)
+		{
+			SDL_memcpy(dstRow + x, segSrc[i], segWidth[i]);
+			x += segWidth[i];
+		}
+
+		SDL_memcpy(dstRow + x, srcRow + x, VISIBLE_WIDTH - x);	// border right of the window
+	}
+}
+
+/****************** RESOLVE PLAYFIELD VIEW *************************/
+//
+// Puts the PF window's pixels back into gIndexedFramebuffer.
+// If the frame was presented, they come from the copy that the present path kept,
+// because the ring buffer has moved on since (sprites erased, etc.)
+//
+
+void ResolvePlayfieldView(void)
+{
+	if (!gPlayfieldView.live)
+		return;
+
+	for (int y = PF_WINDOW_TOP; y < PF_WINDOW_TOP + PF_WINDOW_HEIGHT; y++)
+	{
+		uint8_t* dst = gScreenLookUpTable[y] + PF_WINDOW_LEFT;
+
+		if (gPlayfieldView.presentedFrame)
+		{
+			SDL_memcpy(dst, gPlayfieldView.presentedFrame + y * VISIBLE_WIDTH + PF_WINDOW_LEFT, PF_WINDOW_WIDTH);
+		}
+		else
+		{
+			const uint8_t* segSrc[2];
+			int segWidth[2];
+			int numSegs = GetPlayfieldViewRow(&gPlayfieldView, y, segSrc, segWidth);
+
+			for (int i = 0; i < numSegs; i++)
+			{
+				SDL_memcpy(dst, segSrc[i], segWidth[i]);
+				dst += segWidth[i];
+			}
+		}
+	}
+
+	gPlayfieldView.live = false;
+	gPlayfieldView.presentedFrame = nil;
+}
+
+// Same, but only if the given framebuffer area overlaps the PF window
+void ResolvePlayfieldViewRect(int left, int top, int right, int bottom)
+{
+	if (gPlayfieldView.live &&
+		left < PF_WINDOW_LEFT + PF_WINDOW_WIDTH && right > PF_WINDOW_LEFT &&
+		top < PF_WINDOW_TOP + PF_WINDOW_HEIGHT && bottom > PF_WINDOW_TOP)
+	{
+		ResolvePlayfieldView();
+	}
+}
+
+#pragma mark -
+
 /****************** CLEANUP DISPLAY *************************/
 
 void CleanupDisplay(void)
 {
+	ShutdownPresentPipeline();
+
+	if (gHeadless)
+		NullRender_Shutdown();
+	else
 #if GLRENDER
-	GLRender_Shutdown();
+		GLRender_Shutdown();
 #else
-	SDLRender_Shutdown();
+		SDLRender_Shutdown();
 #endif
 
 	DisposeScreenBuffers();
@@ -400,8 +556,10 @@ void CleanupDisplay(void)
 #if _DEBUG
 static void SaveIndexedScreenshot(void)
 {
+	ResolvePlayfieldView();
 	DumpIndexedTGA("/tmp/MikeIndexedScreenshot.tga", VISIBLE_WIDTH, VISIBLE_HEIGHT, (const char*) gIndexedFramebuffer);
 }
+#endif
 
 void DumpIndexedTGA(const char* hostPath, int width, int height, const char* data)
 {
@@ -445,10 +603,11 @@ void DumpIndexedTGA(const char* hostPath, int width, int height, const char* dat
 
 	SDL_Log("wrote %s", hostPath);
 }
-#endif
 
 void PresentIndexedFramebuffer(void)
 {
+	UpdateGameCLUTFade();		// advance fade in/out, if any (may blank the screen)
+
 	if (gScreenBlankedFlag)		// CLUT was blanked (in-between a fade-out and a fade-in), ignore
 	{
 		return;
@@ -463,18 +622,16 @@ void PresentIndexedFramebuffer(void)
 #endif
 
 	//-------------------------------------------------------------------------
-	// Present framebuffer
+	// Wait for the present thread to finish the previous frame (if pipelined).
+	// Past this point, it's safe to read or reset the render stats.
 
-#if GLRENDER
-	GLRender_PresentFramebuffer();
-#else
-	SDLRender_PresentFramebuffer();
-#endif
+	FlushPresentPipeline();
 
 	//-------------------------------------------------------------------------
 	// Update debug info
 
 	gDebugTextFrameAccumulator++;
+	gDebugTextRowAccumulator += gFramebufferDamage.numDirtyRows;
 	uint64_t ticksNow = SDL_GetTicks();
 	uint64_t ticksElapsed = ticksNow - gDebugTextLastUpdatedAt;
 	if (ticksElapsed >= kDebugTextUpdateInterval)
@@ -482,14 +639,35 @@ void PresentIndexedFramebuffer(void)
 		if (gGamePrefs.debugInfoInTitleBar && gGamePrefs.displayMode == kDisplayMode_Windowed)
 		{
 			float fps = 1000 * gDebugTextFrameAccumulator / (float)ticksElapsed;
+			float msPerTick = 1000.0f / (float) SDL_GetPerformanceFrequency() / (float) SDL_max(1, gRenderTimings.numFrames);
+			float msPerWaitTick = 1000.0f / (float) SDL_GetPerformanceFrequency() / (float) SDL_max(1, gPresentPipelineStats.numFrames);
+
+			// How much of the time that workers spent in job batches was actual work (100% = perfectly balanced)
+			uint64_t jobBusyTicks = 0;
+			uint64_t jobTotalTicks = 0;
+			for (int i = 0; i < GetNumJobWorkers(); i++)
+			{
+				const JobWorkerStats* stats = GetJobWorkerStats(i);
+				jobBusyTicks += stats->busyTicks;
+				jobTotalTicks += stats->busyTicks + stats->idleTicks;
+			}
+
 			SDL_snprintf(
 					gDebugTextBuffer, sizeof(gDebugTextBuffer),
-					"Mike%s %s scl:%c thr:%d fps:%d obj:%ld x:%ld y:%ld",
+					"Mike%s %s scl:%c thr:%d job:%d%% fps:%d rows:%d ms:%.1f/%.1f/%.1f/%.1f wait:%.1f/%.1f obj:%ld x:%ld y:%ld",
 					GAME_VERSION,
 					gRendererName,
 					'A' + gEffectiveScalingType,
 					gNumThreads,
+					(int)(100 * jobBusyTicks / SDL_max(1, jobTotalTicks)),
 					(int)roundf(fps),
+					(int)(gDebugTextRowAccumulator / gDebugTextFrameAccumulator),
+					gRenderTimings.map * msPerTick,			// map/convert/upload/swap
+					gRenderTimings.convert * msPerTick,
+					gRenderTimings.upload * msPerTick,
+					gRenderTimings.swap * msPerTick,
+					gPresentPipelineStats.mainWaitTicks * msPerWaitTick,		// main/present thread
+					gPresentPipelineStats.presentWaitTicks * msPerWaitTick,
 					NumObjects,
 					gMyX,
 					gMyY
@@ -497,8 +675,17 @@ void PresentIndexedFramebuffer(void)
 			SDL_SetWindowTitle(gSDLWindow, gDebugTextBuffer);
 		}
 		gDebugTextFrameAccumulator = 0;
+		gDebugTextRowAccumulator = 0;
+		SDL_zero(gRenderTimings);
+		ResetJobWorkerStats();
+		SDL_zero(gPresentPipelineStats);
 		gDebugTextLastUpdatedAt = ticksNow;
 	}
+
+	//-------------------------------------------------------------------------
+	// Present framebuffer (possibly on the present thread)
+
+	SubmitFrameForPresentation();
 }
 
 static void MoveToPreferredDisplay(void)
@@ -517,6 +704,14 @@ static void MoveToPreferredDisplay(void)
 
 void SetFullscreenMode(bool enforceDisplayPref)
 {
+	FlushPresentPipeline();
+
+	if (gHeadless)		// no window to speak of
+	{
+		OnChangeIntegerScaling();
+		return;
+	}
+
 #if OSXPPC
 	if (gGamePrefs.displayMode == kDisplayMode_Windowed)
 	{
@@ -577,6 +772,10 @@ void SetFullscreenMode(bool enforceDisplayPref)
     SetOptimalWindowSize();
 	OnChangeIntegerScaling();
 
+	// The tweened game loop's frame stats are relative to the refresh rate of the display we ended up on
+	const SDL_DisplayMode* displayMode = SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(gSDLWindow));
+	SetDisplayRefreshRate(displayMode ? displayMode->refresh_rate : 0);
+
 	if (gGamePrefs.displayMode == kDisplayMode_Windowed)
 		SDL_ShowCursor();
 	else
@@ -619,6 +818,13 @@ int GetMaxIntegerZoomForPreferredDisplay(void)
 
 void SetOptimalWindowSize(void)
 {
+	FlushPresentPipeline();
+
+	if (gHeadless)
+	{
+		return;
+	}
+
 	SDL_WindowFlags windowFlags = SDL_GetWindowFlags(gSDLWindow);
 	SDL_RestoreWindow(gSDLWindow);
 
@@ -676,6 +882,11 @@ static int GetEffectiveScalingType(void)
 	int windowWidth = VISIBLE_WIDTH;
 	int windowHeight = VISIBLE_HEIGHT;
 
+	if (gHeadless)		// we're rendering into memory at 1:1
+	{
+		return kScaling_PixelPerfect;
+	}
+
 	SDL_GetWindowSizeInPixels(gSDLWindow, &windowWidth, &windowHeight);
 
 	if (windowWidth < VISIBLE_WIDTH || windowHeight < VISIBLE_HEIGHT)
@@ -716,16 +927,42 @@ static int GetEffectiveScalingType(void)
 		}
 		else
 		{
-			return gCanDoHQStretch ? kScaling_HQStretch : kScaling_Stretch;
+			return gMaxPrescale >= 2 ? kScaling_HQStretch : kScaling_Stretch;
 		}
 	}
 }
 
+// HQ stretch: prescale the image on the CPU by the integer factor that's closest
+// to the window's zoom level, so the GPU only has a small fraction left to filter.
+static int GetPrescaleFactor(void)
+{
+	if (gEffectiveScalingType != kScaling_HQStretch)
+	{
+		return 1;
+	}
+
+	int windowWidth = VISIBLE_WIDTH;
+	int windowHeight = VISIBLE_HEIGHT;
+	SDL_GetWindowSizeInPixels(gSDLWindow, &windowWidth, &windowHeight);
+
+	float zoomX = windowWidth / (float)VISIBLE_WIDTH;
+	float zoomY = windowHeight / (float)VISIBLE_HEIGHT;
+	int factor = (int) (SDL_min(zoomX, zoomY) + 0.5f);
+
+	return SDL_clamp(factor, 2, gMaxPrescale);
+}
+
 void OnChangeIntegerScaling(void)
 {
+	FlushPresentPipeline();
+
 	gEffectiveScalingType = GetEffectiveScalingType();
+	gPrescale = GetPrescaleFactor();
 
+	if (gHeadless)
+		NullRender_InitTexture();
 #if !(GLRENDER)
-	SDLRender_InitTexture();
+	else
+		SDLRender_InitTexture();
 #endif
 }
@@ -297,6 +297,8 @@ const int	radarCenterY = gGamePrefs.pfSize == PFSIZE_SMALL ? RADAR_CENTER_Y : ((
 
 	PlaySound(SOUND_RADAR);
 
+	ResolvePlayfieldView();
+
 	Ptr destPtr = (Ptr) gScreenLookUpTable[radarCenterY - height/2] + (radarCenterX - width/2);
 	Ptr srcPtr = *imageHandle;
 
@@ -26,8 +26,22 @@
 #include "enemy4.h"
 #include "enemy5.h"
 #include "racecar.h"
+#include "jobs.h"
 #include "externs.h"
 
+/****************************/
+/*    PROTOTYPES            */
+/****************************/
+
+static uint8_t BuildTileMask(const uint8_t *srcPtr, uint8_t *destPtr, long destRowBytes);
+static uint8_t DrawTileMask(unsigned short tileNum, int xlate, const uint8_t *srcPtr, uint8_t *destPtr, long destRowBytes);
+static void ResetMapChunks(void);
+static void BuildQueuedMapChunks(void);
+static void DrawMapRect(long top, long left, long numRows, long numCols, long aheadRows, long aheadCols);
+static void ResetTileAnimCells(void);
+static void SetCellTile(long row, long col, unsigned short tileNum);
+
+
 /****************************/
 /*    CONSTANTS             */
 /****************************/
@@ -56,10 +70,27 @@ long	PF_WINDOW_LEFT	=	24;				// left MUST be on 4 pixel boundary!!!!!
 
 #define	VIEW_FACTOR		100				// amount to shift view for look-space
 
-#define	MAX_PLAYFIELD_WIDTH	1000L		// max tiles wide the PF will ever be
-
 #define	MAX_TILE_ANIMS	50						// max # of tile anims
 
+#define	MAP_CHUNK_TILES_SH		3								// map chunks are 8x8 tiles
+#define	MAP_CHUNK_TILES			(1<<MAP_CHUNK_TILES_SH)
+#define	MAP_CHUNK_SIZE			(MAP_CHUNK_TILES*TILE_SIZE)		// chunk width & height in pixels
+#define	MAX_MAP_CHUNKS			32								// # chunks kept in the cache
+#define	MAX_MAP_CHUNK_BATCH		16								// max # chunks built in one go
+#define	MAX_LOOKAHEAD_CHUNKS_PER_FRAME	2						// queued chunks built per ScrollPlayfield
+
+#define	kMapChunksHint			"MIGHTYMIKE_MAP_CHUNKS"
+
+typedef struct
+{
+	short		chunkRow,chunkCol;								// chunk coords in map, -1 if slot unused
+	uint32_t	lastUsed;										// LRU stamp
+	Boolean		built;											// false: slot reserved, waiting in gQueuedMapChunks
+	uint8_t		pixels[MAP_CHUNK_SIZE*MAP_CHUNK_SIZE];
+	uint8_t		mask[MAP_CHUNK_SIZE*MAP_CHUNK_SIZE];
+	uint8_t		maskStates[MAP_CHUNK_TILES*MAP_CHUNK_TILES];	// kTileMask_xxx per tile
+}MapChunk;
+
 
 
 
@@ -80,13 +111,18 @@ short			gPlayfieldWidth,gPlayfieldHeight;
 
 static	Byte	**gAlternateMap = nil;
 
+static	uint32_t	*gPriorityTileBits = nil;						// 1 bit per map tile: set if TILE_PRIORITY_MASK
+static	long		gPriorityTileWordsPerRow = 0;
+
 static	long	gOldScrollX,gOldScrollY;
 long			gScrollX,gScrollY;
 long			gTweenedScrollX,gTweenedScrollY;
 long			gScrollRow,gScrollCol,gOldScrollRow,gOldScrollCol;
 
 short			gNumItems = -1;
-static	ObjectEntryType	**gItemLookupTableX = nil;
+static	long			*gItemColumnStarts = nil;			// gPlayfieldTileWidth+1 entries: where each column's items start in gItemColumnItems
+static	int16_t			*gItemColumnItems = nil;			// item #'s grouped by column, then sorted by row
+static	int16_t			*gItemScanBuffer = nil;				// scratch for ScanForPlayfieldItems (as big as the fullest column)
 ObjectEntryType *gMasterItemList = nil;
 
 TileAttribType	*gTileAttributes;
@@ -97,18 +133,38 @@ static	Rect			gViewWindow,gTargetViewWindow;
 
 static	Boolean			gColorMaskArray[256];							// array of xparent tile colors, false = xparent
 
+static	int				gNumTileMasks = 0;								// # tile definitions with a precomputed mask
+static	uint8_t			*gTileMasks = nil;								// pixel accurate mask of each tile definition (TILE_SIZE*TILE_SIZE)
+static	uint8_t			*gTileMaskStates = nil;							// what each of those masks looks like (kTileMask_xxx)
+
 static	Boolean			gAltMapFlag = false;
 
 static	long			gShakeyScreenCount = 0;
 static	long			gShakeyScreenOffsetX = 0;
 static	long			gShakeyScreenOffsetY = 0;
 
-static	Ptr				gMaxItemAddress;								// addr of last item in current item list
-
 // Source port note: moved from TileAnim.c
 static	short			gNumTileAnims;
 static	TileAnimEntryType	gTileAnims[MAX_TILE_ANIMS];
 
+					// Where the animated tiles are in the PF buffer. Each distinct animated base tile gets a "slot"
+					// holding the list of PF buffer cells (row*PF_TILE_WIDTH+col) that currently show it.
+
+static	short			gNumTileAnimSlots = 0;
+static	short			gTileAnimSlots[MAX_TILE_ANIMS];						// slot of each tile anim, -1 if none
+static	uint8_t			gTileAnimSlotOfTile[TILENUM_MASK+1];				// slot+1 of each tile #, 0 if not animated
+static	short			gTileAnimSlotNumCells[MAX_TILE_ANIMS];
+static	long			gNumTileAnimCells = 0;								// # cells in PF buffer when the index was allocated
+static	int16_t			*gTileAnimSlotCells = nil;							// MAX_TILE_ANIMS lists of gNumTileAnimCells cells
+static	uint8_t			*gCellTileAnimSlots = nil;							// slot+1 of each PF buffer cell, 0 if not animated
+static	int16_t			*gCellTileAnimSlotIndex = nil;						// where each cell is in its slot's list
+
+static	MapChunk		*gMapChunks = nil;								// cache of pre-rendered map chunks
+static	int				gUseMapChunks = -1;								// -1: hint not read yet
+static	uint32_t		gMapChunkClock = 0;
+static	MapChunk		*gQueuedMapChunks[MAX_MAP_CHUNKS];				// look-ahead chunks to build over the next frames
+static	int				gNumQueuedMapChunks = 0;
+
 
 /**********************/
 /*     TABLES         */
@@ -177,6 +233,8 @@ static	Boolean	(*gItemAddPtrs[])(ObjectEntryType *) = {
 
 void OnChangePlayfieldSize(void)
 {
+	FlushPresentPipeline();				// don't pull the rug from under the present thread
+
 	switch (gGamePrefs.pfSize)
 	{
 	case PFSIZE_SMALL:
@@ -252,10 +310,15 @@ Ptr tileAnimList				= nil;
 int16_t* tileXparentList		= nil;
 
 	ClearTileColorMasks();									// clear this to begin with
+	ResetMapChunks();										// cached chunks were rendered with the old tiles
 
 	if (gTileSetHandle != nil)								// see if zap old tileset
 		DisposeHandle(gTileSetHandle);
 
+	CHECKED_DISPOSEPTR(gTileMasks);
+	CHECKED_DISPOSEPTR(gTileMaskStates);
+	gNumTileMasks = 0;
+
 	gTileSetHandle = LoadPackedFile(fileName);				// load the file
 	tileSetPtr = *gTileSetHandle;							// get fixed ptr
 
@@ -338,6 +401,28 @@ int16_t* tileXparentList		= nil;
 		currentTileAnimData += 16 + 2*3 + 2*tileAnimDef->numFrames;
 	}
 
+			/* ASSIGN SLOTS TO ANIMATED BASE TILES */
+
+	SDL_zeroa(gTileAnimSlotOfTile);
+	gNumTileAnimSlots = 0;
+	for (int i = 0; i < gNumTileAnims; i++)
+	{
+		uint16_t baseTile = gTileAnims[i].defPtr->baseTile;
+
+		if (baseTile > TILENUM_MASK)										// can never match a map tile
+		{
+			gTileAnimSlots[i] = -1;
+			continue;
+		}
+
+		if (gTileAnimSlotOfTile[baseTile] == 0)								// several anims may share a base tile
+			gTileAnimSlotOfTile[baseTile] = ++gNumTileAnimSlots;
+
+		gTileAnimSlots[i] = gTileAnimSlotOfTile[baseTile] - 1;
+	}
+
+	ResetTileAnimCells();													// cells were indexed with the old slots
+
 
 	/******************** SET TILE COLOR MASKS *********************/
 	//
@@ -352,6 +437,27 @@ int16_t* tileXparentList		= nil;
 
 		gColorMaskArray[tileXparentList[i]] = false;
 	}
+
+
+	/******************** PRECOMPUTE TILE MASKS *********************/
+	//
+	// Source port note: DrawATile used to look up every pixel of a tile in gColorMaskArray
+	// each time it drew a pixel accurate mask. Now the masks are built once here.
+	// Size the table by the space between the tile definitions & the xlate table.
+	//
+
+	gNumTileMasks = (offsetToXlateTable - 2 - offsetToTileDefinitions) >> (TILE_SIZE_SH*2);
+	gTileMasks = (uint8_t*) NewPtr(SDL_max(1, gNumTileMasks) << (TILE_SIZE_SH*2));
+	gTileMaskStates = (uint8_t*) NewPtr(SDL_max(1, gNumTileMasks));
+	GAME_ASSERT(gTileMasks);
+	GAME_ASSERT(gTileMaskStates);
+
+	for (int i = 0; i < gNumTileMasks; i++)
+	{
+		gTileMaskStates[i] = BuildTileMask((const uint8_t*) gTilesPtr + (i << (TILE_SIZE_SH*2)),
+											gTileMasks + (i << (TILE_SIZE_SH*2)),
+											TILE_SIZE);
+	}
 }
 
 
@@ -380,6 +486,18 @@ void DisposeCurrentMapData(void)
 		gAlternateMap = nil;
 	}
 
+	CHECKED_DISPOSEPTR(gPriorityTileBits);
+	gPriorityTileWordsPerRow = 0;
+
+	ResetMapChunks();								// empty the look-ahead queue, it points into the cache
+	CHECKED_DISPOSEPTR(gMapChunks);
+
+	CHECKED_DISPOSEPTR(gTileAnimSlotCells);
+	CHECKED_DISPOSEPTR(gCellTileAnimSlots);
+	CHECKED_DISPOSEPTR(gCellTileAnimSlotIndex);
+	gNumTileAnimCells = 0;
+	SDL_zeroa(gTileAnimSlotNumCells);
+
 
 	if (gTileSetHandle != nil)						// see if zap old tileset
 	{
@@ -387,9 +505,17 @@ void DisposeCurrentMapData(void)
 		gTileSetHandle = nil;
 	}
 
+	CHECKED_DISPOSEPTR(gTileMasks);
+	CHECKED_DISPOSEPTR(gTileMaskStates);
+	gNumTileMasks = 0;
+
 	gNumItems = -1;
 	gMasterItemList = nil;	// this is just a pointer within gPlayfieldHandle, no need to dispose of it
 
+	CHECKED_DISPOSEPTR(gItemColumnStarts);
+	CHECKED_DISPOSEPTR(gItemColumnItems);
+	CHECKED_DISPOSEPTR(gItemScanBuffer);
+
 }
 
 
@@ -406,6 +532,8 @@ Ptr		bytePtr,pfPtr;
 
 	gPlayfieldHandle = LoadPackedFile(fileName);					// load the file
 
+	ResetMapChunks();												// cached chunks are from another map
+
 	pfPtr = *gPlayfieldHandle;										// get fixed ptr
 
 
@@ -430,6 +558,21 @@ Ptr		bytePtr,pfPtr;
 		tempPtr += gPlayfieldTileWidth;								// next row
 	}
 
+			/* BUILD PRIORITY TILE BITSET */
+
+	gPriorityTileWordsPerRow = (gPlayfieldTileWidth + 31) / 32;
+	gPriorityTileBits = (uint32_t *)NewPtrClear(sizeof(uint32_t) * SDL_max(1, gPriorityTileWordsPerRow * gPlayfieldTileHeight));
+	GAME_ASSERT(gPriorityTileBits);
+	for (int row = 0; row < gPlayfieldTileHeight; row++)
+	{
+		uint32_t* rowBits = gPriorityTileBits + row * gPriorityTileWordsPerRow;
+		for (int col = 0; col < gPlayfieldTileWidth; col++)
+		{
+			if (gPlayfield[row][col] & TILE_PRIORITY_MASK)
+				rowBits[col >> 5] |= 1u << (col & 31);
+		}
+	}
+
 
 			/* GET ALTERNATE MAP */
 
@@ -511,7 +654,6 @@ const uint8_t* MM_GetPriorityColorMask(void)
 
 void InitPlayfield(void)
 {
-long		row,col,x,y,col2;
 long		right,left,top,bottom;
 
 				/* INIT PLAYFIELD CLIPPING REGION */
@@ -562,22 +704,23 @@ long		right,left,top,bottom;
 	gScrollRow = gOldScrollRow = gScrollY>>TILE_SIZE_SH;		// calc scroll tile row/col
 	gScrollCol = gOldScrollCol = gScrollX>>TILE_SIZE_SH;
 
-	row = gScrollRow % PF_TILE_HEIGHT;							// calc row in buffer
-	col = gScrollCol % PF_TILE_WIDTH;							// calc col in buffer
+			/* ALLOC ANIMATED TILE INDEX FOR THIS PF SIZE */
 
-	for (y = 0; y < PF_TILE_HEIGHT; y++)
-	{
-		col2 = col;
-		for (x = 0; x < PF_TILE_WIDTH; x++)
-		{
-			DrawATile(gPlayfield[gScrollRow+y][gScrollCol+x],row,col2,true);
+	CHECKED_DISPOSEPTR(gTileAnimSlotCells);
+	CHECKED_DISPOSEPTR(gCellTileAnimSlots);
+	CHECKED_DISPOSEPTR(gCellTileAnimSlotIndex);
 
-			if (++col2 >= PF_TILE_WIDTH)
-				col2 = 0;
-		}
-		if (++row >= PF_TILE_HEIGHT)
-			row = 0;
-	}
+	gNumTileAnimCells		= PF_TILE_HEIGHT * PF_TILE_WIDTH;
+	gTileAnimSlotCells		= (int16_t*) NewPtr(sizeof(int16_t) * MAX_TILE_ANIMS * gNumTileAnimCells);
+	gCellTileAnimSlots		= (uint8_t*) NewPtr(gNumTileAnimCells);
+	gCellTileAnimSlotIndex	= (int16_t*) NewPtr(sizeof(int16_t) * gNumTileAnimCells);
+	GAME_ASSERT(gTileAnimSlotCells);
+	GAME_ASSERT(gCellTileAnimSlots);
+	GAME_ASSERT(gCellTileAnimSlotIndex);
+
+	ResetTileAnimCells();
+
+	DrawMapRect(gScrollRow,gScrollCol,PF_TILE_HEIGHT,PF_TILE_WIDTH,0,0);
 
 				/* ADD ITEMS IN THIS AREA */
 
@@ -605,15 +748,20 @@ long		right,left,top,bottom;
 //
 // Build sorted lists of playfield items
 //
+// Source port note: items used to be looked up through a table of the first item in each
+// column (gItemLookupTableX, capped at 1000 columns), and then every item in the column
+// range had its row checked. Now each column's items are sorted by row, so a scan
+// only visits the items that are actually in its rect. Any map width works.
+//
 
 void BuildItemList(void)
 {
 long	offset;
-long	col,itemCol,itemNum,nextCol,prevCol;
-ObjectEntryType *lastPtr;
+long	col,itemCol,itemNum,i,j,maxItemsInColumn;
 
-	if	(gPlayfieldTileWidth > MAX_PLAYFIELD_WIDTH)				// see if bigger than max allowed
-		DoFatalAlert("gPlayfieldTileWidth is greater than MAX_PLAYFIELD_WIDTH!");
+	CHECKED_DISPOSEPTR(gItemColumnStarts);
+	CHECKED_DISPOSEPTR(gItemColumnItems);
+	CHECKED_DISPOSEPTR(gItemScanBuffer);
 
 					/* GET BASIC INFO */
 
@@ -630,27 +778,59 @@ ObjectEntryType *lastPtr;
 
 	UnpackStructs(">2ih4b", sizeof(ObjectEntryType), gNumItems, gMasterItemList);
 
-				/* BUILD HORIZ LOOKUP TABLE */
+				/* COUNT ITEMS IN EACH COLUMN */
+
+	gItemColumnStarts = (long *)NewPtrClear(sizeof(long) * (gPlayfieldTileWidth+1));
+	gItemColumnItems = (int16_t *)NewPtr(sizeof(int16_t) * gNumItems);
+	GAME_ASSERT(gItemColumnStarts);
+	GAME_ASSERT(gItemColumnItems);
 
-	gMaxItemAddress = (Ptr)&gMasterItemList[gNumItems-1];		// remember addr of last item
-	lastPtr = &gMasterItemList[0];
-	nextCol = 0;												// start @ col 0
-	prevCol = -1;
 	for (itemNum = 0; itemNum < gNumItems; itemNum++)
 	{
 		itemCol = gMasterItemList[itemNum].x>>TILE_SIZE_SH;		// get column of item
-		if (itemCol != prevCol)									// see if changed
+		if (itemCol >= 0 && itemCol < gPlayfieldTileWidth)		// items off the map can never be scanned
+			gItemColumnStarts[itemCol+1]++;
+	}
+
+	maxItemsInColumn = 0;
+	for (col = 0; col < gPlayfieldTileWidth; col++)
+	{
+		maxItemsInColumn = SDL_max(maxItemsInColumn, gItemColumnStarts[col+1]);
+		gItemColumnStarts[col+1] += gItemColumnStarts[col];		// counts -> start offsets
+	}
+
+	gItemScanBuffer = (int16_t *)NewPtr(sizeof(int16_t) * SDL_max(1, maxItemsInColumn));
+	GAME_ASSERT(gItemScanBuffer);
+
+				/* FILE ITEMS BY COLUMN */
+
+	long* nextSlot = (long *)NewPtr(sizeof(long) * gPlayfieldTileWidth);
+	GAME_ASSERT(nextSlot);
+	SDL_memcpy(nextSlot, gItemColumnStarts, sizeof(long) * gPlayfieldTileWidth);
+
+	for (itemNum = 0; itemNum < gNumItems; itemNum++)			// stays in list order within each column
+	{
+		itemCol = gMasterItemList[itemNum].x>>TILE_SIZE_SH;
+		if (itemCol >= 0 && itemCol < gPlayfieldTileWidth)
+			gItemColumnItems[nextSlot[itemCol]++] = itemNum;
+	}
+
+	DisposePtr((Ptr)nextSlot);
+
+				/* SORT EACH COLUMN BY ROW */
+
+	for (col = 0; col < gPlayfieldTileWidth; col++)
+	{
+		for (i = gItemColumnStarts[col]+1; i < gItemColumnStarts[col+1]; i++)	// insertion sort keeps list order within a row
 		{
-			for (col = nextCol; col <= itemCol; col++)			// filler pointers
-				gItemLookupTableX[col] = &gMasterItemList[itemNum];
-			prevCol = itemCol;
-			nextCol = itemCol+1;
-			lastPtr = &gMasterItemList[itemNum];
+			int16_t	item = gItemColumnItems[i];
+			long	row = gMasterItemList[item].y>>TILE_SIZE_SH;
+
+			for (j = i; j > gItemColumnStarts[col] && (gMasterItemList[gItemColumnItems[j-1]].y>>TILE_SIZE_SH) > row; j--)
+				gItemColumnItems[j] = gItemColumnItems[j-1];
+			gItemColumnItems[j] = item;
 		}
 	}
-	for (col = nextCol; col < gPlayfieldTileWidth; col++)		// set trailing column pointers
-		gItemLookupTableX[col] = lastPtr;
-
 }
 
 
@@ -709,6 +889,10 @@ void ScrollPlayfield(void)
 			ScrollPlayfield_Left();
 	}
 
+			/* BUILD SOME OF THE MAP CHUNKS WE'LL SCROLL INTO NEXT */
+
+	BuildQueuedMapChunks();
+
 			/* CALC ITEM OUTER BOUNDARY WINDOW */
 
 	SetItemDeleteWindow();
@@ -743,22 +927,13 @@ void SetItemDeleteWindow(void)
 
 void ScrollPlayfield_Down(void)
 {
-long	row,col,x,mapRow,right;
+long	x,mapRow,right;
 
 				/* UPDATE TILES */
 
 	mapRow = gScrollRow+(PF_TILE_HEIGHT-1);						// calc row in map matrix
 
-	row = mapRow % PF_TILE_HEIGHT;								// calc row in buffer
-	col = gScrollCol % PF_TILE_WIDTH;							// calc col in buffer
-
-	for (x = 0; x < PF_TILE_WIDTH; x++)
-	{
-		DrawATile(gPlayfield[mapRow][gScrollCol+x],row,col,true);
-
-		if (++col >= PF_TILE_WIDTH)
-			col = 0;
-	}
+	DrawMapRect(mapRow,gScrollCol,1,PF_TILE_WIDTH,1,0);
 
 				/* UPDATE ITEMS */
 
@@ -780,19 +955,11 @@ long	row,col,x,mapRow,right;
 
 void ScrollPlayfield_Up(void)
 {
-long	row,col,x,right;
+long	row,x,right;
 
 				/* UPDATE TILES */
 
-	row = gScrollRow % PF_TILE_HEIGHT;								// calc row in buffer
-	col = gScrollCol % PF_TILE_WIDTH;								// calc col in buffer
-
-	for (x = 0; x < PF_TILE_WIDTH; x++)
-	{
-		DrawATile(gPlayfield[gScrollRow][gScrollCol+x],row,col,true);
-		if (++col >= PF_TILE_WIDTH)
-			col = 0;
-	}
+	DrawMapRect(gScrollRow,gScrollCol,1,PF_TILE_WIDTH,-1,0);
 
 
 				/* UPDATE ITEMS */
@@ -819,20 +986,13 @@ long	row,col,x,right;
 
 void ScrollPlayfield_Right(void)
 {
-long	row,col,y,mapCol,mapRowTop,mapRowBot;
+long	mapCol,mapRowTop,mapRowBot;
 
 				/* UPDATE TILES */
 
 	mapCol = gScrollCol+(PF_TILE_WIDTH-1);						// calc col in map matrix
-	row = gScrollRow % PF_TILE_HEIGHT;							// calc row in buffer
-	col = mapCol  % PF_TILE_WIDTH;								// calc col in buffer
 
-	for (y = 0; y < PF_TILE_HEIGHT; y++)
-	{
-		DrawATile(gPlayfield[gScrollRow+y][mapCol],row,col,true);
-		if (++row >= PF_TILE_HEIGHT)
-			row = 0;
-	}
+	DrawMapRect(gScrollRow,mapCol,PF_TILE_HEIGHT,1,0,1);
 
 				/* UPDATE ITEMS */
 
@@ -855,19 +1015,11 @@ long	row,col,y,mapCol,mapRowTop,mapRowBot;
 
 void ScrollPlayfield_Left(void)
 {
-long	row,col,y,mapRowTop,mapRowBot,mapCol;
+long	mapRowTop,mapRowBot,mapCol;
 
 				/* UPDATE TILES */
 
-	row = gScrollRow % PF_TILE_HEIGHT;							// calc row in buffer
-	col = gScrollCol  % PF_TILE_WIDTH;								// calc col in buffer
-
-	for (y = 0; y < PF_TILE_HEIGHT; y++)
-	{
-		DrawATile(gPlayfield[gScrollRow+y][gScrollCol],row,col,true);
-		if (++row >= PF_TILE_HEIGHT)
-			row = 0;
-	}
+	DrawMapRect(gScrollRow,gScrollCol,PF_TILE_HEIGHT,1,0,-1);
 
 				/* UPDATE ITEMS */
 
@@ -895,19 +1047,49 @@ long	row,col,y,mapRowTop,mapRowBot,mapCol;
 void ScanForPlayfieldItems(long top, long bottom, long left, long right)
 {
 ObjectEntryType *itemPtr;
-long	row,type;
+long	col,first,last,mid,i,j,numFound,type;
 Boolean		flag;
 
-	if (gNumItems == 0)
+	if (gNumItems <= 0 || gItemColumnStarts == nil)
 		return;
 
-	itemPtr = gItemLookupTableX[left];								// get pointer to 1st item at this X
+	left = SDL_max(left, 0);
+	right = SDL_min(right, gPlayfieldTileWidth-1);
 
-	while (((itemPtr->x>>TILE_SIZE_SH) >= left) && ((itemPtr->x>>TILE_SIZE_SH) <= right))	// check all items in this column range
+	for (col = left; col <= right; col++)							// check all items in this column range
 	{
-		row = itemPtr->y>>TILE_SIZE_SH;
-		if ((row >= top) && (row <= bottom))						// & this row range
+				/* FIND 1ST ITEM AT OR BELOW TOP ROW */
+
+		first = gItemColumnStarts[col];
+		last = gItemColumnStarts[col+1];
+		while (first < last)
+		{
+			mid = (first + last) / 2;
+			if ((gMasterItemList[gItemColumnItems[mid]].y>>TILE_SIZE_SH) < top)
+				first = mid+1;
+			else
+				last = mid;
+		}
+
+				/* GET ITEMS IN THIS ROW RANGE, IN LIST ORDER */
+
+		numFound = 0;
+		for (i = first; i < gItemColumnStarts[col+1]; i++)
+		{
+			int16_t item = gItemColumnItems[i];
+
+			if ((gMasterItemList[item].y>>TILE_SIZE_SH) > bottom)
+				break;
+
+			for (j = numFound++; j > 0 && gItemScanBuffer[j-1] > item; j--)	// rows are sorted, but items get added in list order
+				gItemScanBuffer[j] = gItemScanBuffer[j-1];
+			gItemScanBuffer[j] = item;
+		}
+
+		for (i = 0; i < numFound; i++)
 		{
+			itemPtr = &gMasterItemList[gItemScanBuffer[i]];
+
 					/* ADD AN ITEM */
 
 			if (!(itemPtr->type&ITEM_IN_USE))						// see if item available
@@ -923,9 +1105,6 @@ Boolean		flag;
 				}
 			}
 		}
-		itemPtr++;													// point to next item
-		if ((Ptr) itemPtr > gMaxItemAddress)						// see if its past the last address
-			break;
 	}
 }
 
@@ -1290,20 +1469,34 @@ Boolean NilAdd(ObjectEntryType *itemPtr)
 }
 
 
-/******************* CREATE PLAYFIELD PERMANENT MEMORY ***********************/
+/******************* CHECK PRIORITY TILES ***********************/
 //
-// Create playfield memory items that ARE NEVER PURGED.. EVER!
+// Returns true if any tile from leftCol to rightCol (inclusive) in a map row has priority.
 //
 
-void CreatePlayfieldPermanentMemory(void)
+Boolean CheckPriorityTiles(long row, long leftCol, long rightCol)
 {
-Handle		tempHand;
+	if (row < 0 || row >= gPlayfieldTileHeight)
+		return false;
+
+	leftCol = SDL_max(leftCol, 0);
+	rightCol = SDL_min(rightCol, gPlayfieldTileWidth - 1);
+
+	const uint32_t* rowBits = gPriorityTileBits + row * gPriorityTileWordsPerRow;
+
+	for (long col = leftCol; col <= rightCol; col = (col | 31) + 1)			// one word at a time
+	{
+		uint32_t bits = rowBits[col >> 5] >> (col & 31);					// drop bits left of col
+
+		long numCols = SDL_min(rightCol - col + 1, 32 - (col & 31));
+		if (numCols < 32)
+			bits &= (1u << numCols) - 1;									// drop bits right of rightCol
 
-				/* ALLOC MEMORY FOR ITEM LOOKUP TABLE */
+		if (bits)
+			return true;
+	}
 
-	tempHand = NewHandleClear(sizeof(ObjectEntryType *)*MAX_PLAYFIELD_WIDTH);
-	GAME_ASSERT(tempHand);
-	gItemLookupTableX = (ObjectEntryType **)*tempHand;
+	return false;
 }
 
 
@@ -1312,12 +1505,10 @@ Handle		tempHand;
 void DrawATile(unsigned short tileNum, short row, short col, Boolean maskFlag)
 {
 unsigned char *destPtr,*srcPtr,*destCopyPtr;
-long		height,i;
+long		height;
 Ptr			destStartPtr,destCopyStartPtr;
 unsigned char	*copyOfSrc;
 unsigned long	rowS,colS;								// shifted version of row & col
-Byte		pixel;
-Ptr			destPtrB,srcPtrB;
 
 					/* CALC DEST POINTERS */
 
@@ -1339,8 +1530,9 @@ Ptr			destPtrB,srcPtrB;
 	height = TILE_SIZE;
 	do
 	{
-		for (i = 0; i < TILE_SIZE; i++)
-			destPtr[i] = destCopyPtr[i] = *srcPtr++;
+		SDL_memcpy(destPtr,		srcPtr,	TILE_SIZE);
+		SDL_memcpy(destCopyPtr,	srcPtr,	TILE_SIZE);
+		srcPtr += TILE_SIZE;
 
 		destPtr += PF_BUFFER_WIDTH;							// next line
 		destCopyPtr += PF_BUFFER_WIDTH;
@@ -1353,288 +1545,539 @@ Ptr			destPtrB,srcPtrB;
 
 	if (maskFlag)
 	{
-		destPtr = (unsigned char *)(gPFMaskLookUpTable[rowS]+colS);
-		if (tileNum&TILE_PRIORITY_MASK)
-		{
-			if (tileNum&TILE_PRIORITY_MASK2)						// see if do pixel accurate mask or just tile mask
-			{
+		// keep track of what the mask looks like in this cell
+		gPFTileMaskStates[row * PF_TILE_WIDTH + col] = DrawTileMask(tileNum, xlate, copyOfSrc, gPFMaskLookUpTable[rowS]+colS, PF_BUFFER_WIDTH);
+	}
+}
 
-						/* DRAW PIXEL TILE MASK */
 
-				destPtrB = (Ptr)destPtr;
-				srcPtrB = (Ptr)copyOfSrc;
-				height = TILE_SIZE;
-				do
-				{
-					for (i=0; i < TILE_SIZE; i++)
-					{
-						pixel = *srcPtrB++;							// get pixel value
+/************************ BUILD TILE MASK ***********************/
+//
+// Builds the pixel accurate priority mask for a tile whose pixels are at srcPtr,
+// and returns what the mask looks like (kTileMask_xxx).
+//
 
-						if (gColorMaskArray[pixel])
-							*destPtrB++ = 0xff;						// make xparent
-						else
-							*destPtrB++ = 0x00;						// make solid
-					}
-					destPtrB += PF_BUFFER_WIDTH-TILE_SIZE;			// next line
-				} while(--height);
+static uint8_t BuildTileMask(const uint8_t *srcPtr, uint8_t *destPtr, long destRowBytes)
+{
+long		height,i;
+Boolean		anyMasked = false;
+Boolean		anyUnmasked = false;
 
+	height = TILE_SIZE;
+	do
+	{
+		for (i=0; i < TILE_SIZE; i++)
+		{
+			if (gColorMaskArray[*srcPtr++])
+			{
+				destPtr[i] = 0xff;						// make xparent
+				anyMasked = true;
 			}
-							/* DRAW WHOLE TILE MASK */
 			else
 			{
-				height = TILE_SIZE;
-				do
-				{
-					for (i = 0; i < TILE_SIZE; i++)
-						destPtr[i] = 0xff;
-					destPtr += PF_BUFFER_WIDTH;			// next line
-				} while (--height);
+				destPtr[i] = 0x00;						// make solid
+				anyUnmasked = true;
 			}
 		}
-		else
-		{
-						/* CLEAR MASK HERE */
+		destPtr += destRowBytes;						// next line
+	} while(--height);
+
+	if (anyMasked && anyUnmasked)
+		return kTileMask_Pixels;
+	else
+		return anyMasked ? kTileMask_Solid : kTileMask_Clear;
+}
+
 
-			height = TILE_SIZE;
+/************************ DRAW TILE MASK ***********************/
+//
+// Draws the priority mask for a tile (xlate = its tile definition, whose pixels are at srcPtr),
+// and returns what the mask looks like (kTileMask_xxx).
+//
+
+static uint8_t DrawTileMask(unsigned short tileNum, int xlate, const uint8_t *srcPtr, uint8_t *destPtr, long destRowBytes)
+{
+long		height;
+uint8_t		maskState;
+const uint8_t	*maskPtr;
+
+	if (!(tileNum&TILE_PRIORITY_MASK))
+		maskState = kTileMask_Clear;
+	else
+	if (!(tileNum&TILE_PRIORITY_MASK2))						// see if do pixel accurate mask or just tile mask
+		maskState = kTileMask_Solid;
+	else
+	if (xlate >= 0 && xlate < gNumTileMasks)				// use precomputed mask
+		maskState = gTileMaskStates[xlate];
+	else
+		return BuildTileMask(srcPtr, destPtr, destRowBytes);	// tile isn't where the tile definitions are, do it the slow way
+
+	height = TILE_SIZE;
+	switch (maskState)
+	{
+		case kTileMask_Pixels:
+			maskPtr = gTileMasks + (xlate << (TILE_SIZE_SH*2));
 			do
 			{
-				for (i = 0; i < TILE_SIZE; i++)
-					destPtr[i] = 0;
-				destPtr += PF_BUFFER_WIDTH;			// next line
+				SDL_memcpy(destPtr, maskPtr, TILE_SIZE);
+				maskPtr += TILE_SIZE;
+				destPtr += destRowBytes;			// next line
 			} while (--height);
-		}
+			break;
+
+		case kTileMask_Solid:
+			do
+			{
+				SDL_memset(destPtr, 0xff, TILE_SIZE);
+				destPtr += destRowBytes;			// next line
+			} while (--height);
+			break;
+
+		default:
+			do
+			{
+				SDL_memset(destPtr, 0, TILE_SIZE);
+				destPtr += destRowBytes;			// next line
+			} while (--height);
+			break;
 	}
+
+	return maskState;
 }
 
 
+/************************ RESET MAP CHUNKS ***********************/
+//
+// Forgets all cached map chunks.  Call this when the map or the tileset changes.
+//
 
-/************************ DRAW A TILE : SIMPLE ***********************/
+static void ResetMapChunks(void)
+{
+	gNumQueuedMapChunks = 0;
+
+	if (gMapChunks == nil)
+		return;
+
+	for (int i = 0; i < MAX_MAP_CHUNKS; i++)
+	{
+		gMapChunks[i].chunkRow = -1;
+		gMapChunks[i].chunkCol = -1;
+		gMapChunks[i].lastUsed = 0;
+		gMapChunks[i].built = false;
+	}
+}
+
+
+/************************ BUILD MAP CHUNK JOB ***********************/
 //
-// This simple version doesnt worry about masks at all.
-// Assumes that tileNum has ALREADY BEEN FILTERED!
+// Renders one row of tiles (and their masks) of a map chunk.
+// Tiles that aren't in the map are left blank.
 //
 
-void DrawATile_Simple(unsigned short tileNum, short row, short col)
+static void BuildMapChunkJob(void* userData, int workerNum, int jobIndex)
 {
-uint8_t		*destPtr,*srcPtr,*destCopyPtr;
-Ptr			destStartPtr,destCopyStartPtr;
-unsigned long	rowS,colS;								// shifted version of row & col
+	(void) workerNum;
 
-					/* CALC DEST POINTERS */
+	MapChunk* chunk = ((MapChunk**) userData)[jobIndex >> MAP_CHUNK_TILES_SH];
+	long y = jobIndex & (MAP_CHUNK_TILES-1);
 
-	destStartPtr = (Ptr)(gPFLookUpTable[rowS = row<<TILE_SIZE_SH]+(colS = col<<TILE_SIZE_SH));
-	destCopyStartPtr = (Ptr)(gPFCopyLookUpTable[rowS]+colS);
+	long mapRowNum = (chunk->chunkRow << MAP_CHUNK_TILES_SH) + y;
+	long leftCol = chunk->chunkCol << MAP_CHUNK_TILES_SH;
+	long numCols = SDL_min(MAP_CHUNK_TILES, gPlayfieldTileWidth - leftCol);
 
-					/* CALC TILE DEFINITION ADDR */
+	if (mapRowNum >= gPlayfieldTileHeight)
+		return;
 
-	GAME_ASSERT(HandleBoundsCheck(gTileSetHandle, (Ptr) gTileXlatePtr));
-	GAME_ASSERT(HandleBoundsCheck(gTileSetHandle, (Ptr) &gTileXlatePtr[tileNum]));
+	const uint16_t* mapRow = gPlayfield[mapRowNum] + leftCol;
 
-	srcPtr = (uint8_t *)( gTilesPtr + ((long)(gTileXlatePtr[tileNum]) << (TILE_SIZE_SH*2)) );
-	destPtr = (uint8_t *)destStartPtr;
-	destCopyPtr = (uint8_t *)destCopyStartPtr;
+	for (long x = 0; x < numCols; x++)
+	{
+		unsigned short tileNum = mapRow[x];
 
-	GAME_ASSERT(HandleBoundsCheck(gTileSetHandle, (Ptr) srcPtr));
+		if (!HandleBoundsCheck(gTileSetHandle, (Ptr) &gTileXlatePtr[tileNum & TILENUM_MASK]))	// bad tile: DrawMapRect will complain if it's ever shown
+			continue;
 
-						/* DRAW THE TILE */
+		int xlate = gTileXlatePtr[tileNum & TILENUM_MASK];
+		const uint8_t* srcPtr = (const uint8_t*) (gTilesPtr + ((long)xlate << (TILE_SIZE_SH*2)));
+		long offset = ((y << TILE_SIZE_SH) * MAP_CHUNK_SIZE) + (x << TILE_SIZE_SH);
 
-	for (int y = 0; y < TILE_SIZE; y++)
+		uint8_t* destPtr = chunk->pixels + offset;
+		for (int i = 0; i < TILE_SIZE; i++)
+		{
+			SDL_memcpy(destPtr, srcPtr + (i << TILE_SIZE_SH), TILE_SIZE);
+			destPtr += MAP_CHUNK_SIZE;
+		}
+
+		chunk->maskStates[(y << MAP_CHUNK_TILES_SH) + x] = DrawTileMask(tileNum, xlate, srcPtr, chunk->mask + offset, MAP_CHUNK_SIZE);
+	}
+}
+
+
+/************************ BUILD MAP CHUNKS ***********************/
+//
+// Builds a batch of chunks across the job workers, one job per row of tiles.
+//
+
+static void BuildMapChunks(MapChunk** chunks, int numChunks)
+{
+	if (numChunks <= 0)
+		return;
+
+	RunParallelJobs(BuildMapChunkJob, chunks, numChunks << MAP_CHUNK_TILES_SH);
+
+	for (int i = 0; i < numChunks; i++)
+		chunks[i]->built = true;
+}
+
+
+/************************ BUILD QUEUED MAP CHUNKS ***********************/
+//
+// Builds a few of the look-ahead chunks queued by PrepareMapChunks, oldest first.
+// Called once per ScrollPlayfield, so that crossing into a new row or column of chunks
+// doesn't cost a whole row of chunks in a single frame.
+//
+
+static void BuildQueuedMapChunks(void)
+{
+MapChunk	*batch[MAX_LOOKAHEAD_CHUNKS_PER_FRAME];
+int			numInBatch = 0;
+int			numConsumed = 0;
+
+	while (numConsumed < gNumQueuedMapChunks && numInBatch < MAX_LOOKAHEAD_CHUNKS_PER_FRAME)
 	{
-		SDL_memcpy(destPtr,		srcPtr,	TILE_SIZE);
-		SDL_memcpy(destCopyPtr,	srcPtr,	TILE_SIZE);
-		destPtr		+= PF_BUFFER_WIDTH;			// next line
-		destCopyPtr	+= PF_BUFFER_WIDTH;
-		srcPtr		+= TILE_SIZE;
+		MapChunk* chunk = gQueuedMapChunks[numConsumed++];
+
+		if (!chunk->built && chunk->chunkRow >= 0)				// may have been built on a miss, or evicted, since it was queued
+			batch[numInBatch++] = chunk;
 	}
+
+	gNumQueuedMapChunks -= numConsumed;
+	SDL_memmove(gQueuedMapChunks, gQueuedMapChunks + numConsumed, sizeof(gQueuedMapChunks[0]) * gNumQueuedMapChunks);
+
+	BuildMapChunks(batch, numInBatch);
 }
 
 
+/************************ FIND MAP CHUNK ***********************/
 
-/********************* DISPLAY PLAYFIELD ***************/
+static MapChunk* FindMapChunk(long chunkRow, long chunkCol)
+{
+	for (int i = 0; i < MAX_MAP_CHUNKS; i++)
+	{
+		if (gMapChunks[i].chunkRow == chunkRow && gMapChunks[i].chunkCol == chunkCol)
+			return &gMapChunks[i];
+	}
+
+	return nil;
+}
+
+
+/************************ PREPARE MAP CHUNKS ***********************/
 //
-// Dump Current playfield area to the screen
+// Makes sure that the chunks covering the given map tile rect are built & in the cache.
+// Missing chunks are all built at once across the job workers.
+//
+// The chunks next to them in the direction of the scroll (aheadRows/aheadCols = -1, 0 or 1)
+// get a slot reserved and are queued for BuildQueuedMapChunks, so by the time the scroll
+// gets to them they're usually ready and don't need to be built on the spot.
 //
 
-void DisplayPlayfield(void)
+static void PrepareMapChunks(long top, long left, long bottom, long right, long aheadRows, long aheadCols)
 {
-Ptr			destPtr,srcPtr;
-long		top,left,width;
-unsigned long	height;
-long		numSegments,seg;
-Ptr			destPtrs[4];
-Ptr			srcPtrs[4];
-unsigned long	heights[4];
-long		widths[4];
-long		srcAdd,destAdd;
-long		method;
-
-	left	= PositiveModulo(gTweenedScrollX + gShakeyScreenOffsetX, PF_BUFFER_WIDTH);		// get PF buffer pixel coords to start @
-	top		= PositiveModulo(gTweenedScrollY + gShakeyScreenOffsetY, PF_BUFFER_HEIGHT);
-
-	if ((left+(PF_WINDOW_WIDTH-1)) > PF_BUFFER_WIDTH)		// see if 2 horiz segments
+MapChunk	*batch[MAX_MAP_CHUNK_BATCH];
+int			numInBatch = 0;
+
+	if (gMapChunks == nil)
 	{
+		gMapChunks = (MapChunk*) NewPtrClear(sizeof(MapChunk) * MAX_MAP_CHUNKS);
+		GAME_ASSERT(gMapChunks);
+		gMapChunkClock = 0;
+		ResetMapChunks();
+	}
 
-						/* 2 HORIZ SEGMENTS */
+	gMapChunkClock++;											// chunks stamped with this can't be evicted
 
-		if ((top+(PF_WINDOW_HEIGHT-1)) > PF_BUFFER_HEIGHT)	// see if 2 vertical segments
-		{
-			method = 0;
-			numSegments = 4;
-			widths[0] = widths[2] = (PF_BUFFER_WIDTH-left);
-			heights[0] = heights[1] = PF_BUFFER_HEIGHT-top;
-			destPtrs[1] = (destPtrs[0] = (Ptr)(gScreenLookUpTable[PF_WINDOW_TOP]+
-								+PF_WINDOW_LEFT)) + widths[0];
+	long chunkTop		= top >> MAP_CHUNK_TILES_SH;
+	long chunkLeft		= left >> MAP_CHUNK_TILES_SH;
+	long chunkBottom	= bottom >> MAP_CHUNK_TILES_SH;
+	long chunkRight		= right >> MAP_CHUNK_TILES_SH;
+	long lastChunkRow	= (gPlayfieldTileHeight - 1) >> MAP_CHUNK_TILES_SH;
+	long lastChunkCol	= (gPlayfieldTileWidth - 1) >> MAP_CHUNK_TILES_SH;
 
-			widths[1] = widths[3] = (PF_WINDOW_WIDTH-widths[0]);
-			heights[2] = heights[3] = PF_WINDOW_HEIGHT-heights[0];
+	for (int pass = 0; pass < 2; pass++)						// pass 0: chunks we need now, pass 1: chunks ahead
+	{
+		long dy = pass ? aheadRows : 0;
+		long dx = pass ? aheadCols : 0;
 
-			srcPtrs[2] = (Ptr)(gPFLookUpTable[0]+left);
+		if (pass && !dy && !dx)
+			break;
 
-			destPtrs[3] = (Ptr)((destPtrs[2] = (Ptr)(gScreenLookUpTable[PF_WINDOW_TOP+heights[0]]+PF_WINDOW_LEFT))+widths[0]);
-			srcPtrs[3] = (Ptr)(gPFLookUpTable[0]);
-			srcPtrs[0] = (srcPtrs[1] = (Ptr)(gPFLookUpTable[top])) + left;
-		}
-		else														// 1 vertical segment
+		for (long chunkRow = chunkTop + dy; chunkRow <= chunkBottom + dy; chunkRow++)
 		{
-			method = 1;
-			numSegments = 2;
-			srcPtrs[0] = (Ptr)((srcPtrs[1] = (Ptr)(gPFLookUpTable[top]))+left);
-			widths[0] = PF_BUFFER_WIDTH-left;
-			heights[0] = heights[1] = PF_WINDOW_HEIGHT;
-
-			destPtrs[1] = (Ptr)((destPtrs[0] = (Ptr)(gScreenLookUpTable[PF_WINDOW_TOP]+
-								PF_WINDOW_LEFT))+widths[0]);
-			widths[1] = (PF_WINDOW_WIDTH-widths[0]);
+			for (long chunkCol = chunkLeft + dx; chunkCol <= chunkRight + dx; chunkCol++)
+			{
+				if (chunkRow < 0 || chunkRow > lastChunkRow || chunkCol < 0 || chunkCol > lastChunkCol)
+					continue;
+
+				MapChunk* chunk = FindMapChunk(chunkRow, chunkCol);
+
+				if (chunk == nil)
+				{
+					if (pass && gNumQueuedMapChunks >= MAX_MAP_CHUNKS)	// queue full, don't look ahead
+						continue;
+
+							/* EVICT LEAST RECENTLY USED CHUNK */
+
+					for (int i = 0; i < MAX_MAP_CHUNKS; i++)
+					{
+						if (gMapChunks[i].lastUsed == gMapChunkClock)	// needed by this call
+							continue;
+						if (chunk == nil || gMapChunks[i].lastUsed < chunk->lastUsed)
+							chunk = &gMapChunks[i];
+					}
+					GAME_ASSERT(chunk);
+
+					chunk->chunkRow = chunkRow;
+					chunk->chunkCol = chunkCol;
+					chunk->built = false;
+
+					if (pass)
+						gQueuedMapChunks[gNumQueuedMapChunks++] = chunk;
+				}
+
+				if (!pass && !chunk->built)								// a real miss: build it now
+				{
+					if (numInBatch >= MAX_MAP_CHUNK_BATCH)				// batch full, build what we have so far
+					{
+						BuildMapChunks(batch, numInBatch);
+						numInBatch = 0;
+					}
+					batch[numInBatch++] = chunk;
+					chunk->built = true;								// don't add it to the batch twice
+				}
+
+				chunk->lastUsed = gMapChunkClock;
+			}
 		}
 	}
-					/* ONLY 1 HORIZ SEGMENT */
-	else
+
+	BuildMapChunks(batch, numInBatch);
+}
+
+
+/************************ DRAW MAP RECT ***********************/
+//
+// Draws a rect of map tiles (with their masks) into the PF buffer.
+// Tiles come from the map chunk cache, a row of tiles at a time, as long as
+// the row is contiguous both in the chunk and in the circular PF buffer.
+//
+// Source port note: this replaces the DrawATile loops of InitPlayfield & ScrollPlayfield_xxx.
+// Chunks hold the map tiles exactly as DrawATile would draw them, so animated tiles
+// still show their base tile until UpdateTileAnimation gets to them, like before.
+//
+
+static void DrawMapRect(long top, long left, long numRows, long numCols, long aheadRows, long aheadCols)
+{
+	if (gUseMapChunks < 0)
 	{
-		if ((top+(PF_WINDOW_HEIGHT-1)) > PF_BUFFER_HEIGHT)			// see if 2 vertical segments
-		{
-			method = 2;
-			numSegments = 2;
-			destPtrs[0] = (Ptr)(gScreenLookUpTable[PF_WINDOW_TOP]+
-								PF_WINDOW_LEFT);
-			widths[0] = widths[1] = PF_WINDOW_WIDTH;
-			heights[1] = PF_WINDOW_HEIGHT-(heights[0] = PF_BUFFER_HEIGHT-top);
-
-			destPtrs[1] = (Ptr)(gScreenLookUpTable[PF_WINDOW_TOP+heights[0]]+
-								PF_WINDOW_LEFT);
-			srcPtrs[1] = (Ptr)(gPFLookUpTable[0]+left);
-			srcPtrs[0] = (Ptr)(gPFLookUpTable[top]+left);
-		}
-		else														// 1 vertical segment
+		gUseMapChunks = SDL_GetHintBoolean(kMapChunksHint, true);
+		SDL_Log("Map chunk cache: %s", gUseMapChunks ? "on" : "off");
+	}
+
+					/* DRAW TILE BY TILE */
+
+	if (!gUseMapChunks)
+	{
+		for (long y = 0; y < numRows; y++)
 		{
-			method = 3;
-			numSegments = 1;
-			destPtrs[0] = (Ptr)(gScreenLookUpTable[PF_WINDOW_TOP]+
-								PF_WINDOW_LEFT);
-			srcPtrs[0] = (Ptr)gPFLookUpTable[top]+left;
-			widths[0] = PF_WINDOW_WIDTH;
-			heights[0] = PF_WINDOW_HEIGHT;
+			for (long x = 0; x < numCols; x++)
+			{
+				DrawATile(gPlayfield[top+y][left+x], (top+y) % PF_TILE_HEIGHT, (left+x) % PF_TILE_WIDTH, true);
+				SetCellTile((top+y) % PF_TILE_HEIGHT, (left+x) % PF_TILE_WIDTH, gPlayfield[top+y][left+x]);
+			}
 		}
+		return;
 	}
 
-					/**********************************/
-					/* SPECIAL CASE METHOD 0 / 4 SEGS */
-					/**********************************/
+					/* COPY FROM CHUNKS */
+
+	PrepareMapChunks(top, left, top+numRows-1, left+numCols-1, aheadRows, aheadCols);
 
-	if (method == 0)
+	for (long y = 0; y < numRows; y++)
 	{
-		Ptr		destPtr2,srcPtr2;
-		long	width2,srcAdd2,destAdd2;
+		long	mapRow = top + y;
+		long	row = mapRow % PF_TILE_HEIGHT;						// calc row in buffer
+		long	chunkTileRow = mapRow & (MAP_CHUNK_TILES-1);
 
-		for (seg = 0; seg < 4; seg+=2)
+		for (long x = 0; x < numCols; )
 		{
-			destPtr = destPtrs[0+seg];
-			srcPtr	= srcPtrs[0+seg];
-			destPtr2 = destPtrs[1+seg];
-			srcPtr2	= srcPtrs[1+seg];
-
-			height = heights[0+seg];					// set height
-			width = widths[0+seg];						// set width
-			width2 = widths[1+seg];						// set width
+			long	mapCol = left + x;
+			long	col = mapCol % PF_TILE_WIDTH;					// calc col in buffer
+			long	chunkTileCol = mapCol & (MAP_CHUNK_TILES-1);
 
-			srcAdd = (PF_BUFFER_WIDTH)-width;			// calc line add (for normal display)
-			destAdd = (VISIBLE_WIDTH)-width;
-			srcAdd2 = (PF_BUFFER_WIDTH)-width2;			// calc line add (for normal display)
-			destAdd2 = (VISIBLE_WIDTH)-width2;
+			long	numTiles = numCols - x;							// stop at edge of chunk or wraparound in buffer
+			numTiles = SDL_min(numTiles, MAP_CHUNK_TILES - chunkTileCol);
+			numTiles = SDL_min(numTiles, PF_TILE_WIDTH - col);
 
-						/* DO 1ST SEG */
-			do
+			for (long i = 0; i < numTiles; i++)
 			{
-				SDL_memcpy(destPtr, srcPtr, width);
-				destPtr += width;
-				srcPtr += width;
+				GAME_ASSERT(HandleBoundsCheck(gTileSetHandle, (Ptr) &gTileXlatePtr[gPlayfield[mapRow][mapCol+i] & TILENUM_MASK]));
+				SetCellTile(row, col+i, gPlayfield[mapRow][mapCol+i]);
+			}
 
+			const MapChunk* chunk = FindMapChunk(mapRow >> MAP_CHUNK_TILES_SH, mapCol >> MAP_CHUNK_TILES_SH);
+			GAME_ASSERT(chunk);
 
-						/* DO 2ND SEG */
+			long	srcOffset = ((chunkTileRow << TILE_SIZE_SH) * MAP_CHUNK_SIZE) + (chunkTileCol << TILE_SIZE_SH);
+			long	rowS = row << TILE_SIZE_SH;
+			long	colS = col << TILE_SIZE_SH;
+			size_t	numBytes = numTiles << TILE_SIZE_SH;
 
-				SDL_memcpy(destPtr2, srcPtr2, width2);
-				destPtr2 += width2;
-				srcPtr2 += width2;
+			for (int i = 0; i < TILE_SIZE; i++)
+			{
+				SDL_memcpy(gPFLookUpTable[rowS+i] + colS,		chunk->pixels + srcOffset,	numBytes);
+				SDL_memcpy(gPFCopyLookUpTable[rowS+i] + colS,	chunk->pixels + srcOffset,	numBytes);
+				SDL_memcpy(gPFMaskLookUpTable[rowS+i] + colS,	chunk->mask + srcOffset,	numBytes);
+				srcOffset += MAP_CHUNK_SIZE;
+			}
 
-				srcPtr += srcAdd;							// next line
-				destPtr += destAdd;
-				srcPtr2 += srcAdd2;
-				destPtr2 += destAdd2;
-			} while (--height);
+			SDL_memcpy(&gPFTileMaskStates[row * PF_TILE_WIDTH + col],
+						&chunk->maskStates[(chunkTileRow << MAP_CHUNK_TILES_SH) + chunkTileCol],
+						numTiles);
+
+			x += numTiles;
 		}
 	}
-	else
+}
+
+
+
+/******************* RESET TILE ANIM CELLS *********************/
+//
+// Empties the index of animated tiles in the PF buffer.
+// The PF buffer must be redrawn entirely after this.
+//
+
+static void ResetTileAnimCells(void)
+{
+	SDL_zeroa(gTileAnimSlotNumCells);
+
+	if (gCellTileAnimSlots)
+		SDL_memset(gCellTileAnimSlots, 0, gNumTileAnimCells);
+}
+
+
+/******************* SET CELL TILE *********************/
+//
+// Keeps the index of animated tiles up to date when a map tile is drawn in a PF buffer cell.
+//
+
+static void SetCellTile(long row, long col, unsigned short tileNum)
+{
+	long	cell = row * PF_TILE_WIDTH + col;
+
+	GAME_ASSERT(cell < gNumTileAnimCells);
+	uint8_t	oldSlot = gCellTileAnimSlots[cell];
+	uint8_t	newSlot = gTileAnimSlotOfTile[tileNum & TILENUM_MASK];
+
+	if (oldSlot == newSlot)
+		return;
+
+	if (oldSlot)												// remove from old list: move last cell into its spot
 	{
-					/**********************************/
-					/* NORMAL CASE METHOD 1..3        */
-					/**********************************/
+		int16_t*	cells = gTileAnimSlotCells + (oldSlot-1) * gNumTileAnimCells;
+		int16_t		index = gCellTileAnimSlotIndex[cell];
+		int16_t		lastCell = cells[--gTileAnimSlotNumCells[oldSlot-1]];
 
-						/* COPY THE SEGMENTS */
+		cells[index] = lastCell;
+		gCellTileAnimSlotIndex[lastCell] = index;
+	}
 
-		for (seg=0; seg < numSegments; seg++)
-		{
-			Ptr		destStartPtr,srcStartPtr;
+	if (newSlot)												// append to new list
+	{
+		int16_t*	cells = gTileAnimSlotCells + (newSlot-1) * gNumTileAnimCells;
+		int16_t		index = gTileAnimSlotNumCells[newSlot-1]++;
 
-			destStartPtr = destPtrs[seg];
-			srcStartPtr	= srcPtrs[seg];
+		cells[index] = cell;
+		gCellTileAnimSlotIndex[cell] = index;
+	}
 
-			height = heights[seg];						// set height
-			width = widths[seg];						// set width
+	gCellTileAnimSlots[cell] = newSlot;
+}
 
-			srcAdd = PF_BUFFER_WIDTH;					// line bytes
-			destAdd = VISIBLE_WIDTH;
 
-			do
-			{
-				destPtr = destStartPtr;
-				srcPtr = srcStartPtr;
+/************************ DRAW A TILE : SIMPLE ***********************/
+//
+// This simple version doesnt worry about masks at all.
+// Assumes that tileNum has ALREADY BEEN FILTERED!
+//
 
-				SDL_memcpy(destPtr, srcPtr, width);
+void DrawATile_Simple(unsigned short tileNum, short row, short col)
+{
+uint8_t		*destPtr,*srcPtr,*destCopyPtr;
+Ptr			destStartPtr,destCopyStartPtr;
+unsigned long	rowS,colS;								// shifted version of row & col
 
-				srcStartPtr += srcAdd;									// next line
-				destStartPtr += destAdd;
+					/* CALC DEST POINTERS */
 
-			} while (--height);
-		}
+	destStartPtr = (Ptr)(gPFLookUpTable[rowS = row<<TILE_SIZE_SH]+(colS = col<<TILE_SIZE_SH));
+	destCopyStartPtr = (Ptr)(gPFCopyLookUpTable[rowS]+colS);
+
+					/* CALC TILE DEFINITION ADDR */
+
+	GAME_ASSERT(HandleBoundsCheck(gTileSetHandle, (Ptr) gTileXlatePtr));
+	GAME_ASSERT(HandleBoundsCheck(gTileSetHandle, (Ptr) &gTileXlatePtr[tileNum]));
+
+	srcPtr = (uint8_t *)( gTilesPtr + ((long)(gTileXlatePtr[tileNum]) << (TILE_SIZE_SH*2)) );
+	destPtr = (uint8_t *)destStartPtr;
+	destCopyPtr = (uint8_t *)destCopyStartPtr;
+
+	GAME_ASSERT(HandleBoundsCheck(gTileSetHandle, (Ptr) srcPtr));
+
+						/* DRAW THE TILE */
+
+	for (int y = 0; y < TILE_SIZE; y++)
+	{
+		SDL_memcpy(destPtr,		srcPtr,	TILE_SIZE);
+		SDL_memcpy(destCopyPtr,	srcPtr,	TILE_SIZE);
+		destPtr		+= PF_BUFFER_WIDTH;			// next line
+		destCopyPtr	+= PF_BUFFER_WIDTH;
+		srcPtr		+= TILE_SIZE;
 	}
 }
 
 
 
+/********************* DISPLAY PLAYFIELD ***************/
+//
+// Dump Current playfield area to the screen
+//
+// Source port note: the window used to be copied out of the circular PF buffer into the
+// framebuffer here, in up to 4 segments. Now the present path reads it straight from the
+// PF buffer (see PlayfieldView), so the frame must be presented before the PF buffer changes.
+//
+
+void DisplayPlayfield(void)
+{
+	SetPlayfieldView(
+			PositiveModulo(gTweenedScrollX + gShakeyScreenOffsetX, PF_BUFFER_WIDTH),		// get PF buffer pixel coords to start @
+			PositiveModulo(gTweenedScrollY + gShakeyScreenOffsetY, PF_BUFFER_HEIGHT));
+}
+
+
+
 
 /**************** UPDATE TILE ANIMATION **********************/
 // Source port note: moved from TileAnim.c
+//
+// Source port note: this used to scan every tile of the PF buffer for each anim's base tile.
+// Now it only visits the cells listed for the anim's slot (see SetCellTile).
+//
 
 void UpdateTileAnimation(void)
 {
-unsigned long	row;
 unsigned short	newTile;
-uint16_t	targetTile,*intPtr,*basePtr;
-register long	col;
-register long	x,y,animNum;
-unsigned long 	origRow,origCol;
-
-	origRow = gScrollRow % PF_TILE_HEIGHT;									// calc row in buffer
-	origCol = gScrollCol % PF_TILE_WIDTH;									// calc col in buffer
+long	animNum,i,slot,y;
 
 	for (animNum = 0; animNum < gNumTileAnims; animNum++)
 	{
@@ -1644,37 +2087,18 @@ unsigned long 	origRow,origCol;
 		{
 			gTileAnims[animNum].count = 0x100;								// reset counter
 
-						/* SCAN VISIBLE AREA FOR TARGET TILE */
+						/* DRAW NEW FRAME WHEREVER THE BASE TILE IS */
 
-			targetTile = gTileAnims[animNum].defPtr->baseTile;				// get target basetile
 			newTile = gTileAnims[animNum].defPtr->tileNums[gTileAnims[animNum].index];	// get tile to draw
 
-			basePtr = (unsigned short *)&gPlayfield[gScrollRow][gScrollCol]; // get ptr to start of scan
-
-			row = origRow;													// get modable row
-
-			y = 0;
-			do
+			slot = gTileAnimSlots[animNum];
+			if (slot >= 0)
 			{
-				intPtr = basePtr;											// get ptr to start of horiz scan
-				col = origCol;
-				x = PF_TILE_WIDTH;
-
-				do
-				{
-					if ((*intPtr++ & TILENUM_MASK) == targetTile)
-						DrawATile_Simple(newTile,row,col);
-
-					if (++col >= PF_TILE_WIDTH)								// see if column wrap
-						col = 0;
-				} while (--x);
-
-				if (++row >= (unsigned long) PF_TILE_HEIGHT)				// see if row wrap
-					row = 0;
-
-				basePtr += gPlayfieldTileWidth;								// next row in map
-			} while (++y < PF_TILE_HEIGHT);
+				const int16_t* cells = gTileAnimSlotCells + slot * gNumTileAnimCells;
 
+				for (i = 0; i < gTileAnimSlotNumCells[slot]; i++)
+					DrawATile_Simple(newTile, cells[i] / PF_TILE_WIDTH, cells[i] % PF_TILE_WIDTH);
+			}
 
 			y = ++gTileAnims[animNum].index;								// increment index
 			if (y  >= gTileAnims[animNum].defPtr->numFrames)				// see if at end of sequence